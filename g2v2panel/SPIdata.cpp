@@ -10,8 +10,10 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include <Arduino.h>
-#include "spidata.h"
+#include "globalinclude.h"
+#include "SPIdata.h"
 #include "iopins.h"
+#include "timebase.h"
 #include <SPI.h>
 
 //
@@ -22,41 +24,244 @@
 // PORTA=  LED (4:7) & sw matrix row (3:0) outputs. 
 // only one of the switch matrix row outputs should be enabled as an output, with data = 0
 // PORTB= sw matrix row inputs; needs pullup
+//
+// with MCPINTERRUPTS, both devices have open drain INT outputs with INTA and
+// INTB mirrored, all wired together to VPINMCPINT
 
 
 //
-// use SPI mode 0, MSB first, suggest 1MHz bit rate
+// use SPI mode 0, MSB first, at 8MHz (VSPIPRESCALE)
+// SPI0 is driven directly rather than through the SPI library, and the chip
+// selects are driven through VPORTD, so there is no per byte or per
+// transaction library overhead
 //
 
 
-SPISettings myspiSettings(1000000, MSBFIRST, SPI_MODE0);
-
 //
-// function to write 8 bit value to MCP23017
-// chipadress =  0 or 1; CS worked out automatically
+// an operation: one chip select cycle of opcode, register address then data
 //
-void WriteMCPRegister(byte ChipAddress, byte RegAddress, byte Value)
+struct SSPIOperation
 {
-  byte Opcode = 0x40;
+  byte Opcode;                          // 0x40 + (chip << 1); +1 to read
+  byte RegAddress;                      // first register
+  byte Count;                           // data bytes
+  byte* Data;                           // read: where the data goes; write: the data
+  byte WriteValue;                      // data for a 1 byte write
+};
+
+SSPIOperation GSPIQueue[VMAXSPIOPERATIONS];
+volatile byte GSPIQueueCount;           // operations queued
+volatile byte GSPIOperation;            // operation being sent
+volatile byte GSPIByte;                 // byte of it being sent: 0 = opcode, 1 = address, then data
+volatile bool GSPIBatchBusy;            // true while a batch is being sent
 
-  if(ChipAddress == 1)
-    Opcode += 2;
+unsigned int GSPICounts;                // timer counts spent on SPI this tick
+unsigned long GSPITotalCounts;          // timer counts since the statistics were last read
+unsigned int GSPITickCount;             // ticks since the statistics were last read
+unsigned int GSPIMaxCounts;             // most timer counts in one tick
 
-  if(ChipAddress == 0)                                  // assert the correct chip select
-    digitalWrite(VPINMCPCS0, LOW);
+
+//
+// assert or deassert the chip select for an operation
+// each write is one constant bit, so it compiles to a single CBI or SBI:
+// the LED interrupt also writes VPORTD, and a read-modify-write here could undo it
+//
+inline void SetChipSelect(byte Opcode, bool Asserted)
+{
+  if (Opcode & 0x02)
+  {
+    if (Asserted)
+      VPORTD.OUT &= ~VMCPCS1BIT;
+    else
+      VPORTD.OUT |= VMCPCS1BIT;
+  }
   else
-    digitalWrite(VPINMCPCS1, LOW);
-
-  SPI.beginTransaction(myspiSettings);
-  SPI.transfer(Opcode);                                 // point to register
-  SPI.transfer(RegAddress);                             // write its address
-  SPI.transfer(Value);                                  // write its data
-  
-  SPI.endTransaction();
-  if(ChipAddress == 0)                                  // deassert chip select
-    digitalWrite(VPINMCPCS0, HIGH);
+  {
+    if (Asserted)
+      VPORTD.OUT &= ~VMCPCS0BIT;
+    else
+      VPORTD.OUT |= VMCPCS0BIT;
+  }
+}
+
+
+//
+// the byte at position Position of an operation
+//
+inline byte SPIOperationByte(SSPIOperation* Op, byte Position)
+{
+  if (Position == 0)
+    return Op->Opcode;
+  if (Position == 1)
+    return Op->RegAddress;
+  if (Op->Opcode & 1)
+    return 0;                           // read: send nulls
+  return Op->Data[Position - 2];
+}
+
+
+//
+// a byte has been sent: store it if read data, then send the next byte,
+// or move on to the next operation, or end the batch
+// called from the SPI0 interrupt, or by the main loop waiting for the batch
+//
+void SPIByteDone(void)
+{
+  SSPIOperation* Op = GSPIQueue + GSPIOperation;
+  byte Position = GSPIByte;
+  byte Received;
+
+  Received = SPI0.DATA;                                 // also clears the interrupt flag
+  if ((Position >= 2) && (Op->Opcode & 1))
+    Op->Data[Position - 2] = Received;
+  Position++;
+  if (Position < Op->Count + 2)
+  {
+    GSPIByte = Position;
+    SPI0.DATA = SPIOperationByte(Op, Position);
+    return;
+  }
+  SetChipSelect(Op->Opcode, false);
+  GSPIByte = 0;
+  if (++GSPIOperation < GSPIQueueCount)
+  {
+    Op++;
+    SetChipSelect(Op->Opcode, true);
+    SPI0.DATA = Op->Opcode;
+  }
   else
-    digitalWrite(VPINMCPCS1, HIGH);
+  {
+    SPI0.INTCTRL = 0;
+    GSPIQueueCount = 0;
+    GSPIBatchBusy = false;
+  }
+}
+
+
+#ifdef SPIINTERRUPTS
+ISR(SPI0_INT_vect)
+{
+  SPIByteDone();
+}
+#endif
+
+
+//
+// finish the batch: the main loop sends any bytes still to go itself
+// (with SPIINTERRUPTS, the interrupt is disabled first)
+//
+void WaitSPIBatch(void)
+{
+  unsigned int Start;
+
+  if (!GSPIBatchBusy)
+    return;
+  Start = TimerCounts();
+#ifdef SPIINTERRUPTS
+  noInterrupts();
+  SPI0.INTCTRL = 0;
+  interrupts();
+#endif
+  while (GSPIBatchBusy)
+  {
+    while ((SPI0.INTFLAGS & SPI_IF_bm) == 0)
+      ;
+    SPIByteDone();
+  }
+  GSPICounts += TimerCounts() - Start;
+}
+
+
+//
+// start the queued operations: send the first byte
+//
+void RunSPIBatch(void)
+{
+  unsigned int Start;
+
+  if ((GSPIQueueCount == 0) || GSPIBatchBusy)
+    return;
+  Start = TimerCounts();
+  GSPIOperation = 0;
+  GSPIByte = 0;
+  GSPIBatchBusy = true;
+  SetChipSelect(GSPIQueue[0].Opcode, true);
+  SPI0.DATA = GSPIQueue[0].Opcode;
+#ifdef SPIINTERRUPTS
+  SPI0.INTCTRL = SPI_IE_bm;
+  GSPICounts += TimerCounts() - Start;
+#else
+  GSPICounts += TimerCounts() - Start;
+  WaitSPIBatch();
+#endif
+}
+
+
+//
+// add an operation to the queue
+//
+void QueueMCPOperation(byte Opcode, byte RegAddress, byte* Data, byte Count)
+{
+  SSPIOperation* Op;
+
+  WaitSPIBatch();
+  if (GSPIQueueCount >= VMAXSPIOPERATIONS)
+  {
+    RunSPIBatch();
+    WaitSPIBatch();
+  }
+  Op = GSPIQueue + GSPIQueueCount++;
+  Op->Opcode = Opcode;
+  Op->RegAddress = RegAddress;
+  Op->Count = Count;
+  Op->Data = Data;
+}
+
+
+void QueueMCPRead(byte ChipAddress, byte RegAddress, byte* Data, byte Count)
+{
+  QueueMCPOperation(0x41 | (ChipAddress << 1), RegAddress, Data, Count);
+}
+
+
+void QueueMCPWrite(byte ChipAddress, byte RegAddress, byte Value)
+{
+  SSPIOperation* Op;
+
+  QueueMCPOperation(0x40 | (ChipAddress << 1), RegAddress, NULL, 1);
+  Op = GSPIQueue + GSPIQueueCount - 1;
+  Op->WriteValue = Value;
+  Op->Data = &Op->WriteValue;
+}
+
+
+//
+// end of tick: add the tick's SPI time to the statistics
+//
+void SPITickEnd(void)
+{
+  if (GSPITickCount >= 0x8000)                          // not read for a minute: keep a decaying mean
+  {
+    GSPITotalCounts >>= 1;
+    GSPITickCount >>= 1;
+  }
+  GSPITotalCounts += GSPICounts;
+  GSPITickCount++;
+  if (GSPICounts > GSPIMaxCounts)
+    GSPIMaxCounts = GSPICounts;
+  GSPICounts = 0;
+}
+
+
+//
+// function to write 8 bit value to MCP23017
+// chipadress =  0 or 1; CS worked out automatically
+//
+void WriteMCPRegister(byte ChipAddress, byte RegAddress, byte Value)
+{
+  QueueMCPWrite(ChipAddress, RegAddress, Value);
+  RunSPIBatch();
+  WaitSPIBatch();
 }
 
 
@@ -67,26 +272,11 @@ void WriteMCPRegister(byte ChipAddress, byte RegAddress, byte Value)
 //
 byte ReadMCPRegister(byte ChipAddress, byte RegAddress)
 {
-  byte Opcode = 0x41;                                   // read bit set
   byte Value;                                           // return value
 
-  if(ChipAddress == 1)
-    Opcode += 2;
-
-  if(ChipAddress == 0)                                  // assert the correct chip select
-    digitalWrite(VPINMCPCS0, LOW);
-  else
-    digitalWrite(VPINMCPCS1, LOW);
-
-  SPI.beginTransaction(myspiSettings);
-  SPI.transfer(Opcode);                                 // point to register
-  SPI.transfer(RegAddress);                             // write its address
-  Value = SPI.transfer(0x00);                           // write (null) to read back data
-  SPI.endTransaction();
-  if(ChipAddress == 0)                                  // deassert chip select
-    digitalWrite(VPINMCPCS0, HIGH);
-  else
-    digitalWrite(VPINMCPCS1, HIGH);
+  QueueMCPRead(ChipAddress, RegAddress, &Value, 1);
+  RunSPIBatch();
+  WaitSPIBatch();
   return Value;
 }
 
@@ -99,29 +289,26 @@ byte ReadMCPRegister(byte ChipAddress, byte RegAddress)
 //
 unsigned int ReadMCPRegister16(byte ChipAddress, byte RegAddress)
 {
-  byte Opcode = 0x41;                                   // read bit set
-  byte Read1, Read2;
-  unsigned int Data;
-  if(ChipAddress == 1)
-    Opcode += 2;
+  byte Data[2];
 
-  if(ChipAddress == 0)                                  // assert the correct chip select
-    digitalWrite(VPINMCPCS0, LOW);
-  else
-    digitalWrite(VPINMCPCS1, LOW);
-
-  SPI.beginTransaction(myspiSettings);
-  SPI.transfer(Opcode);                                 // point to register
-  SPI.transfer(RegAddress);                             // write its address
-  Read1 = SPI.transfer(0x0);                            // write (null) to read back data
-  Read2 = SPI.transfer(0x0);                            // write (null) to read back data
-  SPI.endTransaction();
-  if(ChipAddress == 0)                                  // deassert chip select
-    digitalWrite(VPINMCPCS0, HIGH);
-  else
-    digitalWrite(VPINMCPCS1, HIGH);
-  Data = (Read2 << 8) | Read1;
-  return Data;
+  QueueMCPRead(ChipAddress, RegAddress, Data, 2);
+  RunSPIBatch();
+  WaitSPIBatch();
+  return (Data[1] << 8) | Data[0];
+}
+
+
+
+//
+// returns true if either MCP23S17 is asserting its interrupt output
+//
+bool MCPInterruptAsserted(void)
+{
+#ifdef MCPINTERRUPTS
+  return (digitalRead(VPINMCPINT) == LOW);
+#else
+  return false;
+#endif
 }
 
 
@@ -131,7 +318,12 @@ unsigned int ReadMCPRegister16(byte ChipAddress, byte RegAddress)
 //
 void InitSPI(void)
 {
-  SPI.begin();
+  SPI.begin();                                                        // sets up the SPI pins
+  SPI0.CTRLA = SPI_MASTER_bm | VSPIPRESCALE | SPI_ENABLE_bm;
+  SPI0.CTRLB = SPI_SSD_bm | SPI_MODE_0_gc;
+  SPI0.INTCTRL = 0;
+  GSPIQueueCount = 0;                                                 // no batch in progress
+  GSPIBatchBusy = false;
 //
 // initialise pullup resistors on the MCP23017 inputs
 //
@@ -144,4 +336,21 @@ void InitSPI(void)
   WriteMCPRegister(VMCPMATRIXADDR, IODIRB, 0xFF);                     // make Direction register B = FF (all input)
   WriteMCPRegister(VMCPMATRIXADDR, GPIOA, 0b11110000);                // make GPIO register A assert LEDS to 1, columns to 0
   WriteMCPRegister(VMCPMATRIXADDR, GPPUB, 0xFF);                      // make row inputs have pullup resistors
+
+#ifdef MCPINTERRUPTS
+//
+// encoder inputs interrupt on any change from their previous value;
+// row inputs interrupt when different from DEFVAL (ie any row low), but
+// only enabled by AssertMatrixColumn() when every column is driven
+//
+  WriteMCPRegister(VMCPENCODERADDR, IOCON, VIOCONMIRROR | VIOCONODR);
+  WriteMCPRegister(VMCPENCODERADDR, INTCONA, 0x00);
+  WriteMCPRegister(VMCPENCODERADDR, INTCONB, 0x00);
+  WriteMCPRegister(VMCPENCODERADDR, GPINTENA, 0xFF);
+  WriteMCPRegister(VMCPENCODERADDR, GPINTENB, 0xFF);
+  WriteMCPRegister(VMCPMATRIXADDR, IOCON, VIOCONMIRROR | VIOCONODR);
+  WriteMCPRegister(VMCPMATRIXADDR, DEFVALB, 0xFF);
+  WriteMCPRegister(VMCPMATRIXADDR, INTCONB, 0xFF);
+  WriteMCPRegister(VMCPMATRIXADDR, GPINTENB, 0x00);
+#endif
 }
\ No newline at end of file
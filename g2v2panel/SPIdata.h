@@ -40,6 +40,65 @@
 #define VMCPENCODERADDR 0             // 1st 23S17: 16 bit encoder input
 #define VMCPMATRIXADDR 1              // 2nd 23S17: sw matrix column output & row input
 
+// IOCON bits
+#define VIOCONMIRROR 0x40             // INTA and INTB outputs both show either port's interrupt
+#define VIOCONODR 0x04                // INT outputs open drain, so both devices can share one input
+
+//
+// interrupt on change scanning (if MCPINTERRUPTS is defined):
+// the encoder device interrupts on any input change, and the matrix device
+// on any row input low while every column is driven (no key was down).
+// inputs are only read when an interrupt is asserted, or for a keep-alive
+// read every VMCPKEEPALIVETICKS ticks in case an interrupt was missed
+//
+#define VMCPKEEPALIVETICKS 250        // 0.5s
+
+
+//
+// batched SPI transactions
+// a tick's register accesses are queued, then run back to back by driving
+// SPI0 directly: each is one chip select cycle, with the data bytes at
+// sequential register addresses (IOCON.SEQOP=0). Read data is written to
+// the caller's buffer, and must not be used until WaitSPIBatch() returns.
+// with SPIINTERRUPTS each byte is started by the SPI0 interrupt, so
+// RunSPIBatch() returns straight away; otherwise it waits for the batch.
+//
+#define VMAXSPIOPERATIONS 4             // operations in one batch
+#define VSPIPRESCALE (SPI_CLK2X_bm | SPI_PRESC_DIV4_gc)   // SPI0 clock = CPU clock / 2 = 8MHz (MCP23S17 max 10MHz)
+
+//
+// SPI timing statistics: time the main loop spent sending SPI bytes or waiting for them
+//
+extern unsigned long GSPITotalCounts;   // timer counts since the statistics were last read
+extern unsigned int GSPITickCount;      // ticks since the statistics were last read
+extern unsigned int GSPIMaxCounts;      // most timer counts in one tick
+
+
+//
+// queue a register read of Count bytes from RegAddress onwards, or a register write
+// if the queue is full, or a batch is running, that batch is finished first
+//
+void QueueMCPRead(byte ChipAddress, byte RegAddress, byte* Data, byte Count);
+void QueueMCPWrite(byte ChipAddress, byte RegAddress, byte Value);
+
+
+//
+// start the queued operations
+//
+void RunSPIBatch(void);
+
+
+//
+// wait until the batch has finished (a no-op if it already has)
+//
+void WaitSPIBatch(void);
+
+
+//
+// end of tick: add the tick's SPI time to the statistics
+//
+void SPITickEnd(void);
+
 
 //
 // function to write 8 bit value to MCP23017
@@ -66,6 +125,13 @@ unsigned int ReadMCPRegister16(byte ChipAddress, byte RegAddress);
 
 
 
+//
+// returns true if either MCP23S17 is asserting its interrupt output
+// (always false if MCPINTERRUPTS is not defined)
+//
+bool MCPInterruptAsserted(void);
+
+
 //
 // function to initialise SPI driver and two MCP23S17 devices
 //
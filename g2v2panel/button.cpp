@@ -17,24 +17,13 @@
 #include "cathandler.h"
 #include "led.h"
 #include "SPIdata.h"                             // for Andromeda h/w MCP23017
+#include "timebase.h"
 
 
 bool GBandShiftActive;                          // true if band shift is active
 bool GEncoderShiftActive;                       // true if encoder shift is active
 bool GShiftOverride;                            // true if shift buttons are to be treated as normal buttons
 
-//
-// enum for the states of the matrix scan sequencer
-//
-enum EScanStates 
-{
-  eIdle,                            // no button pressed
-  eWaitPressed,                     // single button pressed - debounce
-  eButtonPressed,                   // single button has been pressed
-  eWaitReleased,                    // release state from a single press - debounce
-  eMultiPressed,                    // more thna one pressed - wait until released
-  eWaitMultiReleased                // debounce state for release from multiple buttons pressed
-};
 
 //
 // enum for the event types
@@ -65,59 +54,137 @@ enum EEventType
 //
 #define VNUMROWS 8
 #define VNUMCOLS 4
-#define VCOLUMNMASK 0b00001111;
+#define VCOLUMNMASK 0b00001111
 #define VNUMSCANCODES 32
-EScanStates GScanState;
-byte GScanColumn;                   // scanned column number, 0...4
-byte GFoundRow;                     // row where a bit detected
-byte GDebounceTickCounter;          // delay counter (units of 2ms)
-unsigned int GLongPressCounter;     // counter for a long press
+byte GScanColumn;                   // scanned column number, 0...3
 
 
+//
+// the whole matrix is held as a 32 bit image: bit N is the key with scan code N
+// (column*8 + row), 1 = pressed, so every key is debounced at once.
+// each key has a 2 bit "vertical" counter, held as 2 bit planes: bit N of
+// GDebounceCount0 and GDebounceCount1 make the count for key N. The count goes
+// up for each scan that reads a key differently from its debounced state, and
+// back to 0 if it reads the same; the 4th different scan changes the state.
+// a column is read every VNUMCOLS ticks, so a change is accepted after 24ms.
+// keys in GEagerKeys change state on the first different scan instead; their
+// count is set to 3 and counts down one per scan, and while it is not 0 the
+// key is ignored, so bounce can't be seen as another press or release.
+// (a matrix without a diode per key can still show a "ghost" 4th key
+// when 3 keys at the corners of a rectangle are pressed)
+//
+unsigned long GMatrixImage;         // most recent reading of every key
+unsigned long GDebouncedKeys;       // debounced key states
+unsigned long GDebounceCount0;      // vertical counter, bit 0 plane
+unsigned long GDebounceCount1;      // vertical counter, bit 1 plane
+unsigned long GEagerKeys;           // keys using eager debounce
+unsigned long GLongPressPending;    // keys held, but not yet long pressed
+unsigned int GPressTick[VNUMSCANCODES];       // timebase tick count (low 16 bits) when each key was pressed
+byte GPressedCode[VNUMSCANCODES];   // report code sent when each key was pressed; 0 if none
+unsigned long GEdgeMicros[VNUMSCANCODES];     // TimebaseMicros() when each key's latest change was first seen
+
+//
+// with MCPINTERRUPTS, once a full scan finds no key down (and no key still
+// being debounced) the matrix goes idle: every column is driven at once, and
+// the matrix device interrupts when any row goes low. Scanning restarts from
+// column 0 then. Nothing is read while idle, except a keep-alive read.
+//
+bool GMatrixIdle;                   // true if every column is driven, waiting for a key
+bool GMatrixArmed;                  // true if the row input interrupt is enabled
+byte GMatrixKeepAliveCount;         // ticks until the next keep-alive read when idle
+byte GMatrixIODIR;                  // last value written to IODIRA (columns and LEDs)
+byte GMatrixReadRegister;           // register read this tick: GPIOB, INTFB, or 0 for none
+byte GMatrixReadValue;              // its value
+
 
 
 
 //
-// function to process row input and see if only 1 bit is set
-// output 0: no bits set; 1-8: row bit 0-7 is set; FF: more than one bit set
+// function to drive new column output
+// this should be at the END of the code to allow settling time
+// the writes are queued with any others this tick, then the batch is run
+// this works by having fixed GPIO data, and selectively enabling bits as outputs. 
+// For column outputs this makes them like open drain so they are never driven to a 1.
 //
+// when the matrix is idle every column is driven, and IODIRA is only
+// written if the LED bits have changed; then the row interrupt is enabled.
 //
-byte AnalyseRowInput(byte RawInput)
+void AssertMatrixColumn()
 {
-  byte Result = 0;
-  byte Cntr;
+  byte Column;
 
-  for(Cntr = 0; Cntr < VNUMROWS; Cntr++)      // step through all row inputs
+  if (GMatrixIdle)
+    Column = VCOLUMNMASK;                                 // every column
+  else
   {
-    if ((RawInput & 1) == 0)                  // test bottom bit. If we have a zero input, something is pressed
-    {
-      if (Result == 0)                        // if we haven't found a bit set, set the current one
-        Result = Cntr+1;
-      else
-        Result = 0xFF;                        // else set more than 1 pressed
-    }
-    RawInput = RawInput >> 1;                 // move onto mext bit
+    Column = 1 << GScanColumn;                            // get a 1 in the right bit position
+    Column = Column & VCOLUMNMASK;                        // now have a 1 in the right bit position
+  }
+  Column |= I2CLEDBits;                                   // add in LED bits at the top
+  if (!GMatrixIdle || ((byte)~Column != GMatrixIODIR))
+  {
+    GMatrixIODIR = ~Column;
+    QueueMCPWrite(VMCPMATRIXADDR, IODIRA, GMatrixIODIR);  // drive 0 to enable output bits to pre-defined state
   }
-  return Result;
+  if (GMatrixIdle && !GMatrixArmed)
+  {
+    GMatrixArmed = true;
+    QueueMCPWrite(VMCPMATRIXADDR, GPINTENB, 0xFF);        // interrupt if any row is low
+  }
+  RunSPIBatch();
 }
 
 
+//
+// leave the idle state: disable the row interrupt and scan from column 0
+// (the row inputs are read each tick from now on, which clears the interrupt)
+// the interrupt enable write is sent with AssertMatrixColumn()'s batch
+//
+void WakeMatrix(void)
+{
+  GMatrixIdle = false;
+  GMatrixArmed = false;
+  GScanColumn = 0;
+  QueueMCPWrite(VMCPMATRIXADDR, GPINTENB, 0x00);
+}
 
 
 //
-// function to drive new column output
-// this should be at the END of the code to allow settling time
-// this works by having fixed GPIO data, and selectively enabling bits as outputs. 
-// For column outputs this makes them like open drain so they are never driven to a 1.
+// queue this tick's matrix read (see SPIdata.h)
+// scanning: the row inputs for the column asserted last tick
+// idle: the row interrupt flags if an interrupt is asserted, or a keep-alive
+// read of the rows (with every column driven) every VMCPKEEPALIVETICKS
 //
-void AssertMatrixColumn()
+void QueueButtonReads(void)
 {
-  byte Column;
+  GMatrixReadRegister = 0;
+  if (!GMatrixIdle)
+    GMatrixReadRegister = GPIOB;
+  else if (MCPInterruptAsserted())
+    GMatrixReadRegister = INTFB;
+  if (GMatrixIdle && (--GMatrixKeepAliveCount == 0))
+  {
+    GMatrixKeepAliveCount = VMCPKEEPALIVETICKS;
+    GMatrixReadRegister = GPIOB;
+  }
+  if (GMatrixReadRegister != 0)
+    QueueMCPRead(VMCPMATRIXADDR, GMatrixReadRegister, &GMatrixReadValue, 1);
+}
 
-  Column = 1 << GScanColumn;                              // get a 1 in the right bit position
-  Column = Column & VCOLUMNMASK;                          // now have a 1 in the right bit position
-  Column |= I2CLEDBits;                                   // add in LED bits at the top
-  WriteMCPRegister(VMCPMATRIXADDR, IODIRA, ~Column);      // drive 0 to enable output bits to pre-defined state
+
+//
+// while idle: decide whether a key may have been pressed
+// true if the matrix device has flagged a row interrupt, or a keep-alive
+// read of the rows found one low
+//
+bool MatrixKeyDetected(void)
+{
+  if (GMatrixReadRegister == 0)
+    return false;
+  WaitSPIBatch();
+  if (GMatrixReadRegister == INTFB)
+    return (GMatrixReadValue != 0);
+  return (GMatrixReadValue != 0xFF);
 }
 
 
@@ -129,15 +196,25 @@ void AssertMatrixColumn()
 //
 void GButtonInitialise(void)
 {
-  GScanState = eIdle;                                 // initialise the sequencer
+  byte Cntr;
+
   GScanColumn = 0;                                    // initial column
-  GFoundRow = 0;
-  GDebounceTickCounter = 0;
+  GMatrixImage = 0;                                   // all released
+  GDebouncedKeys = 0;
+  GDebounceCount0 = 0;
+  GDebounceCount1 = 0;
+  GLongPressPending = 0;
+  for (Cntr = 0; Cntr < VNUMSCANCODES; Cntr++)
+    GPressedCode[Cntr] = 0;
   I2CLEDBits = 0;                                     // I2C wired LEDs off
+  GMatrixIdle = false;                                // scan once before going idle
+  GMatrixArmed = false;
+  GMatrixKeepAliveCount = VMCPKEEPALIVETICKS;
   AssertMatrixColumn();
 }
 
 
+
 //
 // array to look up the report code from the software scan code
 // s/w scan code begins 0 and this table must have the full 4*8 entries
@@ -217,219 +294,222 @@ int ReportCodeLookup[] =
 
 
 //
-// get a scan code from column and row number
-// returns 0xFF if an invalid result
-// 0...N-1
+// button class for each scan code, to select its debounce policy
 //
-byte GetScanCode()
+const byte ButtonClassLookup[VNUMSCANCODES] =
 {
-  byte Result;
+  eButtonPanel, eButtonPanel, eButtonPanel, eButtonPanel,               // scan code 0
+  eButtonEncoder, eButtonEncoder, eButtonEncoder, eButtonPanel,         // encoders 1-3
+  eButtonPanel, eButtonShift, eButtonPanel, eButtonPanel,               // scan code 8, band shift
+  eButtonPanel, eButtonPanel, eButtonPanel, eButtonPanel,
+  eButtonPanel, eButtonPanel, eButtonPanel, eButtonPanel,               // scan code 16
+  eButtonPanel, eButtonPanel, eButtonPanel, eButtonPanel,
+  eButtonPanel, eButtonPanel, eButtonPanel, eButtonShift,               // scan code 24, encoder shift
+  eButtonEncoder, eButtonEncoder, eButtonPanel, eButtonPanel            // encoders 4-5
+};
 
-  if (GFoundRow == 0xFF)                            // invalid scan if more than one button pressed
-    Result = 0xFF;
-  else
-    Result = (GScanColumn << 3) + GFoundRow - 1;
-  return Result;
-}
 
+//
+// set which keys use eager debounce, from GEagerButtonClasses
+//
+void SetButtonDebouncePolicy(void)
+{
+  unsigned long Keys = 0;
+  byte ScanCode;
+
+  for (ScanCode = 0; ScanCode < VNUMSCANCODES; ScanCode++)
+    if (GEagerButtonClasses & (1 << ButtonClassLookup[ScanCode]))
+      Keys |= (1UL << ScanCode);
+  GEagerKeys = Keys;
+}
 
 
-//enum EEventType 
-//{
-//  eNoEvent,                           // no event present
-//  eEvVFOStep,                           // VFO encoder steps
-//  eEvEncoderStep,                       // ordinary encoder steps
-//  eEvButtonPress,                       // pushbutton press
-//  eEvButtonLongpress,                   // pushbutton long press
-//  eEvButtonRelease                      // pushbutton release
-//};
 
 //
 // function to lookup the correct button code and add event to queue
 // if shift is active, use the second lookup table
 // if encoder shift active, modift encoder 5 code to encoder 6 code
+// the code is looked up when the button is pressed; its long press and
+// release use the same code, even if a shift has changed while it was held
+// Time = when the event was detected (TimebaseMicros())
 //
-void SendButtonCode(EEventType ButtonEvent, byte ScanCode, bool Shifted)
+void SendButtonCode(EEventType ButtonEvent, byte ScanCode, bool Shifted, unsigned long Time)
 {
   byte ButtonCode;              // message report code
   bool IsPress = false;         // true for a press event
   bool IsLong = false;          // true also if long press
 
-  if (ScanCode != 0xFF)
+  if (ButtonEvent == eEvButtonPress)
   {
-    if (Shifted)
-      ScanCode += VNUMSCANCODES;
-    ButtonCode = ReportCodeLookup[ScanCode];
+    ButtonCode = ReportCodeLookup[Shifted ? ScanCode + VNUMSCANCODES : ScanCode];
     if(GEncoderShiftActive && (ButtonCode == VENC5BUTTONCODE))
       ButtonCode = VENC5SHIFTEDBUTTONCODE;
-    if (ButtonCode != 0)
+    GPressedCode[ScanCode] = ButtonCode;
+  }
+  else
+    ButtonCode = GPressedCode[ScanCode];
+  if (ButtonEvent == eEvButtonRelease)
+    GPressedCode[ScanCode] = 0;
+
+  if (ButtonCode != 0)
+  {
+    if(ButtonEvent == eEvButtonPress)
+      IsPress = true;
+    else if (ButtonEvent == eEvButtonLongpress)
     {
-      if(ButtonEvent == eEvButtonPress)
-        IsPress = true;
-      else if (ButtonEvent == eEvButtonLongpress)
-      {
-        IsPress = true;
-        IsLong = true;
-      }
-      CATHandlePushbutton(ButtonCode, IsPress, IsLong); 
+      IsPress = true;
+      IsLong = true;
     }
+    CATHandlePushbutton(ButtonCode, IsPress, IsLong, Time); 
   }
 }
 
 
 //
-// process an event from the button sequencer
-// get scan code, then decide how to handle
+// process an event for one key
+// decide how to handle from its scan code
+// Time = when the event was detected (TimebaseMicros())
 //
-void ProcessButtonEvent(EEventType ButtonEvent)
+void ProcessButtonEvent(EEventType ButtonEvent, byte ScanCode, unsigned long Time)
 {
-  byte ScanCode;
-
-  ScanCode = GetScanCode();
-  if (ScanCode != 0xFF)               // 0xFF implies error - more than 1 button pressed
+  if(GShiftOverride)                // convert to output code including shift buttons
   {
-    if(GShiftOverride)                // convert to output code including shift buttons
-    {
-      SendButtonCode(ButtonEvent, ScanCode, false);
-    }
-    else if (ScanCode == VBANDSHIFTSCANCODE)  // process band shift
-    {
-      if(ButtonEvent == eEvButtonPress)
-      {
-        GBandShiftActive = !GBandShiftActive;
-        if(LEDTestComplete)
-          SetLED(VLEDBANDSHIFT, GBandShiftActive);
-      }
-    }
-    else if (ScanCode == VENCODERSHIFTSCANCODE)   // process encoder shift
+    SendButtonCode(ButtonEvent, ScanCode, false, Time);
+  }
+  else if (ScanCode == VBANDSHIFTSCANCODE)  // process band shift
+  {
+    if(ButtonEvent == eEvButtonPress)
     {
-      if(ButtonEvent == eEvButtonPress)
-      {
-        GEncoderShiftActive = !GEncoderShiftActive;
-        if(LEDTestComplete)
-          SetLED(VLEDENCODERSHIFT, GEncoderShiftActive);
-      }
+      GBandShiftActive = !GBandShiftActive;
+      if(LEDTestComplete)
+        SetLED(VLEDBANDSHIFT, GBandShiftActive);
     }
-    else                                // normal button event
+  }
+  else if (ScanCode == VENCODERSHIFTSCANCODE)   // process encoder shift
+  {
+    if(ButtonEvent == eEvButtonPress)
     {
-      SendButtonCode(ButtonEvent, ScanCode, GBandShiftActive);
+      GEncoderShiftActive = !GEncoderShiftActive;
+      if(LEDTestComplete)
+        SetLED(VLEDENCODERSHIFT, GEncoderShiftActive);
     }
   }
-
+  else                                // normal button event
+  {
+    SendButtonCode(ButtonEvent, ScanCode, GBandShiftActive, Time);
+  }
 }
 
 
-#define VDEBOUNCETICKS 10
 #define VLONGPRESSTHRESHOLD 1000             // 2 seconds
 
 //
 // Tick
-// read row input, then run the sequencer. 
-// The sequencer advances to next column only when no buttons pressed. 
-// only accept a "pressed" indication if one input only is asserted
+// take the row inputs for the column asserted last tick into the matrix image,
+// debounce that column's keys, then report any that changed, and any held
+// long enough to be a long press. Then move on to the next column.
+// any number of keys can be pressed at once; each is reported on its own.
+// a press or release is reported with the time its edge was first seen (the
+// scan its debounce count started), not the time debouncing finished.
+// with MCPINTERRUPTS, when a full scan ends with every key released and
+// settled the matrix goes idle, until a row interrupt wakes it.
 //
 void ButtonTick(void)
 {
-
+  unsigned long ColumnMask;                 // bits for this column's keys
+  unsigned long Delta;                      // keys reading differently from their debounced state
+  unsigned long Eager;                      // this column's keys using eager debounce
+  unsigned long Stable;                     // this column's keys waiting for a stable input
+  unsigned long Locked;                     // eager keys ignored after a change
+  unsigned long Accepted;                   // eager keys changing now
+  unsigned long Counting;                   // stable keys with their count going up
+  unsigned long Edges;                      // keys seen changing for the first time this scan
+  unsigned long Changed;                    // keys whose debounced state changed
   byte Row;                                 // row input read from matrix
-  Row = ReadMCPRegister(VMCPMATRIXADDR, GPIOB);             // read raw row value
-  Row = AnalyseRowInput(Row);               // check whether none, one or more than one button pressed
-
+  byte Shift;                               // bit position of the column's first key
+  byte ColumnChanged, ColumnPending, ColumnEdges;   // this column's keys, 1 bit per row
+  byte ScanCode;
+  byte Cntr;
+  unsigned int Now;                         // timebase tick count, for long press timing
 
-  if (GDebounceTickCounter != 0)            // if delay counter isn't 0, count down delay
-    GDebounceTickCounter--;
-  else                                      // else step the sequencer
+  if (GMatrixIdle)
   {
-    switch(GScanState)
+    if (MatrixKeyDetected())
+      WakeMatrix();
+    return;
+  }
+  Now = (unsigned int)TimebaseTicks();
+  WaitSPIBatch();
+  Row = ~GMatrixReadValue;                                    // raw row value read this tick; now 1 = pressed
+  Shift = GScanColumn << 3;
+  ColumnMask = 0xFFUL << Shift;
+  GMatrixImage = (GMatrixImage & ~ColumnMask) | ((unsigned long)Row << Shift);
+//
+// step the vertical counters for this column.
+// stable keys: count up if different, else clear; a key changes state when
+// its count is 3 and it reads different again.
+// eager keys: change state if different and not locked, and set the count to 3;
+// count down if locked
+//
+  Delta = (GMatrixImage ^ GDebouncedKeys) & ColumnMask;
+  Eager = GEagerKeys & ColumnMask;
+  Stable = ColumnMask & ~Eager;
+  Locked = (GDebounceCount0 | GDebounceCount1) & Eager;
+  Accepted = Delta & Eager & ~Locked;
+  Counting = Delta & Stable;
+  Edges = (Counting & ~(GDebounceCount0 | GDebounceCount1)) | Accepted;
+  Changed = (Counting & GDebounceCount0 & GDebounceCount1) | Accepted;
+  GDebounceCount1 = (GDebounceCount1 & ~ColumnMask) | (Counting & (GDebounceCount1 ^ GDebounceCount0))
+                    | (Locked & ~(GDebounceCount1 ^ GDebounceCount0)) | Accepted;
+  GDebounceCount0 = (GDebounceCount0 & ~ColumnMask) | ((Counting | Locked) & ~GDebounceCount0) | Accepted;
+  GDebouncedKeys ^= Changed;
+//
+// now report presses, releases and long presses for this column
+//
+  ColumnChanged = (byte)(Changed >> Shift);
+  ColumnPending = (byte)(GLongPressPending >> Shift);
+  ColumnEdges = (byte)(Edges >> Shift);
+  if ((ColumnChanged | ColumnPending | ColumnEdges) != 0)
+  {
+    for (Cntr = 0; Cntr < VNUMROWS; Cntr++)
     {
-      case eIdle:                           // no button pressed
-        if (Row == 0)                       // still not pressed - advance column                
-        {
-          if (++GScanColumn >= VNUMCOLS)
-            GScanColumn = 0;
-        }
-        else if (Row == 0xFF)               // more than one button pressed
-        {
-          GScanState = eMultiPressed;
-          GDebounceTickCounter = VDEBOUNCETICKS;
-        }
-        else                                // single button pressed
-        {
-          GScanState = eWaitPressed;
-          GFoundRow = Row;
-          GDebounceTickCounter = VDEBOUNCETICKS;
-        }
-        break;
-  
-      case eWaitPressed:                    // single button pressed - debounce
-        if (Row == GFoundRow)               // same button pressed
-        {
-          GScanState = eButtonPressed;
-          ProcessButtonEvent(eEvButtonPress);                  // action the button press as a short press
-          GLongPressCounter = VLONGPRESSTHRESHOLD;          // initialise count
-        }
-        else                                // single button pressed
-        {
-          GScanState = eMultiPressed;
-          GDebounceTickCounter = VDEBOUNCETICKS;
-        }
-        break;
-  
-      case eButtonPressed:                  // single button has been pressed
-        if (Row == 0)                       // 1st detect of button released
-        {
-          GScanState = eWaitReleased;
-          GDebounceTickCounter = VDEBOUNCETICKS;
-        }
-        else if (Row != GFoundRow)          // multiple or different button pressed
-        {
-          GScanState = eMultiPressed;
-          GDebounceTickCounter = VDEBOUNCETICKS;
-          ProcessButtonEvent(eEvButtonRelease);
-        }
-        else                                // same button, so see if a long press
-        {
-          if(GLongPressCounter != 0)        // if we decrement the long press timeout to zero
-            if(--GLongPressCounter == 0)    // it will be a long press
-              ProcessButtonEvent(eEvButtonLongpress);          // action the button press as a long press
-        }
-        break;
-      
-      case eWaitReleased:                   // release state from a single press - debounce
-        if (Row == 0)                       // button now released after debounce
-        {
-          GScanState = eIdle;
-          GDebounceTickCounter = VDEBOUNCETICKS;
-          ProcessButtonEvent(eEvButtonRelease);
-        }
-        else if (Row != GFoundRow)          // multiple or different button pressed
-        {
-          GScanState = eMultiPressed;
-          GDebounceTickCounter = VDEBOUNCETICKS;
-        }
-        break;
-      
-      case eMultiPressed:                   // more than one pressed - wait until released
-        if (Row == 0)                       // 1st detect of button released
-        {
-          GScanState = eWaitMultiReleased;
-          GDebounceTickCounter = VDEBOUNCETICKS;
-        }
-        break;
-      
-      case eWaitMultiReleased:              // debounce state for release from multiple buttons pressed
-        if (Row == 0)                       // button confirmed released after debounce
+      ScanCode = Shift + Cntr;
+      if (ColumnEdges & 1)
+        GEdgeMicros[ScanCode] = TimebaseMicros();
+      if (ColumnChanged & 1)
+      {
+        if (GDebouncedKeys & (1UL << ScanCode))
         {
-          GScanState = eIdle;
-          GDebounceTickCounter = VDEBOUNCETICKS;
+          GPressTick[ScanCode] = Now;
+          GLongPressPending |= (1UL << ScanCode);
+          ProcessButtonEvent(eEvButtonPress, ScanCode, GEdgeMicros[ScanCode]);
         }
-        else                                // there is still something pressed during debounces, so go back to waiting
+        else
         {
-          GScanState = eMultiPressed;
-          GDebounceTickCounter = VDEBOUNCETICKS;
+          GLongPressPending &= ~(1UL << ScanCode);
+          ProcessButtonEvent(eEvButtonRelease, ScanCode, GEdgeMicros[ScanCode]);
         }
-        break;
+      }
+      else if ((ColumnPending & 1) && ((unsigned int)(Now - GPressTick[ScanCode]) >= VLONGPRESSTHRESHOLD))
+      {
+        GLongPressPending &= ~(1UL << ScanCode);
+        ProcessButtonEvent(eEvButtonLongpress, ScanCode, TimebaseMicros());
+      }
+      ColumnChanged >>= 1;
+      ColumnPending >>= 1;
+      ColumnEdges >>= 1;
+    }
+  }
+  if (++GScanColumn >= VNUMCOLS)
+  {
+    GScanColumn = 0;
+#ifdef MCPINTERRUPTS
+    if ((GMatrixImage | GDebouncedKeys | GDebounceCount0 | GDebounceCount1) == 0)
+    {
+      GMatrixIdle = true;
+      GMatrixKeepAliveCount = VMCPKEEPALIVETICKS;
     }
+#endif
   }
 }
 
@@ -22,6 +22,22 @@ extern bool GShiftOverride;                            // true if shift buttons
 extern bool GEncoderShiftActive;                       // true if encoder shift is active
 
 
+//
+// button classes, each with its own debounce policy
+// normally a press or release is reported once it has been stable for the
+// debounce time. A class can instead use "eager" debounce: a change is reported
+// on the first scan that sees it, then the key is ignored for the debounce time.
+// (set by bits in GEagerButtonClasses)
+//
+enum EButtonClass
+{
+  eButtonPanel,                                        // panel pushbuttons
+  eButtonEncoder,                                      // encoder push switches
+  eButtonShift,                                        // band and encoder shift buttons
+  eNumButtonClasses
+};
+
+
 
 //
 // initialise
@@ -30,13 +46,34 @@ extern bool GEncoderShiftActive;                       // true if encoder shift
 void GButtonInitialise(void);
 
 
+//
+// queue the tick's switch matrix read (see SPIdata.h)
+// called before the batch is run and ButtonTick() is called
+//
+void QueueButtonReads(void);
+
+
 //
 // Tick
-// read each pin intp the LSB of its debounce register; then look for press or release pattern
+// read one column of the switch matrix, debounce its keys, and report
+// press, long press and release for every key independently
 //
 void ButtonTick(void);
 
 
+//
+// set which keys use eager debounce, from GEagerButtonClasses
+// call after it is changed
+//
+void SetButtonDebouncePolicy(void);
+
+
+//
+// true if the matrix is idle (MCPINTERRUPTS): every column driven, waiting for a key
+//
+extern bool GMatrixIdle;
+
+
 //
 // function to drive new column output
 // this should be at the END of the code to allow settling time
@@ -0,0 +1,177 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// catformat.h
+// formatter for outgoing CAT messages with a fixed width numeric parameter
+// the message is written in one pass into the caller's buffer: no strcpy,
+// strcat or strlen. Digits are found by subtracting powers of ten, so no
+// division is needed; widths up to 4 digits use 16 bit arithmetic.
+//
+// FormatCATNumeric<eZZZE>(Msg, Param) takes the command letter, width,
+// range and sign from the command list when compiling, so the AVR code
+// for each command is just the digit loop with constants.
+// FormatCATMessageNumeric() (tiger.cpp) does the same for a command
+// only known when running.
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __CATFORMAT_H
+#define __CATFORMAT_H
+#include <Arduino.h>
+#include "tiger.h"
+
+
+//
+// compile time copies of the command list fields
+//
+constexpr char GCATFormatLetter[] =
+{
+#define X(Cmd, RXType, MinValue, MaxValue, NumParams, AlwaysSigned) #Cmd[3],
+  CATCOMMANDLIST
+#undef X
+};
+
+constexpr byte GCATFormatWidth[] =
+{
+#define X(Cmd, RXType, MinValue, MaxValue, NumParams, AlwaysSigned) NumParams,
+  CATCOMMANDLIST
+#undef X
+};
+
+constexpr long GCATFormatMin[] =
+{
+#define X(Cmd, RXType, MinValue, MaxValue, NumParams, AlwaysSigned) MinValue,
+  CATCOMMANDLIST
+#undef X
+};
+
+constexpr long GCATFormatMax[] =
+{
+#define X(Cmd, RXType, MinValue, MaxValue, NumParams, AlwaysSigned) MaxValue,
+  CATCOMMANDLIST
+#undef X
+};
+
+constexpr bool GCATFormatSigned[] =
+{
+#define X(Cmd, RXType, MinValue, MaxValue, NumParams, AlwaysSigned) AlwaysSigned,
+  CATCOMMANDLIST
+#undef X
+};
+
+#define VMAXCATDIGITS 10                                    // widest parameter
+extern const unsigned long GCATPowersOf10[VMAXCATDIGITS - 1];       // 10^9 down to 10
+extern const unsigned int GCATShortPowersOf10[3];                   // 1000, 100, 10
+
+
+//
+// write Width digits of Value, with leading zeros
+// each digit is found by counting subtractions of its power of ten
+//
+inline char* WriteCATDigits16(char* Ptr, unsigned int Value, byte Width)
+{
+  const unsigned int* Power = GCATShortPowersOf10 + (4 - Width);
+  unsigned int Step;
+  char Ch;
+
+  while (Width > 1)
+  {
+    Step = *Power++;
+    Ch = '0';
+    while (Value >= Step)
+    {
+      Value -= Step;
+      Ch++;
+    }
+    *Ptr++ = Ch;
+    Width--;
+  }
+  *Ptr++ = (char)('0' + Value);
+  return Ptr;
+}
+
+
+inline char* WriteCATDigits32(char* Ptr, unsigned long Value, byte Width)
+{
+  const unsigned long* Power = GCATPowersOf10 + (VMAXCATDIGITS - Width);
+  unsigned long Step;
+  char Ch;
+
+  while (Width > 1)
+  {
+    Step = *Power++;
+    Ch = '0';
+    while (Value >= Step)
+    {
+      Value -= Step;
+      Ch++;
+    }
+    *Ptr++ = Ch;
+    Width--;
+  }
+  *Ptr++ = (char)('0' + Value);
+  return Ptr;
+}
+
+
+//
+// format "ZZZx", the parameter clipped to its range and padded to its width
+// (including any sign), and ";" into Msg. Returns the message length.
+//
+inline byte FormatCATFields(char* Msg, char Letter, byte Width, long MinValue, long MaxValue, bool AlwaysSigned, long Param)
+{
+  char* Ptr = Msg;
+  unsigned long Value;
+
+  *Ptr++ = 'Z';
+  *Ptr++ = 'Z';
+  *Ptr++ = 'Z';
+  *Ptr++ = Letter;
+  if (Param > MaxValue)
+    Param = MaxValue;
+  else if (Param < MinValue)
+    Param = MinValue;
+  if (Param < 0)
+  {
+    *Ptr++ = '-';
+    Value = -Param;
+    Width--;
+  }
+  else
+  {
+    if (AlwaysSigned)
+    {
+      *Ptr++ = '+';
+      Width--;
+    }
+    Value = Param;
+  }
+  if (Width == 0)
+    Width = 1;
+  if (Width <= 4)
+    Ptr = WriteCATDigits16(Ptr, (unsigned int)Value, Width);
+  else
+    Ptr = WriteCATDigits32(Ptr, Value, Width);
+  *Ptr++ = ';';
+  *Ptr = 0;
+  return (byte)(Ptr - Msg);
+}
+
+
+//
+// format a message for a command known when compiling
+//
+template <ECATCommands Cmd>
+inline byte FormatCATNumeric(char* Msg, long Param)
+{
+  static_assert(GCATFormatWidth[Cmd] <= VMAXCATDIGITS, "CAT parameter too wide");
+  return FormatCATFields(Msg, GCATFormatLetter[Cmd], GCATFormatWidth[Cmd], GCATFormatMin[Cmd],
+                         GCATFormatMax[Cmd], GCATFormatSigned[Cmd], Param);
+}
+
+
+#endif // not defined
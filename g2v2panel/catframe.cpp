@@ -0,0 +1,138 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// catframe.cpp
+// binary event frames: see catframe.h for the format
+/////////////////////////////////////////////////////////////////////////
+
+#include "catframe.h"
+
+
+//
+// CRC-8 of a number of bytes: polynomial x^8 + x^2 + x + 1, initial value 0
+//
+byte CATFrameCRC(const byte* Data, byte Length)
+{
+  byte CRC = 0;
+  byte Bit;
+
+  while (Length--)
+  {
+    CRC ^= *Data++;
+    for (Bit = 0; Bit < 8; Bit++)
+      CRC = (CRC & 0x80) ? (byte)((CRC << 1) ^ 0x07) : (byte)(CRC << 1);
+  }
+  return CRC;
+}
+
+
+//
+// make a frame
+// the value is clipped to what the frame type can carry
+//
+void MakeCATFrame(byte* Frame, ECATFrameType Type, byte Seq, byte Control, int Value)
+{
+  byte Payload;
+
+  switch(Type)
+  {
+    case eFrameVFO:
+      Payload = (byte)(int8_t)constrain(Value, -VMAXFRAMEVFOSTEPS, VMAXFRAMEVFOSTEPS);
+      break;
+
+    case eFrameEncoder:
+      Payload = (byte)((Control << 4) | (constrain(Value, -VMAXFRAMECLICKS, VMAXFRAMECLICKS) & 0x0F));
+      break;
+
+    default:
+    case eFrameButton:
+      Payload = (byte)((constrain(Control, 0, VMAXFRAMEBUTTON) << 2) | (Value & 3));
+      break;
+  }
+  Frame[0] = 0x80 | ((byte)Type << 4) | (Seq & 0x0F);
+  Frame[1] = Payload;
+  Frame[2] = CATFrameCRC(Frame, 2);
+}
+
+
+//
+// decoder
+//
+void InitCATFrameDecoder(SCATFrameDecoder* Decoder)
+{
+  Decoder->Count = 0;
+  Decoder->NextSeq = 0;
+  Decoder->SeqValid = false;
+  Decoder->Frames = 0;
+  Decoder->CRCErrors = 0;
+  Decoder->Missed = 0;
+}
+
+
+//
+// decode one received byte
+// between frames, a byte with the top bit set starts a frame; anything else is text
+// after a bad CRC, the first byte is dropped and the rest are kept from the next
+// header byte on, so the decoder resyncs one byte at a time. Text bytes taken into
+// a bad frame are lost with it.
+//
+ECATDecodeResult DecodeCATFrameByte(SCATFrameDecoder* Decoder, byte Ch, SCATFrameEvent* Event)
+{
+  byte Seq;
+  byte Payload;
+  byte Cntr, Kept;
+
+  if (Decoder->Count == 0)
+  {
+    if ((Ch & 0x80) == 0)
+      return eDecodeText;
+  }
+  Decoder->Frame[Decoder->Count++] = Ch;
+  if (Decoder->Count < VCATFRAMESIZE)
+    return eDecodeNone;
+
+  Decoder->Count = 0;
+  if (CATFrameCRC(Decoder->Frame, 2) != Decoder->Frame[2])
+  {
+    Decoder->CRCErrors++;
+    Kept = 0;
+    for (Cntr = 1; Cntr < VCATFRAMESIZE; Cntr++)
+      if ((Kept != 0) || (Decoder->Frame[Cntr] & 0x80))
+        Decoder->Frame[Kept++] = Decoder->Frame[Cntr];
+    Decoder->Count = Kept;
+    return eDecodeError;
+  }
+  Seq = Decoder->Frame[0] & 0x0F;
+  if (Decoder->SeqValid)
+    Decoder->Missed += (Seq - Decoder->NextSeq) & 0x0F;
+  Decoder->NextSeq = (Seq + 1) & 0x0F;
+  Decoder->SeqValid = true;
+  Decoder->Frames++;
+
+  Payload = Decoder->Frame[1];
+  Event->Type = (ECATFrameType)((Decoder->Frame[0] >> 4) & 0x07);
+  Event->Seq = Seq;
+  switch(Event->Type)
+  {
+    case eFrameVFO:
+      Event->Control = 0;
+      Event->Value = (int8_t)Payload;
+      break;
+
+    case eFrameEncoder:
+      Event->Control = Payload >> 4;
+      Event->Value = (Payload & 0x08) ? (int)(Payload & 0x0F) - 16 : (Payload & 0x0F);
+      break;
+
+    default:
+      Event->Control = Payload >> 2;
+      Event->Value = Payload & 3;
+      break;
+  }
+  return eDecodeEvent;
+}
@@ -0,0 +1,99 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// catframe.h
+// binary event frames, an opt-in alternative to ASCII CAT event messages
+// (selected by ZZZF1;). This file is shared with the host tools, which use the decoder.
+//
+// each frame is 3 bytes:
+//   header:  1TTTSSSS   T = frame type, S = sequence number (counts frames, 0-15)
+//   payload: VFO:     signed steps (-127 to +127)
+//            encoder: EEEEDDDD  E = encoder number (0-9), D = signed clicks (-7 to +7)
+//            button:  BBBBBBSS  B = button number (0-63), S = 0 released, 1 pressed, 2 long pressed
+//   CRC-8:   polynomial 0x07, initial value 0, over the header and payload
+// ASCII characters are all below 0x80, so the host can tell frame headers from
+// ASCII replies, which are still sent as text
+// payload and CRC bytes can have bit 7 set too, so after a lost byte the decoder
+// can take a payload or CRC byte as a header. Only the CRC catches this (a false
+// frame gets through 1 time in 256). After a bad CRC the decoder moves on one
+// byte, not one frame, and looks for a header in the bytes it had collected.
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __CATFRAME_H
+#define __CATFRAME_H
+#include <Arduino.h>
+
+
+#define VCATFRAMESIZE 3                     // bytes in one frame
+#define VMAXFRAMEVFOSTEPS 127               // max VFO steps in one frame
+#define VMAXFRAMECLICKS 7                   // max encoder clicks in one frame
+#define VMAXFRAMEBUTTON 63                  // highest button number
+
+
+enum ECATFrameType
+{
+  eFrameVFO,                                // VFO steps
+  eFrameEncoder,                            // encoder clicks
+  eFrameButton                              // button state
+};
+
+
+//
+// make a frame into Frame (VCATFRAMESIZE bytes)
+// Value = steps, clicks or button state
+//
+void MakeCATFrame(byte* Frame, ECATFrameType Type, byte Seq, byte Control, int Value);
+
+
+//
+// CRC-8 of a number of bytes
+//
+byte CATFrameCRC(const byte* Data, byte Length);
+
+
+//
+// decoder, for the host end
+//
+enum ECATDecodeResult
+{
+  eDecodeNone,                              // byte used, nothing complete yet
+  eDecodeText,                              // an ASCII character, not part of a frame
+  eDecodeEvent,                             // a frame completed
+  eDecodeError                              // a frame failed its CRC and was dropped
+};
+
+struct SCATFrameEvent
+{
+  ECATFrameType Type;
+  byte Control;                             // encoder or button number; 0 for VFO
+  int Value;                                // steps, clicks or button state
+  byte Seq;
+};
+
+struct SCATFrameDecoder
+{
+  byte Frame[VCATFRAMESIZE];                // frame being collected
+  byte Count;                               // bytes collected
+  byte NextSeq;                             // expected next sequence number
+  bool SeqValid;                            // false until the first frame is decoded
+  unsigned long Frames;                     // good frames
+  unsigned long CRCErrors;                  // frames dropped for bad CRC (a lost byte can cause several)
+  unsigned long Missed;                     // frames missed, from sequence number gaps
+};
+
+
+void InitCATFrameDecoder(SCATFrameDecoder* Decoder);
+
+//
+// decode one received byte
+// for eDecodeEvent, Event is filled in
+//
+ECATDecodeResult DecodeCATFrameByte(SCATFrameDecoder* Decoder, byte Ch, SCATFrameEvent* Event);
+
+
+#endif // not defined
@@ -16,7 +16,12 @@
 #include "cathandler.h"
 #include "configdata.h"
 #include "encoders.h"
+#include "button.h"
+#include "SPIdata.h"
 #include "led.h"
+#include "opticalencoder.h"
+#include "txqueue.h"
+#include "scheduler.h"
 #include <stdlib.h>
 
 
@@ -25,7 +30,7 @@
 //
 int ClipParameter(int Param, ECATCommands Cmd)
 {
-  SCATCommands* StructPtr;
+  const SCATCommands* StructPtr;
 
   StructPtr = GCATCommands + (int)Cmd;
 //
@@ -43,45 +48,26 @@ int ClipParameter(int Param, ECATCommands Cmd)
 
 //
 // VFO encoder: simply request N steps up or down
+// steps are queued, merging with any not yet sent
+// Time = when the first of them was detected (TimebaseMicros())
 //
-void CATHandleVFOEncoder(signed char Clicks)
+void CATHandleVFOEncoder(int Clicks, unsigned long Time)
 {
-  
-  if (Clicks != 0)
-  {
-    if (Clicks < 0)
-      MakeCATMessageNumeric(eZZZD, -Clicks);
-    else
-      MakeCATMessageNumeric(eZZZU, Clicks);
-  }
+  QueueVFOSteps(Clicks, Time);
 }
 
 
 //
 // other encoder: request N steps up or down
 // Encoder number internally is 0-(N-1) in normal C style
+// clicks are queued, merging with any not yet sent for the same encoder.
+// any number can be queued: the TX queue splits them into ZZZE messages of
+// at most 9 clicks as it sends them
+// Time = when they were detected (TimebaseMicros())
 //
-void CATHandleEncoder(byte Encoder, char Clicks)
+void CATHandleEncoder(byte Encoder, int Clicks, unsigned long Time)
 {
-  int Param;
-
-  if (Clicks > 0)                           // clockwise turn, non zero clicks
-  {
-    if (Clicks > 9)                         // clip value at max 9 clicks
-      Clicks=9;
-    Param = (Encoder + 1) * 10;
-    Param += Clicks;
-    MakeCATMessageNumeric(eZZZE, Param);
-  }
-  else if (Clicks < 0)                      // anticlockwise turn, non zero clicks
-  {
-    Clicks = -Clicks;
-    if (Clicks > 9)                         // clip value at max 9 clicks
-      Clicks=9;
-    Param = (Encoder + 51) * 10;
-    Param += Clicks;
-    MakeCATMessageNumeric(eZZZE, Param);
-  }
+  QueueEncoderClicks(Encoder, Clicks, Time);
 }
 
 
@@ -89,8 +75,9 @@ void CATHandleEncoder(byte Encoder, char Clicks)
 //
 // pushbutton: set pressed or unpressed state
 // Button number internally is 0..(N-1) in normal C style
+// Time = when the change was detected (TimebaseMicros())
 //
-void CATHandlePushbutton(byte Button, bool IsPressed, bool IsLongPressed)
+void CATHandlePushbutton(byte Button, bool IsPressed, bool IsLongPressed, unsigned long Time)
 {
   int Param;
 
@@ -99,7 +86,7 @@ void CATHandlePushbutton(byte Button, bool IsPressed, bool IsLongPressed)
     Param += 2;
   else if (IsPressed)
     Param += 1;
-  MakeCATMessageNumeric(eZZZP, Param);
+  QueueCATEvent(eZZZP, Param, Time);
 }
 
 
@@ -131,10 +118,250 @@ void MakeEncoderIncrementMessage(void)
 }
 
 
+//
+// function to send back the encoder reporting mode
+//
+void MakeEncoderModeMessage(void)
+{
+  MakeCATMessageNumeric(eZZZM, GEncoderCountingMode ? 1 : 0);
+}
+
+
+//
+// function to send back a diagnostic value
+// reply parameter = item number (2 digits) then value (7 digits)
+//
+#define VMAXDIAGVALUE 9999999L
+#define VDIAGITEMSCALE 10000000L
+static_assert(eNumTasks <= eDiagTaskOverruns - eDiagTaskRuns, "too many tasks for the ZZZG task items");
+
+void MakeDiagnosticMessage(byte Item)
+{
+  unsigned long Value = 0;
+
+  switch(Item)
+  {
+    case eDiagVFOOverflows:
+      noInterrupts();
+      Value = GVFOOverflowCount;
+      interrupts();
+      break;
+
+    case eDiagTXHighWater:
+      Value = GTXQueueHighWater;
+      break;
+
+    case eDiagTXMerges:
+      Value = GTXQueueMerges;
+      break;
+
+    case eDiagTXDrops:
+      Value = GTXQueueDrops;
+      break;
+
+    case eDiagSampleJitter:
+      noInterrupts();
+      if (GSampleLatencyMax >= GSampleLatencyMin)
+        Value = (unsigned long)(GSampleLatencyMax - GSampleLatencyMin) * VTIMERCOUNTNS;
+      interrupts();
+      break;
+
+    case eDiagSampleLatency:
+      noInterrupts();
+      Value = (unsigned long)GSampleLatencyMax * VTIMERCOUNTNS;
+      interrupts();
+      break;
+
+    case eDiagSampleOverruns:
+      noInterrupts();
+      Value = GSampleOverruns;
+      interrupts();
+      break;
+
+    case eDiagSPITime:
+      if (GSPITickCount != 0)
+        Value = GSPITotalCounts * VTIMERCOUNTNS / GSPITickCount;
+      GSPITotalCounts = 0;
+      GSPITickCount = 0;
+      break;
+
+    case eDiagSPIMaxTime:
+      Value = (unsigned long)GSPIMaxCounts * VTIMERCOUNTNS;
+      break;
+
+    case eDiagTickOverruns:
+      Value = GTickOverruns;
+      break;
+
+    case eDiagLostTicks:
+      Value = GLostTicks;
+      break;
+
+    case eDiagWorstTickGap:
+      Value = GWorstTickGap;
+      break;
+
+    default:
+      if ((Item >= eDiagTaskRuns) && (Item < eDiagTaskRuns + eNumTasks))
+      {
+        Value = GTaskRuns[Item - eDiagTaskRuns];
+        GTaskRuns[Item - eDiagTaskRuns] = 0;
+      }
+      else if ((Item >= eDiagTaskOverruns) && (Item < eDiagTaskOverruns + eNumTasks))
+      {
+        Value = GTaskOverruns[Item - eDiagTaskOverruns];
+        GTaskOverruns[Item - eDiagTaskOverruns] = 0;
+      }
+      break;
+  }
+  if (Value > VMAXDIAGVALUE)
+    Value = VMAXDIAGVALUE;
+  MakeCATMessageNumeric(eZZZG, (long)Item * VDIAGITEMSCALE + (long)Value);
+}
+
+
+//
+// function to send back the acceleration settings: one message per encoder class
+// parameter = class (1=VFO, 2=mechanical), threshold (2 digits), gain (2 digits)
+//
+static_assert(eNumAccelClasses <= VMAXCATREPLIES, "ZZZA reply longer than VMAXCATREPLIES");
+
+void MakeAccelerationMessages(void)
+{
+  byte Class;
+
+  for (Class = 0; Class < eNumAccelClasses; Class++)
+    MakeCATMessageNumeric(eZZZA, (long)(Class + 1) * 10000L + GAccelThreshold[Class] * 100 + GAccelGain[Class]);
+}
+
+
+//
+// function to send back the debounce policy: one message per button class
+// parameter = class (1=panel, 2=encoder, 3=shift), then 1 if eager debounce
+//
+static_assert(eNumButtonClasses <= VMAXCATREPLIES, "ZZZK reply longer than VMAXCATREPLIES");
+
+void MakeDebouncePolicyMessages(void)
+{
+  byte Class;
+
+  for (Class = 0; Class < eNumButtonClasses; Class++)
+    MakeCATMessageNumeric(eZZZK, (Class + 1) * 10 + ((GEagerButtonClasses >> Class) & 1));
+}
+
+
+//
+// function to send back the LED brightness settings
+// parameter = LED (00 for the whole panel, then 01-11), then level 0-7
+//
+static_assert(VMAXINDICATORS + 1 <= VMAXCATREPLIES, "ZZZL reply longer than VMAXCATREPLIES");
+
+void MakeLEDBrightnessMessages(void)
+{
+  byte LED;
+
+  MakeCATMessageNumeric(eZZZL, GPanelBrightness);
+  for (LED = 0; LED < VMAXINDICATORS; LED++)
+    MakeCATMessageNumeric(eZZZL, (LED + 1) * 10 + GLEDBrightness[LED]);
+}
+
+
+//
+// function to send back the LED patterns
+// parameter = LED (01-11), pattern (ELEDPattern), period (x 200ms)
+//
+static_assert(VMAXINDICATORS <= VMAXCATREPLIES, "ZZZN reply longer than VMAXCATREPLIES");
+
+void MakeLEDPatternMessages(void)
+{
+  byte LED;
+
+  for (LED = 0; LED < VMAXINDICATORS; LED++)
+    MakeCATMessageNumeric(eZZZN, (LED + 1) * 100 + GLEDPatterns[LED] * 10 + GLEDPatternPeriods[LED]);
+}
+
+
+#ifdef TASKPROFILE
+//
+// task profile messages (ZZZW)
+// parameter = task (2 digits: ETasks, then VPROFILETICK = whole tick), statistic (1 digit), value (6 digits)
+//
+#define VMAXPROFILEVALUE 999999L
+#define VPROFILETASKSCALE 10000000L
+#define VPROFILESTATSCALE 1000000L
+
+void MakeTaskProfileMessage(byte Entry, byte Stat)
+{
+  STaskProfile* Profile;
+  unsigned long Value = 0;
+
+  Profile = GTaskProfiles + Entry;
+  if (Profile->Runs != 0)
+  {
+    switch(Stat)
+    {
+      case eProfileRuns:
+        Value = Profile->Runs;
+        break;
+
+      case eProfileMin:
+        Value = (unsigned long)Profile->MinCounts * VTIMERCOUNTNS / 1000;
+        break;
+
+      case eProfileMean:
+        Value = Profile->TotalCounts / Profile->Runs * VTIMERCOUNTNS / 1000;
+        break;
+
+      case eProfileMax:
+        Value = (unsigned long)Profile->MaxCounts * VTIMERCOUNTNS / 1000;
+        break;
+
+      default:
+        Value = Profile->Histogram[Stat - eProfileHistogram];
+        break;
+    }
+  }
+  if (Value > VMAXPROFILEVALUE)
+    Value = VMAXPROFILEVALUE;
+  MakeCATMessageNumeric(eZZZW, (long)Entry * VPROFILETASKSCALE + (long)Stat * VPROFILESTATSCALE + (long)Value);
+}
+
+
+//
+// all of the statistics for one task, or for the whole tick
+//
+static_assert(eProfileHistogram + VPROFILEBINS <= VMAXCATREPLIES, "ZZZW reply longer than VMAXCATREPLIES");
+
+void MakeTaskProfileMessages(byte Entry)
+{
+  byte Stat;
+
+  if ((Entry < eNumTasks) || (Entry == VPROFILETICK))
+    for (Stat = 0; Stat < eProfileHistogram + VPROFILEBINS; Stat++)
+      MakeTaskProfileMessage(Entry, Stat);
+}
+
+
+//
+// summary: the longest run of each task, then of the whole tick
+//
+static_assert(eNumTasks + 1 <= VMAXCATREPLIES, "ZZZW; reply longer than VMAXCATREPLIES");
+
+void MakeTaskProfileSummary(void)
+{
+  byte Task;
+
+  for (Task = 0; Task < eNumTasks; Task++)
+    MakeTaskProfileMessage(Task, eProfileMax);
+  MakeTaskProfileMessage(VPROFILETICK, eProfileMax);
+}
+#endif
+
+
 //
 // handle CAT commands with numerical parameters
 //
-void HandleCATCommandNumParam(ECATCommands MatchedCAT, int ParsedParam)
+void HandleCATCommandNumParam(ECATCommands MatchedCAT, long ParsedParam)
 {
   int Device;
   byte Param;
@@ -165,6 +392,86 @@ void HandleCATCommandNumParam(ECATCommands MatchedCAT, int ParsedParam)
       CopySettingsToEEprom();
       SetEncoderDivisors(GEncoderDivisor, GVFOEncoderDivisor);
       break;
+
+    case eZZZM:                                                       // set encoder reporting mode
+      GEncoderCountingMode = (ParsedParam != 0);
+      CopySettingsToEEprom();
+      break;
+
+    case eZZZG:                                                       // diagnostic value request
+      if (ParsedParam > 99)                                           // only 2 digits of item number
+        ParsedParam = eDiagNone;
+      MakeDiagnosticMessage((byte)ParsedParam);
+      break;
+
+#ifdef TASKPROFILE
+    case eZZZW:                                                       // task profile request, or 99 to clear
+      if (ParsedParam == 99)
+        ClearTaskProfiles();
+      else if (ParsedParam <= VPROFILETICK)
+        MakeTaskProfileMessages((byte)ParsedParam);
+      break;
+#endif
+
+    case eZZZV:                                                       // set VFO report policy
+      GVFOReportPolicy = ParsedParam;
+      CopySettingsToEEprom();
+      break;
+
+    case eZZZB:                                                       // change CAT link baud rate
+      RequestCATBaudRate(ParsedParam);
+      break;
+
+    case eZZZF:                                                       // binary frame mode: events framed from now on
+      MakeCATMessageNumeric(eZZZF, ParsedParam);
+      SetTXFrameMode(ParsedParam != 0);
+      break;
+
+    case eZZZT:                                                       // set event timestamp mode
+      SetTXTimestampMode(ParsedParam);
+      break;
+
+    case eZZZA:                                                       // set acceleration curve for one class
+      Device = ParsedParam / 10000 - 1;                               // top digit = class
+      if (Device < eNumAccelClasses)
+      {
+        GAccelThreshold[Device] = (ParsedParam / 100) % 100;
+        GAccelGain[Device] = ParsedParam % 100;
+        CopySettingsToEEprom();
+      }
+      break;
+
+    case eZZZK:                                                       // set debounce policy for one button class
+      Device = ParsedParam / 10 - 1;                                  // top digit = class
+      if (Device < eNumButtonClasses)
+      {
+        if (ParsedParam % 10)
+          GEagerButtonClasses |= (1 << Device);
+        else
+          GEagerButtonClasses &= ~(1 << Device);
+        CopySettingsToEEprom();
+        SetButtonDebouncePolicy();
+      }
+      break;
+
+    case eZZZL:                                                       // set LED brightness
+      Device = ParsedParam / 10;                                      // top digits = LED, or 0 for all
+      Param = ParsedParam % 10;
+      if ((Device <= VMAXINDICATORS) && (Param <= VMAXLEDLEVEL))
+      {
+        if (Device == 0)
+          GPanelBrightness = Param;
+        else
+          GLEDBrightness[Device - 1] = Param;
+        CopySettingsToEEprom();
+        SetLEDBrightness();
+      }
+      break;
+
+    case eZZZN:                                                       // set LED pattern
+      Device = ParsedParam / 100 - 1;                                 // top digits = LED
+      SetLEDPattern(Device, (ParsedParam / 10) % 10, ParsedParam % 10);
+      break;
   }
 }
 
@@ -183,5 +490,47 @@ void HandleCATCommandNoParam(ECATCommands MatchedCAT)
     case eZZZX:                                                       // encoder increment reply
       MakeEncoderIncrementMessage();
       break;
+
+    case eZZZM:                                                       // encoder reporting mode reply
+      MakeEncoderModeMessage();
+      break;
+
+    case eZZZV:                                                       // VFO report policy reply
+      MakeCATMessageNumeric(eZZZV, GVFOReportPolicy);
+      break;
+
+    case eZZZF:                                                       // binary frame mode reply
+      MakeCATMessageNumeric(eZZZF, GetTXFrameMode() ? 1 : 0);
+      break;
+
+    case eZZZT:                                                       // event timestamp mode reply
+      MakeCATMessageNumeric(eZZZT, GetTXTimestampMode());
+      break;
+
+    case eZZZB:                                                       // baud rate reply
+      MakeCATMessageNumeric(eZZZB, GetCATBaudCode());
+      break;
+
+    case eZZZA:                                                       // acceleration settings reply
+      MakeAccelerationMessages();
+      break;
+
+    case eZZZK:                                                       // debounce policy reply
+      MakeDebouncePolicyMessages();
+      break;
+
+    case eZZZL:                                                       // LED brightness reply
+      MakeLEDBrightnessMessages();
+      break;
+
+    case eZZZN:                                                       // LED pattern reply
+      MakeLEDPatternMessages();
+      break;
+
+#ifdef TASKPROFILE
+    case eZZZW:                                                       // task profile summary
+      MakeTaskProfileSummary();
+      break;
+#endif
   }
 }
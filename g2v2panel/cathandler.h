@@ -16,14 +16,55 @@
 
 
 
+//
+// diagnostic values that can be read with ZZZG
+// the host sends ZZZGnn; the reply is ZZZGnnvvvvvvv; with the value clipped to 7 digits
+//
+enum EDiagnosticItems
+{
+  eDiagNone,                      // not used
+  eDiagVFOOverflows,              // VFO encoder edges lost to a full accumulator
+  eDiagTXHighWater,               // max events ever in the TX queue
+  eDiagTXMerges,                  // VFO/encoder steps merged into a queued event
+  eDiagTXDrops,                   // messages dropped because the TX queue was full
+  eDiagSampleJitter,              // input sampling jitter (ns): most - least delay after the timer
+  eDiagSampleLatency,             // most input sampling delay after the timer (ns)
+  eDiagSampleOverruns,            // input sample buffers overwritten before the main loop read them
+  eDiagSPITime,                   // mean main loop SPI time per tick (ns) since last read
+  eDiagSPIMaxTime,                // most main loop SPI time in one tick (ns)
+  eDiagTaskRuns = 10,             // 10-19: runs of task (item - 10) since last read (see TASKLIST)
+  eDiagTaskOverruns = 20,         // 20-29: runs of task (item - 20) over its budget since last read
+  eDiagTickOverruns = 30,         // main loop passes that missed one or more ticks
+  eDiagLostTicks,                 // total ticks missed by the main loop
+  eDiagWorstTickGap               // most ticks between main loop ticks (1 = none ever missed)
+};
+
+
+
+//
+// task profile statistics that can be read with ZZZW
+// the host sends ZZZWnn for task nn (ETasks, then one more for the whole tick); the reply is one
+// ZZZWnnsvvvvvv; per statistic s, with the value clipped to 6 digits
+//
+enum EProfileStats
+{
+  eProfileRuns,                   // runs since the profiles were cleared (ZZZW99)
+  eProfileMin,                    // shortest run (us)
+  eProfileMean,                   // mean run (us)
+  eProfileMax,                    // longest run (us)
+  eProfileHistogram               // 4-9: runs in histogram bins 0-5 (see STaskProfile)
+};
+
+
 //
 // generate output messages for local control events
+// Time = when the input was detected (TimebaseMicros())
 //
-void CATHandleVFOEncoder(signed char Clicks);
+void CATHandleVFOEncoder(int Clicks, unsigned long Time);
 
-void CATHandleEncoder(byte Encoder, char Clicks);
+void CATHandleEncoder(byte Encoder, int Clicks, unsigned long Time);
 
-void CATHandlePushbutton(byte Button, bool IsPressed, bool IsLongPressed);
+void CATHandlePushbutton(byte Button, bool IsPressed, bool IsLongPressed, unsigned long Time);
 
 
 
@@ -31,7 +72,7 @@ void CATHandlePushbutton(byte Button, bool IsPressed, bool IsLongPressed);
 //
 // handlers for received CAT commands
 //
-void HandleCATCommandNumParam(ECATCommands MatchedCAT, int ParsedParam);
+void HandleCATCommandNumParam(ECATCommands MatchedCAT, long ParsedParam);
 void HandleCATCommandNoParam(ECATCommands MatchedCAT);
 
 
@@ -13,23 +13,42 @@
 #include <Arduino.h>
 #include "globalinclude.h"
 #include "encoders.h"
+#include "button.h"
+#include "led.h"
 
 #include <EEPROM.h>
 
 #define VEEINITPATTERN 0x6E                     // addr 0 set to this if configured
+#define VDEFAULTVFOPOLICY 10                    // adaptive VFO reports, max window 10 ticks
+#define VMAXVFOPOLICY 99
+#define VMAXACCELSETTING 99                     // max acceleration threshold or gain
 
 byte GEncoderDivisor;                                // number of edge events per declared click
 byte GVFOEncoderDivisor;                             // number of edge events per declared click
+bool GEncoderCountingMode;                           // true if encoders report every click, not just 1 per tick
+byte GVFOReportPolicy;                               // 0: VFO reported every 20ms; else max report window (ticks)
+byte GAccelThreshold[eNumAccelClasses];              // acceleration starts above this speed (steps per 100ms)
+byte GAccelGain[eNumAccelClasses];                   // acceleration gain (1/16 per step per 100ms); 0 = off
+byte GEagerButtonClasses;                            // 1 bit per button class (EButtonClass): 1 = eager debounce
+byte GPanelBrightness;                               // brightness of all LEDs, 0-7
+byte GLEDBrightness[VMAXINDICATORS];                 // brightness of each LED, 0-7
 
 
 
 //
 // function to copy all config settings to EEprom
 // this copies the current RAM vaiables to the persistent storage
+// only bytes that have changed are written: an EEPROM write takes milliseconds
+// and wears the cell, and a CAT command changes one setting at a time
 // addr 0: defined pattern (to know EEPROM has been initialised)
 // addr 1: normal encoder events per step
 // addr 2: VFO encoder events per steo
-// addr 3: display brightness
+// addr 3: panel LED brightness
+// addr 4: encoder reporting mode (1 = counting)
+// addr 5: VFO report policy
+// addr 6-9: acceleration threshold and gain for VFO, then mechanical encoders
+// addr 10: button classes using eager debounce (1 bit per class)
+// addr 11-21: brightness of each LED
 //
 void CopySettingsToEEprom(void)
 {
@@ -40,14 +59,27 @@ void CopySettingsToEEprom(void)
 //
 // first set that we have initialised the EEprom
 //
-  EEPROM.write(0, VEEINITPATTERN);
+  EEPROM.update(0, VEEINITPATTERN);
 //
 // now copy settings from RAM data
 //
   Setting = (byte) GEncoderDivisor;
-  EEPROM.write(Addr++, Setting);
+  EEPROM.update(Addr++, Setting);
   Setting = (byte) GVFOEncoderDivisor;
-  EEPROM.write(Addr++, Setting);
+  EEPROM.update(Addr++, Setting);
+  EEPROM.update(Addr++, GPanelBrightness);
+  Setting = (byte) GEncoderCountingMode;
+  EEPROM.update(Addr++, Setting);
+  Setting = GVFOReportPolicy;
+  EEPROM.update(Addr++, Setting);
+  for (Cntr = 0; Cntr < eNumAccelClasses; Cntr++)
+  {
+    EEPROM.update(Addr++, GAccelThreshold[Cntr]);
+    EEPROM.update(Addr++, GAccelGain[Cntr]);
+  }
+  EEPROM.update(Addr++, GEagerButtonClasses);
+  for (Cntr = 0; Cntr < VMAXINDICATORS; Cntr++)
+    EEPROM.update(Addr++, GLEDBrightness[Cntr]);
 }
 
 
@@ -63,6 +95,17 @@ void InitialiseEEprom(void)
   
   GEncoderDivisor = 2;                          // OK for the dual shaft encoders
   GVFOEncoderDivisor = 1;                       // max turn rate for Broadcom encoder (set to 4 for larger optical one)
+  GEncoderCountingMode = false;                 // original 1 click per tick reporting
+  GVFOReportPolicy = VDEFAULTVFOPOLICY;         // adaptive, at most 20ms
+  for (Cntr = 0; Cntr < eNumAccelClasses; Cntr++)
+  {
+    GAccelThreshold[Cntr] = 0;                  // no acceleration
+    GAccelGain[Cntr] = 0;
+  }
+  GEagerButtonClasses = 0;                      // all buttons wait for a stable input
+  GPanelBrightness = VMAXLEDLEVEL;              // all LEDs at full brightness
+  for (Cntr = 0; Cntr < VMAXINDICATORS; Cntr++)
+    GLEDBrightness[Cntr] = VMAXLEDLEVEL;
  
 // now copy them to FLASH
   CopySettingsToEEprom();
@@ -91,7 +134,35 @@ void LoadSettingsFromEEprom(void)
 //
   GEncoderDivisor = (byte)EEPROM.read(Addr++);
   GVFOEncoderDivisor = (byte)EEPROM.read(Addr++);
+  GPanelBrightness = (byte)EEPROM.read(Addr++);
+  if (GPanelBrightness > VMAXLEDLEVEL)                  // unprogrammed: full brightness
+    GPanelBrightness = VMAXLEDLEVEL;
+  GEncoderCountingMode = (EEPROM.read(Addr++) == 1);    // unprogrammed (0xFF) = off
+  GVFOReportPolicy = (byte)EEPROM.read(Addr++);
+  if (GVFOReportPolicy > VMAXVFOPOLICY)                 // unprogrammed
+    GVFOReportPolicy = VDEFAULTVFOPOLICY;
+  for (Cntr = 0; Cntr < eNumAccelClasses; Cntr++)
+  {
+    GAccelThreshold[Cntr] = (byte)EEPROM.read(Addr++);
+    GAccelGain[Cntr] = (byte)EEPROM.read(Addr++);
+    if ((GAccelThreshold[Cntr] > VMAXACCELSETTING) || (GAccelGain[Cntr] > VMAXACCELSETTING))
+    {                                                   // unprogrammed: no acceleration
+      GAccelThreshold[Cntr] = 0;
+      GAccelGain[Cntr] = 0;
+    }
+  }
+  GEagerButtonClasses = (byte)EEPROM.read(Addr++);
+  if (GEagerButtonClasses >= (1 << eNumButtonClasses))  // unprogrammed
+    GEagerButtonClasses = 0;
+  for (Cntr = 0; Cntr < VMAXINDICATORS; Cntr++)
+  {
+    GLEDBrightness[Cntr] = (byte)EEPROM.read(Addr++);
+    if (GLEDBrightness[Cntr] > VMAXLEDLEVEL)            // unprogrammed: full brightness
+      GLEDBrightness[Cntr] = VMAXLEDLEVEL;
+  }
   SetEncoderDivisors(GEncoderDivisor, GVFOEncoderDivisor);
+  SetButtonDebouncePolicy();
+  SetLEDBrightness();
 }
 
 
@@ -12,6 +12,7 @@
 
 #ifndef __CONFIGDATA_H
 #define __CONFIGDATA_H
+#include "encoders.h"
 
 
 //
@@ -20,6 +21,13 @@
 //
 extern byte GEncoderDivisor;                                // number of edge events per declared click
 extern byte GVFOEncoderDivisor;                             // number of edge events per declared click
+extern bool GEncoderCountingMode;                           // true if encoders report every click, not just 1 per tick
+extern byte GVFOReportPolicy;                               // 0: VFO reported every 20ms; else max report window (ticks)
+extern byte GAccelThreshold[eNumAccelClasses];              // acceleration starts above this speed (steps per 100ms)
+extern byte GAccelGain[eNumAccelClasses];                   // acceleration gain (1/16 per step per 100ms); 0 = off
+extern byte GEagerButtonClasses;                            // 1 bit per button class (EButtonClass): 1 = eager debounce
+extern byte GPanelBrightness;                               // brightness of all LEDs, 0-7
+extern byte GLEDBrightness[VMAXINDICATORS];                 // brightness of each LED, 0-7
 
 //
 // function to copy all config settings to EEprom
@@ -15,7 +15,7 @@
 
 #include <Arduino.h>
 #include "globalinclude.h"
-#include "mechencoder2.h"
+#include "encoderslice.h"
 #include "opticalencoder.h"
 #include "cathandler.h"
 
@@ -25,12 +25,55 @@
 #include "button.h"
 #include "led.h"
 #include "SPIdata.h"
+#include "timebase.h"
 
 
 #define VVFOCYCLECOUNT 10                                // check every 10 ticks                                 
+#define VMAXVFOSTEPS 99                                  // max steps in one ZZZU/ZZZD message
+#define VVFOMSGBYTES 7                                   // length of a ZZZU/ZZZD message
 byte GMechEncoderDivisor;                                // number of edge events per declared click
 byte GVFOCycleCount;                                     // remaining ticks until we test the VFO encoder 
 
+//
+// adaptive VFO report scheduler (see VFOTick())
+//
+byte GVFOTicksSinceReport;                               // ticks since last ZZZU/ZZZD (saturates at 255)
+int16_t GVFOLastCount;                                   // accumulator count at the previous tick
+unsigned int GVFORate;                                   // smoothed edge rate: edges per tick * 16
+unsigned long GVFOStepMicros;                            // TimebaseMicros() when the oldest unreported step was seen
+byte GVFOLinkWindow;                                     // min ticks between VFO messages the CAT link can carry
+
+//
+// encoder acceleration
+//
+#define VMAXACCELERATION 16                              // max acceleration multiplier
+unsigned long GEncoderLastReport[VMAXENCODERS];          // TimebaseTicks() when each encoder last reported
+
+//
+// direct wired encoder sampling (see SampleDirectInputs())
+//
+volatile byte GInputSamples[2][VINPUTSAMPLESPERTICK];    // double buffer of samples
+volatile byte GSampleBuffer;                             // buffer the interrupt is filling
+volatile byte GSampleCount;                              // samples in it so far
+volatile bool GSamplesReady;                             // the other buffer is full, and not yet read
+volatile unsigned int GSampleLatencyMin = 0xFFFF;        // least timer counts from timer match to sample
+volatile unsigned int GSampleLatencyMax;                 // most timer counts from timer match to sample
+volatile unsigned int GSampleOverruns;                   // sample buffers overwritten before the main loop read them
+byte GDirectPrevious;                                    // previous raw sample
+byte GDirectFiltered;                                    // filtered direct wired encoder inputs
+
+//
+// MCP23S17 encoder inputs (see QueueEncoderReads())
+// one burst reads INTFA, INTFB, INTCAPA, INTCAPB, GPIOA, GPIOB (only GPIOA, GPIOB if polled)
+//
+#define VENCINTF 0                                       // positions in GMCPEncoderData
+#define VENCINTCAP 2
+#define VENCGPIO 4
+unsigned int GMCPEncoderInputs;                          // most recent 16 bit read
+byte GMCPKeepAliveCount;                                 // ticks until the next keep-alive read
+byte GMCPEncoderData[6];                                 // burst read data
+bool GMCPEncoderReadQueued;                              // true if a read was queued this tick
+
 
 //
 // note encoder numbering:
@@ -65,15 +108,11 @@ byte GVFOCycleCount;                                     // remaining ticks unti
 //
 //Encoder VFOEncoder(VPINVFOENCODERA, VPINVFOENCODERB);
 
-long old_ct;
-
-struct  EncoderData                           // holds data for one slow encoder
-{
-  NoClickEncoder2* Ptr;                          // ptr to class
-  int16_t LastPosition;                       // previous position
-};
-
-  EncoderData EncoderList[VMAXENCODERS];
+//
+// encoder number to bit sliced decoder pair number
+// pairs 0-7 are the 16 bit MCP23S17 input (2 bits each, bottom first); 8, 9 direct wired
+//
+const byte EncoderPair[VMAXENCODERS] = {3, 2, 1, 0, 7, 6, 5, 4, 8, 9};
 
 
   //
@@ -98,58 +137,148 @@ byte ReadDirectWiredEncoders(void)
 
 
 //
-// initialise - set up pins & construct data
-// these are constructed now because otherwise the configdata settings wouldn't be available yet.
-// read initial inputs first, to be able to pass the data to the constructor
+// sample the direct wired encoders into the buffer being filled
+// called by the timer interrupt. The timer count has been counting since the
+// timer match, so it gives the delay before sampling: the sampling jitter is the
+// difference between the least and most delay seen.
+// returns true when a tick's samples are complete: the buffers are swapped, and
+// the main loop can read the full one.
 //
-void InitEncoders(void)
+bool SampleDirectInputs(void)
 {
-  unsigned int EncoderValues;                   // encoder 1-8 values
-  byte Encoder9_12;
-  byte BitState;                                // 2 bits setting of one encoder                 
+  unsigned int Latency;
+  byte Count;
+
+  Latency = TCB0.CNT;
+  if (Latency < GSampleLatencyMin)
+    GSampleLatencyMin = Latency;
+  if (Latency > GSampleLatencyMax)
+    GSampleLatencyMax = Latency;
+  Count = GSampleCount;
+  GInputSamples[GSampleBuffer][Count++] = ReadDirectWiredEncoders();
+  if (Count < VINPUTSAMPLESPERTICK)
+  {
+    GSampleCount = Count;
+    return false;
+  }
+  GSampleCount = 0;
+  if (GSamplesReady)                                        // main loop hasn't read the last buffer
+    GSampleOverruns++;
+  GSampleBuffer ^= 1;
+  GSamplesReady = true;
+  return true;
+}
 
-  GVFOCycleCount = VVFOCYCLECOUNT;              // tick count
 
-  Encoder9_12 = ReadDirectWiredEncoders();      // read encoders that are direct wired
-  EncoderValues = ReadMCPRegister16(0, GPIOA);             // read 16 bit encoder values
-  
-  BitState = (byte)(EncoderValues & 0b11);      // take bottom 2 bits
-  EncoderValues = EncoderValues >> 2;            // ready for next encoder
-  EncoderList[3].Ptr = new NoClickEncoder2(GMechEncoderDivisor, BitState, true);
+//
+// get the tick's samples from the interrupt, if they are ready
+// returns the buffer, or NULL if not ready. It can be read until the next tick,
+// as the interrupt is then filling the other buffer
+//
+const volatile byte* GetDirectInputSamples(void)
+{
+  const volatile byte* Samples = NULL;
 
-  BitState = (byte)(EncoderValues & 0b11);      // take bottom 2 bits
-  EncoderValues = EncoderValues >> 2;            // ready for next encoder
-  EncoderList[2].Ptr = new NoClickEncoder2(GMechEncoderDivisor, BitState, true);
+  noInterrupts();
+  if (GSamplesReady)
+  {
+    GSamplesReady = false;
+    Samples = GInputSamples[GSampleBuffer ^ 1];
+  }
+  interrupts();
+  return Samples;
+}
 
-  BitState = (byte)(EncoderValues & 0b11);      // take bottom 2 bits
-  EncoderValues = EncoderValues >> 2;            // ready for next encoder
-  EncoderList[1].Ptr = new NoClickEncoder2(GMechEncoderDivisor, BitState, true);
 
-  BitState = (byte)(EncoderValues & 0b11);      // take bottom 2 bits
-  EncoderValues = EncoderValues >> 2;            // ready for next encoder
-  EncoderList[0].Ptr = new NoClickEncoder2(GEncoderDivisor, BitState, true);
+//
+// filter a direct wired encoder sample: an input only changes when two
+// samples in a row agree, so a glitch shorter than one sample period is ignored
+// returns the filtered inputs
+//
+byte FilterDirectInputs(byte Sample)
+{
+  byte Agreed;                                  // inputs the same as last sample
 
-  BitState = (byte)(EncoderValues & 0b11);      // take bottom 2 bits
-  EncoderValues = EncoderValues >> 2;            // ready for next encoder
-  EncoderList[7].Ptr = new NoClickEncoder2(GMechEncoderDivisor, BitState, true);
+  Agreed = ~(Sample ^ GDirectPrevious);
+  GDirectFiltered = (GDirectFiltered & ~Agreed) | (Sample & Agreed);
+  GDirectPrevious = Sample;
+  return GDirectFiltered;
+}
 
-  BitState = (byte)(EncoderValues & 0b11);      // take bottom 2 bits
-  EncoderValues = EncoderValues >> 2;            // ready for next encoder
-  EncoderList[6].Ptr = new NoClickEncoder2(GMechEncoderDivisor, BitState, true);
 
-  BitState = (byte)(EncoderValues & 0b11);      // take bottom 2 bits
-  EncoderValues = EncoderValues >> 2;            // ready for next encoder
-  EncoderList[5].Ptr = new NoClickEncoder2(GMechEncoderDivisor, BitState, true);
 
-  BitState = (byte)(EncoderValues & 0b11);      // take bottom 2 bits
-  EncoderList[4].Ptr = new NoClickEncoder2(GMechEncoderDivisor, BitState, true);
+//
+// queue this tick's read of the MCP23S17 encoder inputs
+// without MCPINTERRUPTS they are read every tick. Otherwise they are only read
+// if an interrupt is asserted, or every VMCPKEEPALIVETICKS in case one was
+// missed. One burst reads the interrupt flags, the ports' values at their
+// first change, and the current values.
+//
+void QueueEncoderReads(void)
+{
+#ifdef MCPINTERRUPTS
+  GMCPEncoderReadQueued = MCPInterruptAsserted();
+  if (--GMCPKeepAliveCount == 0)
+  {
+    GMCPKeepAliveCount = VMCPKEEPALIVETICKS;
+    GMCPEncoderReadQueued = true;
+  }
+  if (GMCPEncoderReadQueued)
+    QueueMCPRead(VMCPENCODERADDR, INTFA, GMCPEncoderData + VENCINTF, 6);
+#else
+  GMCPEncoderReadQueued = true;
+  QueueMCPRead(VMCPENCODERADDR, GPIOA, GMCPEncoderData + VENCGPIO, 2);
+#endif
+}
+
+
+//
+// get the MCP23S17 encoder inputs read this tick
+// the values of ports that interrupted, at their first change, are returned
+// in *Captured, so an encoder that moved twice since the last read is
+// decoded in order. Ports that didn't interrupt keep their last value.
+// returns the current inputs
+//
+unsigned int GetEncoderExpander(unsigned int* Captured)
+{
+  unsigned int Changed = 0;                     // bits of the ports that interrupted
+
+  *Captured = GMCPEncoderInputs;
+  if (!GMCPEncoderReadQueued)
+    return GMCPEncoderInputs;
+  WaitSPIBatch();
+  if (GMCPEncoderData[VENCINTF] != 0)
+    Changed |= 0x00FF;
+  if (GMCPEncoderData[VENCINTF + 1] != 0)
+    Changed |= 0xFF00;
+  *Captured = (GMCPEncoderInputs & ~Changed)
+              | ((GMCPEncoderData[VENCINTCAP] | ((unsigned int)GMCPEncoderData[VENCINTCAP + 1] << 8)) & Changed);
+  GMCPEncoderInputs = GMCPEncoderData[VENCGPIO] | ((unsigned int)GMCPEncoderData[VENCGPIO + 1] << 8);
+  return GMCPEncoderInputs;
+}
+
+
+
+//
+// initialise - set up pins & decoder state
+// read initial inputs first, so the decoder starts from the current encoder positions
+//
+void InitEncoders(void)
+{
+  unsigned int EncoderValues;                   // encoder 1-8 values
+  byte Encoder9_12;
+  unsigned int APlane, BPlane;                  // encoder phases, 1 bit per encoder
 
-  BitState = Encoder9_12 & 0b11;
-  EncoderList[8].Ptr = new NoClickEncoder2(GMechEncoderDivisor, BitState, true);
+  GVFOCycleCount = VVFOCYCLECOUNT;              // tick count
 
-  Encoder9_12 = Encoder9_12 >> 2;
-  BitState = Encoder9_12 & 0b11;
-  EncoderList[9].Ptr = new NoClickEncoder2(GMechEncoderDivisor, BitState, true);
+  Encoder9_12 = ReadDirectWiredEncoders();      // read encoders that are direct wired
+  GDirectPrevious = Encoder9_12;
+  GDirectFiltered = Encoder9_12;
+  EncoderValues = ReadMCPRegister16(0, GPIOA);             // read 16 bit encoder values
+  GMCPEncoderInputs = EncoderValues;
+  GMCPKeepAliveCount = VMCPKEEPALIVETICKS;
+  MakeEncoderPlanes(EncoderValues, Encoder9_12, &APlane, &BPlane);
+  InitSlicedEncoders(APlane, BPlane);
 
   InitOpticalEncoder();
 }
@@ -158,78 +287,198 @@ void InitEncoders(void)
 
 //
 // encoder 2ms tick
-// these are all now serviced at this rate, with a total time used of around 35 microseconds
+// all 10 mechanical encoders are decoded together by the bit sliced decoder;
+// only encoders that have moved need any further processing
+// the direct wired encoders' samples from the timer interrupt are decoded in
+// turn, so they can move more than one edge in a tick. If there are none
+// (the tick wasn't from the timer) they are read now
+// MCP23S17 inputs captured at an interrupt are decoded before the current ones
 // 
 void EncoderTick(void)
 {
   unsigned int EncoderValues;                   // 4 dual encoder pins
+  unsigned int CapturedValues;                  // 4 dual encoder pins at their first change
   byte Encoder9_12;                             // 1 dual encoder pins
-  byte EventData = 0;                           // o/p data
+  byte Filtered;                                // filtered sample
+  byte Sample;                                  // sample number
+  unsigned int APlane, BPlane;                  // encoder phases, 1 bit per encoder
+  unsigned int ActivePairs = 0;                 // encoders that moved this tick
+  const volatile byte* Samples;                 // this tick's direct wired encoder samples
   
-  EncoderValues = ReadMCPRegister16(0, GPIOA);             // read 16 bit encoder values
-  Encoder9_12 = ReadDirectWiredEncoders();      // read encoders that are direct wired
-
-  EncoderList[3].Ptr->service((byte)(EncoderValues & 0b11));
-  EncoderValues = EncoderValues >> 2;
-  
-  EncoderList[2].Ptr->service((byte)(EncoderValues & 0b11));
-  EncoderValues = EncoderValues >> 2;
-
-  EncoderList[1].Ptr->service((byte)(EncoderValues & 0b11));
-  EncoderValues = EncoderValues >> 2;
-
-  EncoderList[0].Ptr->service((byte)(EncoderValues & 0b11));
-  EncoderValues = EncoderValues >> 2;
-
-  EncoderList[7].Ptr->service((byte)(EncoderValues & 0b11));
-  EncoderValues = EncoderValues >> 2;
-
-  EncoderList[6].Ptr->service((byte)(EncoderValues & 0b11));
-  EncoderValues = EncoderValues >> 2;
-
-  EncoderList[5].Ptr->service((byte)(EncoderValues & 0b11));
-  EncoderValues = EncoderValues >> 2;
- 
-  EncoderList[4].Ptr->service((byte)(EncoderValues & 0b11));
-
-  EncoderList[8].Ptr->service(Encoder9_12 & 0b11);      // feed encoder 9 with bottom bits
-
-  Encoder9_12 = Encoder9_12 >> 2;
-  EncoderList[9].Ptr->service(Encoder9_12 & 0b11);      // feed encoder 10 with bits 2,3
+  EncoderValues = GetEncoderExpander(&CapturedValues);     // 16 bit encoder values read this tick
+  if (CapturedValues != GMCPEncoderInputs)
+  {
+    MakeEncoderPlanes(CapturedValues, GDirectFiltered, &APlane, &BPlane);
+    ActivePairs |= ServiceSlicedEncoders(APlane, BPlane);
+  }
+  Samples = GetDirectInputSamples();
+  if (Samples == NULL)
+    Encoder9_12 = FilterDirectInputs(ReadDirectWiredEncoders());
+  else
+  {
+    Encoder9_12 = GDirectFiltered;
+    for (Sample = 0; Sample < VINPUTSAMPLESPERTICK; Sample++)
+    {
+      Filtered = FilterDirectInputs(Samples[Sample]);
+      if (Filtered != Encoder9_12)                        // decode each change in turn
+      {
+        Encoder9_12 = Filtered;
+        MakeEncoderPlanes(EncoderValues, Encoder9_12, &APlane, &BPlane);
+        ActivePairs |= ServiceSlicedEncoders(APlane, BPlane);
+      }
+    }
+  }
+  MakeEncoderPlanes(EncoderValues, Encoder9_12, &APlane, &BPlane);
+  ActivePairs |= ServiceSlicedEncoders(APlane, BPlane);
 
   int16_t Movement;                                         // normal encoder movement since last update
   byte Cntr;                                                // count encoders
   byte ReportNumber;
+  unsigned long Now;                                        // timebase tick count
+  unsigned long Interval;                                   // ticks since encoder last reported
+  byte Multiplier;                                          // acceleration multiplier
   
-  for (Cntr=0; Cntr < VMAXENCODERS; Cntr++)
+  if (ActivePairs != 0)
   {
-    Movement = EncoderList[Cntr].Ptr->getValue();
-    if (Movement != 0) 
+    for (Cntr=0; Cntr < VMAXENCODERS; Cntr++)
     {
-      EncoderList[Cntr].LastPosition += Movement;
-      if(GEncoderShiftActive && (Cntr >= 8))
-        ReportNumber = Cntr+2;                              // if shifted, last encder reports as a higher number
-      else
-        ReportNumber = Cntr;
-      CATHandleEncoder(ReportNumber, Movement);
-
+      if ((ActivePairs & (1 << EncoderPair[Cntr])) == 0)
+        continue;
+      Movement = GetSlicedEncoderValue(EncoderPair[Cntr], GMechEncoderDivisor, GEncoderCountingMode);
+      if (Movement != 0) 
+      {
+//
+// acceleration: speed in notches per 100ms from the time since the last report,
+// from 1 tick (a second report in the same timebase tick) up to 255 ticks
+// an accelerated movement is reported in full: the TX queue splits it
+// into as many ZZZE messages as it needs
+//
+        Now = TimebaseTicks();
+        Interval = Now - GEncoderLastReport[Cntr];
+        GEncoderLastReport[Cntr] = Now;
+        if (Interval == 0)
+          Interval = 1;
+        else if (Interval > 255)
+          Interval = 255;
+        Multiplier = AccelerationMultiplier(eAccelMech, (abs(Movement) * 50) / Interval);
+        Movement *= Multiplier;
+        if(GEncoderShiftActive && (Cntr >= 8))
+          ReportNumber = Cntr+2;                              // if shifted, last encder reports as a higher number
+        else
+          ReportNumber = Cntr;
+        CATHandleEncoder(ReportNumber, Movement, TimebaseMicros());
+      }
     }
   }
 
+  VFOTick();
+}
+
+
+
 //
-//read the VFO encoder; divide by N to get the desired step count
+// VFO encoder tick
+// if the report policy is 0:
 // we only process it every 10 ticks (20ms) to allow several ticks to build up to minimise CAT command rate
 // at 4 turns per second, get 2000 steps/s ie ~40 steps per 20ms, which is enough
-// clip to 7 signed bits
+// otherwise the policy is the maximum report window in ticks, and the window adapts:
+// - turning slowly, a step is reported at the first tick after it happens
+// - as the edge rate rises, the window widens (1 tick per step/tick) up to the policy maximum
+// - the window is never less than the CAT link can carry, so messages can't back up
+// - a full message (99 steps) is sent straight away
+// in all cases any more than one message can hold are left in the accumulator for next time
+// each report carries the time its oldest step was seen, not the time it was sent
+// if acceleration is set, the steps read are multiplied up, and only as many steps
+// are read as will still fit in one message after multiplying
 //
-  if (--GVFOCycleCount == 0)
+void VFOTick(void)
+{
+  int16_t Count;                                // accumulated edges
+  int16_t Edges;                                // edges this tick
+  int Pending;                                  // whole steps waiting to be reported
+  int Reported;
+  byte Window;                                  // ticks to batch steps for
+  byte Multiplier;                              // acceleration multiplier
+
+  Count = PeekOpticalEncoder();
+  Edges = Count - GVFOLastCount;
+  if (Edges < 0)
+    Edges = -Edges;
+  if (Edges > 255)
+    Edges = 255;
+  GVFORate = GVFORate + (((Edges << 4) - (int)GVFORate) >> 3);   // 1/8 smoothing
+  if (GVFOTicksSinceReport != 255)
+    GVFOTicksSinceReport++;
+  Multiplier = AccelerationMultiplier(eAccelVFO, ((unsigned long)GVFORate * 50 / 16) / GVFOEncoderDivisor);
+  if (((GVFOLastCount / GVFOEncoderDivisor) == 0) && ((Count / GVFOEncoderDivisor) != 0))
+    GVFOStepMicros = TimebaseMicros();                            // first whole step since the last report
+
+  if (GVFOReportPolicy == 0)
   {
-    GVFOCycleCount = VVFOCYCLECOUNT;
+    if (--GVFOCycleCount == 0)
+    {
+      GVFOCycleCount = VVFOCYCLECOUNT;
+
+      Reported = ReadOpticalEncoder(VMAXVFOSTEPS / Multiplier);
+      if (Reported != 0)
+        CATHandleVFOEncoder(Reported * Multiplier, GVFOStepMicros);
+      Count -= Reported * GVFOEncoderDivisor;
+    }
+    GVFOLastCount = Count;
+    return;
+  }
 
-    signed char ct = ReadOpticalEncoder();
-    if (ct != 0)
-      CATHandleVFOEncoder(ct);
+  Window = (GVFORate >> 4) / GVFOEncoderDivisor;                  // steps per tick
+  if (Window > GVFOReportPolicy)
+    Window = GVFOReportPolicy;
+  if (Window < GVFOLinkWindow)
+    Window = GVFOLinkWindow;
+  if (Window == 0)
+    Window = 1;
+
+  Pending = Count / GVFOEncoderDivisor;
+  if ((Pending != 0) && ((GVFOTicksSinceReport >= Window) || (Pending >= VMAXVFOSTEPS) || (Pending <= -VMAXVFOSTEPS)))
+  {
+    Reported = ReadOpticalEncoder(VMAXVFOSTEPS / Multiplier);
+    CATHandleVFOEncoder(Reported * Multiplier, GVFOStepMicros);
+    GVFOTicksSinceReport = 0;
+    Count -= Reported * GVFOEncoderDivisor;
   }
+  GVFOLastCount = Count;
+}
+
+
+//
+// find the acceleration multiplier for an encoder class at a given speed
+// speed is in steps per 100ms. Above the class threshold, the multiplier rises by
+// gain/16 for each step per 100ms, up to VMAXACCELERATION. A gain of 0 means no acceleration
+//
+byte AccelerationMultiplier(EAccelClass Class, unsigned long Speed)
+{
+  unsigned long Multiplier = 1;
+  byte Threshold = GAccelThreshold[Class];
+  byte Gain = GAccelGain[Class];
+
+  if ((Gain != 0) && (Speed > Threshold))
+  {
+    Multiplier += ((Speed - Threshold) * Gain) >> 4;
+    if (Multiplier > VMAXACCELERATION)
+      Multiplier = VMAXACCELERATION;
+  }
+  return (byte)Multiplier;
+}
+
+
+//
+// set the CAT link baud rate, used to limit the VFO message rate
+// the VFO is allowed half of the link: window = 2 * message bits / bits per tick
+//
+void SetVFOLinkRate(unsigned long Baud)
+{
+  unsigned long BitsPerTick;
+
+  BitsPerTick = Baud / 500;                                      // 2ms tick
+  GVFOLinkWindow = (byte)((2UL * VVFOMSGBYTES * 10UL + BitsPerTick - 1) / BitsPerTick);
 }
 
 
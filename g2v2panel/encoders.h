@@ -17,17 +17,78 @@
 #define __ENCODERS_H
 #include <Arduino.h>
 #include "iopins.h"
+#include "timebase.h"
+
+//
+// encoder classes with separate acceleration curves
+//
+enum EAccelClass
+{
+  eAccelVFO,                              // VFO optical encoder
+  eAccelMech,                             // dual shaft mechanical encoders
+  eNumAccelClasses
+};
+
+
+//
+// the direct wired encoders are sampled by the timer interrupt
+// VINPUTSAMPLESPERTICK times each 2ms tick (1, 2, 4 or 8: 4 = every 0.5ms),
+// so their sampling doesn't depend on how long the main loop took.
+// the interrupt fills one buffer of samples while the main loop processes
+// the other; the main loop tick is triggered when a buffer is full.
+//
+#define VINPUTSAMPLESPERTICK 4
+
+//
+// sampling statistics
+//
+extern volatile unsigned int GSampleLatencyMin;          // least timer counts from timer match to sample
+extern volatile unsigned int GSampleLatencyMax;          // most timer counts from timer match to sample
+extern volatile unsigned int GSampleOverruns;            // sample buffers overwritten before the main loop read them
+
+
+//
+// sample the direct wired encoders: called by the timer interrupt
+// returns true when a tick's samples are complete, and the main loop tick is due
+//
+bool SampleDirectInputs(void);
+
 
 //
 // initialise - set up pins & construct data
 //
 void InitEncoders(void);
 
+//
+// queue the tick's MCP23S17 encoder input read (see SPIdata.h)
+// called before the batch is run and EncoderTick() is called
+//
+void QueueEncoderReads(void);
+
 //
 // encoder 2ms tick
 // 
 void EncoderTick(void);
 
+//
+// VFO encoder tick: decide whether to report the VFO encoder this tick
+// called by EncoderTick()
+//
+void VFOTick(void);
+
+
+//
+// find the acceleration multiplier for an encoder class at a given speed (steps per 100ms)
+//
+byte AccelerationMultiplier(EAccelClass Class, unsigned long Speed);
+
+
+//
+// set the CAT link baud rate, used to limit the VFO message rate
+//
+void SetVFOLinkRate(unsigned long Baud);
+
+
 //
 // set divisors
 // this sets whether events are generated every 1, 2 or 4 edge events
@@ -0,0 +1,144 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// encoderslice.cpp
+// bit sliced quadrature decoder for all of the mechanical encoders
+//
+// the decode is the same as Peter Dannegger's (see mechencoder2.cpp):
+// each encoder has a 2 bit state curr = (A ? 3 : 0) ^ (B ? 1 : 0)
+// and diff = last - curr. If diff is odd it has moved one step, and
+// bit 1 of diff gives the direction.
+// here bit 0 and bit 1 of every encoder's state are held in separate
+// words, so the subtraction is done for all encoders at once:
+//   diff bit 0 = last0 ^ curr0
+//   diff bit 1 = last1 ^ curr1 ^ borrow, where borrow = ~last0 & curr0
+/////////////////////////////////////////////////////////////////////////
+
+#include "encoderslice.h"
+
+
+//
+// decoder state: one bit per encoder pair
+//
+unsigned int GSliceLast0;                     // previous state bit 0 (A xor B)
+unsigned int GSliceLast1;                     // previous state bit 1 (A)
+int16_t GSliceDelta[VSLICEDENCODERS];         // accumulated steps per pair
+
+
+//
+// compress the even numbered bits of a 16 bit word into the bottom 8 bits
+//
+static inline unsigned int EvenBits(unsigned int Word)
+{
+  Word &= 0x5555;
+  Word = (Word | (Word >> 1)) & 0x3333;
+  Word = (Word | (Word >> 2)) & 0x0F0F;
+  Word = (Word | (Word >> 4)) & 0x00FF;
+  return Word;
+}
+
+
+//
+// convert raw encoder inputs to bit planes
+//
+void MakeEncoderPlanes(unsigned int MCPWord, byte DirectWired, unsigned int* APlane, unsigned int* BPlane)
+{
+  *APlane = EvenBits(MCPWord) | ((unsigned int)EvenBits(DirectWired) << 8);
+  *BPlane = EvenBits(MCPWord >> 1) | ((unsigned int)EvenBits(DirectWired >> 1) << 8);
+}
+
+
+//
+// initialise: set the "previous" state from the current input values
+//
+void InitSlicedEncoders(unsigned int APlane, unsigned int BPlane)
+{
+  byte Cntr;
+
+  GSliceLast1 = APlane;
+  GSliceLast0 = APlane ^ BPlane;
+  for (Cntr = 0; Cntr < VSLICEDENCODERS; Cntr++)
+    GSliceDelta[Cntr] = 0;
+}
+
+
+//
+// call every tick with the new input bit planes
+// with nothing moving this is just the XOR and test for zero
+// only pairs that stepped can have a new whole notch to report,
+// because any residue left behind by GetSlicedEncoderValue() is less than a notch
+//
+unsigned int ServiceSlicedEncoders(unsigned int APlane, unsigned int BPlane)
+{
+  unsigned int Curr0, Curr1;                  // new state bit planes
+  unsigned int Step;                          // pairs that have moved one step
+  unsigned int Up;                            // pairs that moved up (subset of Step)
+  unsigned int Moved;
+  byte Pair;
+
+  Curr1 = APlane;
+  Curr0 = APlane ^ BPlane;
+  Step = GSliceLast0 ^ Curr0;
+  Moved = Step;
+  if (Step != 0)
+  {
+    Up = Step & (GSliceLast1 ^ Curr1 ^ (~GSliceLast0 & Curr0));
+    GSliceLast1 = (GSliceLast1 & ~Step) | (Curr1 & Step);
+    GSliceLast0 = Curr0;
+    for (Pair = 0; Step != 0; Pair++)
+    {
+      if (Step & 1)                           // +1 if up, else -1
+        GSliceDelta[Pair] += (int16_t)((Up & 1) << 1) - 1;
+      Step >>= 1;
+      Up >>= 1;
+    }
+  }
+  return Moved;
+}
+
+
+//
+// get the movement of one encoder pair since last read
+// in counting mode, divide by the steps per notch and leave the remainder
+// (with its sign) for next time, so no edges are lost in either direction
+// otherwise as NoClickEncoder2::getValue(): report one step in the direction moved
+//
+int16_t GetSlicedEncoderValue(byte Pair, byte StepsPerNotch, bool CountAll)
+{
+  int16_t Value;
+  int16_t Result = 0;
+
+  Value = GSliceDelta[Pair];
+  if (CountAll)
+  {
+    if ((StepsPerNotch != 2) && (StepsPerNotch != 4))
+      StepsPerNotch = 1;
+    Result = Value / StepsPerNotch;
+    GSliceDelta[Pair] = Value - Result * StepsPerNotch;
+    return Result;
+  }
+
+  if (StepsPerNotch == 2)
+  {
+    GSliceDelta[Pair] = Value & 1;
+    Value >>= 1;
+  }
+  else if (StepsPerNotch == 4)
+  {
+    GSliceDelta[Pair] = Value & 3;
+    Value >>= 2;
+  }
+  else
+    GSliceDelta[Pair] = 0;
+
+  if (Value < 0)
+    Result = -1;
+  else if (Value > 0)
+    Result = 1;
+  return Result;
+}
@@ -0,0 +1,57 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// encoderslice.h
+// bit sliced quadrature decoder for all of the mechanical encoders
+// the A and B phases of every encoder are held as bit planes: one bit
+// per encoder in a 16 bit word. One pass of a few logic operations
+// finds which encoders have stepped, and in which direction.
+// this replaces one NoClickEncoder2 object per encoder.
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __ENCODERSLICE_H
+#define __ENCODERSLICE_H
+#include <Arduino.h>
+
+
+#define VSLICEDENCODERS 10                    // number of encoders handled
+
+
+//
+// convert raw encoder inputs to bit planes
+// MCPWord = 16 bit MCP23S17 read, with 2 bits per encoder (bit 0 = A, bit 1 = B)
+// DirectWired = 2 bits each for the two direct wired encoders, same format
+// plane bit N = encoder pair N: pairs 0-7 from MCPWord (bottom first), then 8, 9 from DirectWired
+//
+void MakeEncoderPlanes(unsigned int MCPWord, byte DirectWired, unsigned int* APlane, unsigned int* BPlane);
+
+
+//
+// initialise: set the "previous" state from the current input values
+//
+void InitSlicedEncoders(unsigned int APlane, unsigned int BPlane);
+
+
+//
+// call every tick with the new input bit planes
+// returns a bitmap of the encoder pairs that moved this tick: only these
+// need GetSlicedEncoderValue() called
+//
+unsigned int ServiceSlicedEncoders(unsigned int APlane, unsigned int BPlane);
+
+
+//
+// get the movement of one encoder pair since last read
+// StepsPerNotch = 1, 2 or 4: the residue below one notch is left for next time
+// if CountAll is false, the result is clipped to -1, 0 or +1 (as the original NoClickEncoder2)
+// if true, the full number of notches moved is returned
+//
+int16_t GetSlicedEncoderValue(byte Pair, byte StepsPerNotch, bool CountAll);
+
+
+#endif // not defined
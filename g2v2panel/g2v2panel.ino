@@ -19,32 +19,9 @@
 #include "SPIdata.h"
 #include "button.h"
 #include "led.h"
-
-
-//
-// global variables
-//
-bool GTickTriggered;                  // true if a 2ms tick has been triggered
-
-
-//
-// counter clocked by CK/8 (0.5us)
-// note this is faster than I've used in other sketches because timer 8 set to run 8x faster
-void SetupTimerForInterrupt(int Milliseconds)
-{
-  int Count;
-
-  Count = Milliseconds * 2000;
-  TCB0.CTRLB = TCB_CNTMODE_INT_gc; // Use timer compare mode  
-  TCB0.CCMP = Count; // Value to compare with. This is 1/5th of the tick rate, so 5 Hz
-  TCB0.INTCTRL = TCB_CAPT_bm; // Enable the interrupt
-  TCB0.CTRLA = TCB_CLKSEL_CLKTCA_gc | TCB_ENABLE_bm; // Use Timer A as clock, enable timer
-
-  // setup timer A for 8x faster than normal clock, so we get 8KHz PRF
-  // this will cause ny use of delay() millis() etc to be wrong
-  TCA0.SINGLE.CTRLA = (TCA_SINGLE_CLKSEL_DIV8_gc) | (TCA_SINGLE_ENABLE_bm);
-}
-
+#include "txqueue.h"
+#include "scheduler.h"
+#include "timebase.h"
 
 
 //
@@ -52,13 +29,14 @@ void SetupTimerForInterrupt(int Milliseconds)
 //
 void setup() 
 {
-  CATSERIAL.begin(9600);                 // PC communication
+  CATSERIAL.begin(VCATBAUD);             // PC communication
 
   delay(1000);
 //
 // configure I/O pins
 //
   ConfigIOPins();
+  InitLEDs();
   InitSPI();
   GButtonInitialise();
 //
@@ -69,11 +47,13 @@ void setup()
 //
 // initialise timer to give 2ms tick interrupt
 //
-  SetupTimerForInterrupt(2);
+  InitTasks();
+  InitTimebase();
 //
 // encoder
 //
   InitEncoders();
+  SetVFOLinkRate(VCATBAUD);
   //
 // CAT
 //
@@ -82,60 +62,31 @@ void setup()
 
 
 //
-// 2ms tick handler.
+// timer interrupt handler: samples inputs, and triggers the 2ms tick
+// when a tick's samples are complete; then outputs the LED bit planes
 //
 ISR(TCB0_INT_vect)
 {
 //  digitalWrite(12, HIGH);                 // debug to measure tick period
-  GTickTriggered = true;
-   // Clear interrupt flag
-  TCB0.INTFLAGS = TCB_CAPT_bm;
+  TimebaseInterrupt(SampleDirectInputs());  // also clears the interrupt flag
+  LEDBAMInterrupt();                        // LED brightness
 //  digitalWrite(12, LOW);                  // debug to measure tick period
 }
 
 
-// for heartbeat LED:
-bool ledOn = false;
-byte Counter = 0;                           // tick counter for LED on period or off period
-
-
 //
 // 2 ms event loop
-// this is triggered by GTickTriggered being set by a timer interrupt
-// the loop simply waits until released by the timer handler
+// this is triggered by the timebase tick count being advanced by a timer interrupt
+// the loop simply waits until released by the timer handler,
+// then runs the tasks due this tick (see TASKLIST in scheduler.h)
+// a tick missed because a pass took too long is counted, not run (see TickDue())
 //
 void loop()
 {
-  while (GTickTriggered)
+  while (TickDue())
   {
-    GTickTriggered = false;
-// heartbeat LED
-    if (Counter == 0)
-    {
-      Counter=249;
-      ledOn = !ledOn;
-      if (ledOn)
-        digitalWrite(VPINBLINKLED, HIGH); // Led on, off, on, off...
-       else
-        digitalWrite(VPINBLINKLED, LOW);
-    }
-    else
-      Counter--;
-
-//
-// 2ms tick code here:
-//
-    EncoderTick();                                // update encoder inputs
-    ButtonTick();                                 // update the pushbutton sequencer
-  //
-// look for any CAT commands in the serial input buffer and process them
-//    
-    ScanParseSerial();
-    LEDTick();                                    // selftest of LEDs at startup
-// 
-// last action - drive the new switch matrix column output
-//
-    AssertMatrixColumn();
+    RunTasks();
+    SPITickEnd();                                 // SPI time statistics
   }
 }
 
@@ -158,7 +109,11 @@ void ConfigIOPins(void)
   
   pinMode(VPINMCPCS0, OUTPUT);                          // chip select output
   pinMode(VPINMCPCS1, OUTPUT);                          // chip select output
+#ifdef MCPINTERRUPTS
+  pinMode(VPINMCPINT, INPUT_PULLUP);                    // MCP23S17 open drain interrupt outputs
+#else
   pinMode(VPINBLINKLED, OUTPUT);
+#endif
   
   pinMode(VPINENCODER9A, INPUT_PULLUP);                 // normal encoder
   pinMode(VPINENCODER9B, INPUT_PULLUP);                 // normal encoder
@@ -175,7 +130,9 @@ void ConfigIOPins(void)
   
   digitalWrite(VPINMCPCS0, HIGH);                       // chip select output
   digitalWrite(VPINMCPCS1, HIGH);                       // chip select output
+#ifndef MCPINTERRUPTS
   digitalWrite(VPINBLINKLED, LOW);                      // debug LED output
+#endif
 
 //
 // finally setup interrupt output: active low output
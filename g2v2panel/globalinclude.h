@@ -37,9 +37,46 @@
 #define VMAXENCODERS 10             // configurable, not including VFO
 #define VMAXBUTTONS 34
 
+//
+// MCP23S17 interrupt on change scanning: the expanders are only read when their
+// inputs change, so there is almost no SPI activity on an idle panel.
+// needs both MCP23S17 INT outputs wired to VPINMCPINT (the blink LED pin,
+// which is then not used). They are not wired on the G2V2 PCB, so this is
+// off by default: define it only on a board with that modification.
+// without it, the expanders are read every tick
+// the MCP23S17 LEDs (1-4) can't be dimmed while the matrix is idle without an
+// SPI write every tick, so then they are lit at full brightness (see led.cpp)
+//
+//#define MCPINTERRUPTS
+
+//
+// interrupt driven SPI: each byte of a batch of MCP23S17 transactions is sent
+// by the SPI0 interrupt, rather than the main loop waiting for the batch.
+// at 8MHz a byte takes 16 CPU cycles, less than the interrupt entry and exit,
+// so this only saves CPU time at a slower SPI clock
+//
+//#define SPIINTERRUPTS
+
+//
+// tick catch up: if a pass of the main loop takes longer than a tick, the ticks
+// it missed are always counted (ZZZG); with this defined the task countdowns are
+// also moved on by them, so tasks that don't run every tick stay in step with the
+// tick count. (long press and LED timing come from the timebase, so keep time anyway)
+// Comment out to leave the task phases shifted by missed ticks
+//
+#define TICKCATCHUP
+
+//
+// task profiling: each task's run time (min, mean, max and a coarse histogram)
+// is kept in RAM and can be read with ZZZW, to check the tick headroom in the field.
+// Comment out to remove the profiling code, its RAM and the ZZZW command
+//
+#define TASKPROFILE
+
 //
 // define the serial port used for CAT
 //
 #define CATSERIAL Serial1                            // allows easy change to SerialUSB
+#define VCATBAUD 9600                                // CAT serial baud rate
 
 #endif      // file sentry
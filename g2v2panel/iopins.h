@@ -32,11 +32,30 @@
 #define VPININDICATOR10 A0
 #define VPININDICATOR11 A1
 
+// the same pins as VPORT and bit, for the LED code to write directly
+#define VINDICATOR5PORT VPORTF    // D6 = PF4 on the Nano Every
+#define VINDICATOR5BIT 0b00010000
+#define VINDICATOR6PORT VPORTA    // D7 = PA1
+#define VINDICATOR6BIT 0b00000010
+#define VINDICATOR7PORT VPORTE    // D8 = PE3
+#define VINDICATOR7BIT 0b00001000
+#define VINDICATOR8PORT VPORTB    // D9 = PB0
+#define VINDICATOR8BIT 0b00000001
+#define VINDICATOR9PORT VPORTB    // D10 = PB1
+#define VINDICATOR9BIT 0b00000010
+#define VINDICATOR10PORT VPORTD   // A0 = PD3
+#define VINDICATOR10BIT 0b00001000
+#define VINDICATOR11PORT VPORTD   // A1 = PD2
+#define VINDICATOR11BIT 0b00000100
+
 
 #define VPINPIINTERRUPT A7      // active high interrupt out to Raspberry pi
 #define VPINMCPCS0 A2           // chip select for MCP23S17 0
 #define VPINMCPCS1 A3           // chip select for MCP23S17 0
+#define VMCPCS0BIT 0b00000010   // VPINMCPCS0 as a VPORTD bit (A2 = PD1 on the Nano Every)
+#define VMCPCS1BIT 0b00000001   // VPINMCPCS1 as a VPORTD bit (A3 = PD0)
 
 #define VPINBLINKLED A6
+#define VPINMCPINT A6             // MCP23S17 INT outputs (open drain, wired together) if MCPINTERRUPTS; replaces blink LED
 
 #endif //not defined
@@ -12,11 +12,15 @@
 #include "globalinclude.h"
 #include "led.h"
 #include "iopins.h"
+#include "configdata.h"
+#include "timebase.h"
+#include "encoders.h"
+#include "button.h"
 
 byte I2CLEDBits;                  // 3 bits data for LEDs, in bits 2:0 (init to zero by button.cpp)
 bool LEDTestComplete;             // true if tests complete
 byte TestLED;                     // LED number to test
-byte LEDLitTime;                  // time count (in ticks) each LED lit for
+byte LEDLitTime;                  // ticks left of each LED's turn in the test
 unsigned int GLEDTestWord;        // LED bits during test
 unsigned int GLEDExtWord;         // LED bits from external messages
 
@@ -25,32 +29,89 @@ unsigned int GLEDExtWord;         // LED bits from external messages
 
 //
 // struct to hold an LED definition
-// holds a pin number, or indicates which I2C bit
+// GPIO LEDs are written directly to their VPORT output register;
+// MCP23S17 LEDs are bits in I2CLEDBits, written out by AssertMatrixColumn()
 //
 struct LEDType
 {
-  byte PinNumber;                 // I/O pin number or bit number
-  bool IsI2C;                     // true if I2C connected
+  VPORT_t* Port;                  // GPIO port, or NULL if MCP connected
+  byte BitMask;                   // bit in the port, or in I2CLEDBits
 };
 
 //
-// array of I/O pins
+// array of LED port bits, in LED number order
 //
-LEDType LEDPinList[] = 
+const LEDType LEDPinList[] = 
 {
-  {7, true},
-  {6, true},
-  {5, true},
-  {4, true},
-  {VPININDICATOR5, false},
-  {VPININDICATOR6, false},
-  {VPININDICATOR7, false},
-  {VPININDICATOR8, false},
-  {VPININDICATOR9, false},
-  {VPININDICATOR10, false},
-  {VPININDICATOR11, false}
+  {NULL, 0b10000000},
+  {NULL, 0b01000000},
+  {NULL, 0b00100000},
+  {NULL, 0b00010000},
+  {&VINDICATOR5PORT, VINDICATOR5BIT},
+  {&VINDICATOR6PORT, VINDICATOR6BIT},
+  {&VINDICATOR7PORT, VINDICATOR7BIT},
+  {&VINDICATOR8PORT, VINDICATOR8BIT},
+  {&VINDICATOR9PORT, VINDICATOR9BIT},
+  {&VINDICATOR10PORT, VINDICATOR10BIT},
+  {&VINDICATOR11PORT, VINDICATOR11BIT}
 };
 
+unsigned int GLEDAppliedWord;     // LED bits the bit planes were last made from
+bool GLEDLevelsChanged;           // brightness changed: bit planes need remaking
+
+//
+// bit angle modulation (BAM) of LED brightness
+// GPIO LEDs: plane N is output for 2^N timer interrupts, from the timer interrupt,
+// so a full cycle is 7 interrupts: with VINPUTSAMPLESPERTICK 4 (500us each), 3.5ms.
+// A slower timer interrupt would make the cycle long enough to flicker. Each plane is
+// written to each LED port in one write, so the cost doesn't depend on the levels.
+// if every GPIO LED is off or at full brightness, the planes are all the same:
+// they are written once, and then the ports are left alone.
+// MCP LEDs are written over SPI by AssertMatrixColumn() once per tick, so they
+// use 2 planes at the tick rate: plane N for 2^N ticks, a 3 tick (6ms) cycle.
+// with MCPINTERRUPTS the idle matrix is only written when I2CLEDBits changes, so
+// while it is idle lit MCP LEDs are shown at full brightness instead.
+//
+#define VBAMPLANES 3                                // GPIO LED planes: brightness levels 0-7
+#define VBAMCYCLE 7                                 // interrupts in one GPIO LED cycle
+#define VMCPBAMCYCLE 3                              // ticks in one MCP LED cycle
+#define VMAXLEDPORTS 5                              // VPORTs with LEDs on
+#define VMAXBAMCYCLEMICROS 4000                     // longest GPIO LED cycle without visible flicker (250Hz)
+
+static_assert(VBAMCYCLE * (VTICKMICROS / VINPUTSAMPLESPERTICK) <= VMAXBAMCYCLEMICROS,
+              "the timer interrupt is too slow for the GPIO LED bit planes: VINPUTSAMPLESPERTICK");
+
+byte GLEDLevels[VMAXINDICATORS];                    // brightness level for each LED, 0-7
+VPORT_t* GLEDPorts[VMAXLEDPORTS];                   // ports with GPIO LEDs
+byte GLEDPortMasks[VMAXLEDPORTS];                   // LED bits in each port
+byte GLEDNumPorts;
+volatile byte GBAMPlanes[VBAMPLANES][VMAXLEDPORTS]; // lit LED bits in each port for each plane
+volatile bool GBAMSteady;                           // every plane is the same
+volatile bool GBAMWritten;                          // the planes have been written since they were made
+byte GBAMCount;                                     // timer interrupts into the GPIO LED cycle
+byte GMCPBAMPlanes[2];                              // lit MCP LED bits for each plane
+byte GMCPBAMCount;                                  // ticks into the MCP LED cycle
+
+//
+// plane to output at each timer interrupt of the cycle (0xFF = no change)
+//
+const byte GBAMPlaneStarts[VBAMCYCLE] = {0, 1, 0xFF, 2, 0xFF, 0xFF, 0xFF};
+
+//
+// LED patterns
+// there is a phase counter for each period, advanced by the timebase ticks since
+// the last LEDTick(), so LEDs with the same period flash together whenever they
+// were switched on or set, and keep time even if LEDTick() runs late
+//
+#define VPATTERNTICKSPERSTEP 100                    // pattern period steps: 200ms, in ticks
+
+byte GLEDPatterns[VMAXINDICATORS];                  // ELEDPattern for each LED
+byte GLEDPatternPeriods[VMAXINDICATORS];            // pattern period for each LED (x 200ms)
+unsigned int GLEDPatternWord;                       // 1 bit per LED with a pattern other than steady
+unsigned int GLEDPulseTicks[VMAXINDICATORS];        // ticks left of a pulse LED's pulse
+unsigned int GPatternPhase[VMAXLEDPATTERNPERIOD];   // ticks into the current period, for periods 1-9
+unsigned int GLEDLastTick;                          // timebase tick count (low 16 bits) at the last LEDTick()
+
 
 
 
@@ -65,68 +126,261 @@ void SetLED(byte LEDNumber, bool State)
 
   BitPosition = 1 << LEDNumber;
   if(State)
+  {
+    if (((GLEDExtWord & BitPosition) == 0) && (LEDNumber < VMAXINDICATORS)
+                                           && (GLEDPatterns[LEDNumber] == eLEDPulse))
+      GLEDPulseTicks[LEDNumber] = GLEDPatternPeriods[LEDNumber] * VPATTERNTICKSPERSTEP;
     GLEDExtWord |= BitPosition;
+  }
   else
     GLEDExtWord &= ~BitPosition;              // clear the required bit
 }
 
+
 //
+// set the pattern an LED is shown with when it is on
 // note LEDs numbered 0-(N-1) here!
-// write an individual LED off or on
-void WriteLED(byte LEDNumber, bool State)
+// a pulse starts when the LED is next switched on
+//
+void SetLEDPattern(byte LEDNumber, byte Pattern, byte Period)
+{
+  unsigned int BitPosition;
+
+  if ((LEDNumber < VMAXINDICATORS) && (Pattern < eNumLEDPatterns))
+  {
+    BitPosition = 1 << LEDNumber;
+    if ((Period == 0) && (Pattern != eLEDSteady))
+      Period = 1;
+    GLEDPatterns[LEDNumber] = Pattern;
+    GLEDPatternPeriods[LEDNumber] = Period;
+    GLEDPulseTicks[LEDNumber] = 0;
+    if (Pattern == eLEDSteady)
+      GLEDPatternWord &= ~BitPosition;
+    else
+      GLEDPatternWord |= BitPosition;
+  }
+}
+
+
+//
+// advance the pattern phase counters by the ticks elapsed
+// they start with the timebase, so each is the tick count modulo its period
+//
+void AdvanceLEDPatternPhases(unsigned int Elapsed)
 {
-  byte IOPin;
-  byte BitPosition;
-  
-  if (LEDNumber < VMAXINDICATORS)
+  byte Cntr;
+  unsigned int PeriodTicks, Phase;
+
+  PeriodTicks = 0;
+  for (Cntr = 0; Cntr < VMAXLEDPATTERNPERIOD; Cntr++)
+  {
+    PeriodTicks += VPATTERNTICKSPERSTEP;
+    Phase = GPatternPhase[Cntr] + Elapsed;
+    if (Phase >= PeriodTicks)
+      Phase %= PeriodTicks;
+    GPatternPhase[Cntr] = Phase;
+  }
+}
+
+
+//
+// apply each LED's pattern to the LEDs that are on; pulses are moved on by the
+// ticks elapsed. Returns the LEDs to light this tick
+//
+unsigned int ApplyLEDPatterns(unsigned int LEDWord, unsigned int Elapsed)
+{
+  byte Cntr;
+  unsigned int PeriodTicks, Phase, Active;
+  bool Lit = true;
+
+  Active = LEDWord & GLEDPatternWord;
+  for (Cntr = 0; Active != 0; Cntr++)
   {
-    if(LEDPinList[LEDNumber].IsI2C== false)                 // if it is a GPIO pin
+    if (Active & 1)
     {
-      IOPin = LEDPinList[LEDNumber].PinNumber;
-      if (State == true)
-        digitalWrite(IOPin, HIGH);
-      else
-        digitalWrite(IOPin, LOW);
+      PeriodTicks = GLEDPatternPeriods[Cntr] * VPATTERNTICKSPERSTEP;
+      Phase = GPatternPhase[GLEDPatternPeriods[Cntr] - 1];
+      switch (GLEDPatterns[Cntr])
+      {
+        case eLEDBlink:
+          Lit = (Phase * 2 < PeriodTicks);
+          break;
+
+        case eLEDDoubleFlash:                                 // lit for eighths 0 and 2
+          Phase = Phase * 8;
+          Lit = (Phase < PeriodTicks) || ((Phase >= 2 * PeriodTicks) && (Phase < 3 * PeriodTicks));
+          break;
+
+        case eLEDPulse:
+          GLEDPulseTicks[Cntr] -= (GLEDPulseTicks[Cntr] > Elapsed) ? Elapsed : GLEDPulseTicks[Cntr];
+          Lit = (GLEDPulseTicks[Cntr] != 0);
+          if (!Lit)
+            GLEDExtWord &= ~(1 << Cntr);                      // pulse over: switch the LED off
+          break;
+      }
+      if (!Lit)
+        LEDWord &= ~(1 << Cntr);
     }
-    else                                                    // if it is connected to I2C
-    {
-      BitPosition = 1 << LEDPinList[LEDNumber].PinNumber;
-      if (State == true)
-        I2CLEDBits |= BitPosition;                          // set LED bit
-      else
-        I2CLEDBits &= ~BitPosition;                         // cancel LED bit
+    Active = Active >> 1;
+  }
+  return LEDWord;
+}
+
+//
+// find the ports that GPIO LEDs are on, for the timer interrupt to write
+// called once at start up
+//
+void InitLEDs(void)
+{
+  byte Cntr, Port;
+  VPORT_t* LEDPort;
 
-      I2CLEDBits &= VLEDBITMASK;                            // double check no others set
+  GLEDLastTick = 0;                                 // the timebase starts from 0
+  for (Cntr = 0; Cntr < VMAXLEDPATTERNPERIOD; Cntr++)
+    GPatternPhase[Cntr] = 0;
+  GLEDNumPorts = 0;
+  for (Cntr = 0; Cntr < VMAXINDICATORS; Cntr++)
+  {
+    LEDPort = LEDPinList[Cntr].Port;
+    if (LEDPort != NULL)
+    {
+      for (Port = 0; Port < GLEDNumPorts; Port++)
+        if (GLEDPorts[Port] == LEDPort)
+          break;
+      if (Port == GLEDNumPorts)                             // a new port
+      {
+        GLEDPorts[Port] = LEDPort;
+        GLEDPortMasks[Port] = 0;
+        GLEDNumPorts++;
+      }
+      GLEDPortMasks[Port] |= LEDPinList[Cntr].BitMask;
     }
   }
 }
 
 
 //
-// clear all LEDs
+// set the brightness of each LED from the stored settings
+// the panel brightness scales every LED's level, rounding up, so an LED with a non-zero
+// brightness stays at least level 1; a panel brightness of 0 turns every LED off
 //
-void ClearLEDs(void)
+void SetLEDBrightness(void)
 {
   byte Cntr;
 
   for (Cntr = 0; Cntr < VMAXINDICATORS; Cntr++)
-    WriteLED(Cntr, false);
+    GLEDLevels[Cntr] = (GLEDBrightness[Cntr] * GPanelBrightness + VMAXLEDLEVEL - 1) / VMAXLEDLEVEL;
+  GLEDLevelsChanged = true;
+}
+
+
+//
+// make the bit planes for a set of lit LEDs
+// the GPIO planes are copied with interrupts off, so the timer interrupt never sees half of them
+//
+void MakeBAMPlanes(unsigned int LEDWord)
+{
+  byte Planes[VBAMPLANES][VMAXLEDPORTS];
+  byte Cntr, Plane, Port, Level;
+  VPORT_t* LEDPort;
+  bool Steady;
+
+  memset(Planes, 0, sizeof(Planes));
+  GMCPBAMPlanes[0] = 0;
+  GMCPBAMPlanes[1] = 0;
+  for (Cntr = 0; Cntr < VMAXINDICATORS; Cntr++)
+  {
+    if (LEDWord & (1 << Cntr))
+    {
+      Level = GLEDLevels[Cntr];
+      LEDPort = LEDPinList[Cntr].Port;
+      if (LEDPort != NULL)                                  // GPIO: each plane with its level bit set
+      {
+        for (Port = 0; GLEDPorts[Port] != LEDPort; Port++)
+          ;
+        for (Plane = 0; Plane < VBAMPLANES; Plane++)
+          if (Level & (1 << Plane))
+            Planes[Plane][Port] |= LEDPinList[Cntr].BitMask;
+      }
+      else                                                  // MCP: level 0-7 becomes 0-3
+      {
+        Level = (Level * 3 + VMAXLEDLEVEL - 1) / VMAXLEDLEVEL;
+        if (Level & 1)
+          GMCPBAMPlanes[0] |= LEDPinList[Cntr].BitMask;
+        if (Level & 2)
+          GMCPBAMPlanes[1] |= LEDPinList[Cntr].BitMask;
+      }
+    }
+  }
+  Steady = true;
+  for (Plane = 1; Plane < VBAMPLANES; Plane++)
+    if (memcmp(Planes[0], Planes[Plane], VMAXLEDPORTS) != 0)
+      Steady = false;
+  noInterrupts();
+  memcpy((byte*)GBAMPlanes, Planes, sizeof(Planes));
+  GBAMSteady = Steady;
+  GBAMWritten = false;
+  interrupts();
+}
+
+
+//
+// timer interrupt: output the next GPIO LED bit plane when one starts
+// each port is read and written once; other bits in the port are unchanged.
+// steady planes (all the same) are only written once.
+// the SPI chip selects share VPORTD, but they are set with single bit
+// instructions so the main loop can't overwrite a change made here
+//
+void LEDBAMInterrupt(void)
+{
+  byte Plane, Port;
+  VPORT_t* LEDPort;
+
+  Plane = GBAMPlaneStarts[GBAMCount];
+  if (++GBAMCount == VBAMCYCLE)
+    GBAMCount = 0;
+  if ((Plane != 0xFF) && !(GBAMSteady && GBAMWritten))
+  {
+    for (Port = 0; Port < GLEDNumPorts; Port++)
+    {
+      LEDPort = GLEDPorts[Port];
+      LEDPort->OUT = (LEDPort->OUT & ~GLEDPortMasks[Port]) | GBAMPlanes[Plane][Port];
+    }
+    GBAMWritten = true;
+  }
+}
+
+
+//
+// clear all LEDs
+//
+void ClearLEDs(void)
+{
+  MakeBAMPlanes(0);
+  GLEDAppliedWord = 0;
 }
 
 
 byte LEDTestOrder[] = {0, 1, 2, 4, 3, 8, 7, 6, 5, 9, 10};
 bool GLEDsExtinguishing;
-#define VTESTTIMEPERLED 50       // 100ms
+#define VTESTTIMEPERLED 50                          // 100ms, in ticks
 
 //
 // LEDTick
-// called after power up to test all LEDs; 
+// called every VLEDTASKPERIOD ticks (10ms); timed from the timebase
+// after power up tests all LEDs; 
 // cycled through and lights each in turn until finished.
 // then write to LEDs as needed
 //
 void LEDTick(void)
 {
   unsigned int Mask;
+  unsigned int Now, Elapsed;                // timebase ticks, and ticks since the last call
+
+  Now = (unsigned int)TimebaseTicks();
+  Elapsed = Now - GLEDLastTick;
+  GLEDLastTick = Now;
+  AdvanceLEDPatternPhases(Elapsed);
   if(!LEDTestComplete)
   {
     if(LEDLitTime == 0)                 // if timed out - move on to next LED
@@ -153,23 +407,51 @@ void LEDTick(void)
         TestLED++;                      // and light new one
       }
     }
+    else if (LEDLitTime > Elapsed)
+      LEDLitTime -= Elapsed;
     else
-      LEDLitTime--;
+      LEDLitTime = 0;
   }
 //
-// now write all LEDs
+// now remake the bit planes if any LED or brightness has changed since last time
+// usually nothing has, and nothing is written
 //
-  byte Cntr;
   unsigned int LEDWord;
 
   if(LEDTestComplete)                                       // get the word to shift
-    LEDWord = GLEDExtWord;
+    LEDWord = ApplyLEDPatterns(GLEDExtWord, Elapsed);
   else
     LEDWord = GLEDTestWord;
 
-  for(Cntr=0; Cntr < VMAXINDICATORS; Cntr++)
+  if ((LEDWord != GLEDAppliedWord) || GLEDLevelsChanged)
   {
-    WriteLED(Cntr, (bool)(LEDWord & 1));
-    LEDWord = LEDWord >> 1;
+    GLEDAppliedWord = LEDWord;
+    GLEDLevelsChanged = false;
+    MakeBAMPlanes(LEDWord);
   }
 }
+
+
+//
+// LEDMCPTick
+// called every tick: the MCP LED bits for this tick's plane go out with the matrix column
+// when all the lit ones are at full brightness both planes are the same, so
+// I2CLEDBits doesn't change. With MCPINTERRUPTS, while the matrix is idle every lit
+// LED is shown at full brightness, so it doesn't change then either
+//
+void LEDMCPTick(void)
+{
+  byte Bits;
+
+  if (GMCPBAMPlanes[0] == GMCPBAMPlanes[1])
+    Bits = GMCPBAMPlanes[0];
+#ifdef MCPINTERRUPTS
+  else if (GMatrixIdle)
+    Bits = GMCPBAMPlanes[0] | GMCPBAMPlanes[1];
+#endif
+  else
+    Bits = (GMCPBAMCount == 0) ? GMCPBAMPlanes[0] : GMCPBAMPlanes[1];
+  I2CLEDBits = Bits & VLEDBITMASK;
+  if (++GMCPBAMCount == VMCPBAMCYCLE)
+    GMCPBAMCount = 0;
+}
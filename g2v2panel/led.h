@@ -14,10 +14,48 @@
 
 #define VLEDBANDSHIFT 9                   // (external number = 10)
 #define VLEDENCODERSHIFT 10                // (external number = 11)
+#define VMAXLEDLEVEL 7                     // LED brightness levels 0 (off) to 7 (full)
+
+//
+// LED patterns (ZZZN): how an LED that is switched on is shown
+// each has a period set in 200ms steps; all LEDs with the same period are in step
+//
+enum ELEDPattern
+{
+  eLEDSteady,                             // lit all the time
+  eLEDBlink,                              // lit for the first half of each period
+  eLEDDoubleFlash,                        // two 1/8 period flashes at the start of each period
+  eLEDPulse,                              // lit for one period when switched on, then switches itself off
+  eNumLEDPatterns
+};
+#define VMAXLEDPATTERNPERIOD 9            // longest pattern period (x 200ms)
 
 // declare extern variables
 extern byte I2CLEDBits;                  // 3 bits data for LEDs, in bits 2:0
 extern bool LEDTestComplete;             // true if tests complete
+extern byte GLEDPatterns[];              // ELEDPattern for each LED
+extern byte GLEDPatternPeriods[];        // pattern period for each LED (x 200ms)
+
+
+//
+// find the ports the GPIO LEDs are on
+// called once at start up
+//
+void InitLEDs(void);
+
+
+//
+// set the brightness of each LED from the stored settings (GLEDBrightness, GPanelBrightness)
+// called after the settings are loaded or changed
+//
+void SetLEDBrightness(void);
+
+
+//
+// called from the timer interrupt, every 500us
+// outputs the LED brightness bit planes
+//
+void LEDBAMInterrupt(void);
 
 
 //
@@ -27,6 +65,13 @@ extern bool LEDTestComplete;             // true if tests complete
 void SetLED(byte LEDNumber, bool State);
 
 
+//
+// set the pattern an LED is shown with when it is on
+// LED number 0 to (N-1); period 1-9 (x 200ms)
+//
+void SetLEDPattern(byte LEDNumber, byte Pattern, byte Period);
+
+
 //
 // clear all LEDs
 //
@@ -35,11 +80,19 @@ void ClearLEDs(void);
 
 //
 // LEDTick
-// called after power up to test all LEDs; 
+// called every VLEDTASKPERIOD ticks (10ms); timed from the timebase
+// after power up tests all LEDs; 
 // cycled through and lights each in turn until finished.
 // then write to LEDs as needed
 //
 void LEDTick(void);
 
 
+//
+// LEDMCPTick
+// called every tick to output the MCP LED brightness bit planes
+//
+void LEDMCPTick(void);
+
+
 #endif //#ifndef
@@ -22,7 +22,8 @@
 
 // global variables
 
-signed char GDeltaCount;                    // count stored since last retrieved
+volatile int16_t GDeltaCount;               // count stored since last retrieved
+volatile unsigned int GVFOOverflowCount;    // edges lost because GDeltaCount was full
 byte GPinState;
 byte GDivisor;                              // number of edge events per declared click
 
@@ -30,6 +31,7 @@ byte GDivisor;                              // number of edge events per declare
 //#define VENCODERPINS 0b00110000             // bitmap to select the two encoder inputs when on D0, D1
 #define VENCODERPINS 0b00001100             // bitmap to select the two encoder inputs when on A4, A5
 #define VENCODERDIRPIN 0b00001000           // pin3 gives direction
+#define VMAXDELTACOUNT 32765                // GDeltaCount limit, leaving room for a 2 step increment
 
 
 //
@@ -85,6 +87,7 @@ void InitOpticalEncoder(void)
 // this works one of two ways depending on the attached encoder
 // for a broadcom type encoder - use both edges; find 4 bits from 2 bits current state and 2 bits previous state, and look up
 // for a high res encoder at just one interrupt per pulse - use int on one edge and use the sense of the other to set direction.
+// the count saturates rather than wrapping; lost edges are counted
 //
 ISR(PORTA_PORT_vect)
 {
@@ -100,25 +103,57 @@ ISR(PORTA_PORT_vect)
 
 
 #ifdef VSWAPDIRECTION
-  GDeltaCount -= Increment;
-#else
-  GDeltaCount += Increment;
+  Increment = -Increment;
 #endif
+  if (((Increment > 0) && (GDeltaCount > VMAXDELTACOUNT))
+   || ((Increment < 0) && (GDeltaCount < -VMAXDELTACOUNT)))
+    GVFOOverflowCount++;
+  else
+    GDeltaCount += Increment;
+
+}
 
 
+//
+// return the accumulated edge count without changing it
+//
+int16_t PeekOpticalEncoder(void)
+{
+  int16_t Count;
+
+  noInterrupts();
+  Count = GDeltaCount;
+  interrupts();
+  return Count;
 }
 
 
 //
 // read the optical encoder. Return the number of steps turned since last called.
-// read back the count since last asked, then zero it for the next time
-// if Divisor is above 1: leave behind the residue
+// take a snapshot of the count with interrupts off, then subtract just the edges
+// that are being reported: edges that arrive in between are kept for next time.
+// if Divisor is above 1: the residue is left behind too
 //
-signed char ReadOpticalEncoder(void)
+int ReadOpticalEncoder(int MaxSteps)
 {
-  signed char Result;
-
-  Result = GDeltaCount / GDivisor;                         // get count value
-  GDeltaCount = GDeltaCount % GDivisor;                    // remaining residue for next time
+  int16_t Count;
+  int Result;
+
+  noInterrupts();
+  Count = GDeltaCount;                                     // atomic snapshot
+  interrupts();
+
+  Result = Count / GDivisor;                               // get count value
+  if (Result > MaxSteps)
+    Result = MaxSteps;
+  else if (Result < -MaxSteps)
+    Result = -MaxSteps;
+
+  if (Result != 0)
+  {
+    noInterrupts();
+    GDeltaCount -= (int16_t)(Result * GDivisor);           // remove only what is reported
+    interrupts();
+  }
   return Result;
 }
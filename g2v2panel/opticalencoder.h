@@ -18,10 +18,23 @@
 //
 void InitOpticalEncoder(void);
 
+//
+// accessible variables
+//
+extern volatile unsigned int GVFOOverflowCount;        // edges lost because the accumulator was full
+
+
 //
 // read the optical encoder. Return the number of steps turned since last called.
+// at most MaxSteps are returned; any more are left to be read next time
 //
-signed char ReadOpticalEncoder(void);
+int ReadOpticalEncoder(int MaxSteps);
+
+//
+// return the accumulated edge count without changing it
+//
+int16_t PeekOpticalEncoder(void);
+
 
 //
 // set divisor
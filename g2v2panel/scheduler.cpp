@@ -0,0 +1,233 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// scheduler.cpp
+// this file holds the static task table run from the 2ms tick
+// each task has a period and phase in ticks, so tasks that don't need to run
+// every tick can be spread over different ticks; and a time budget, so a
+// task that takes longer than expected is counted
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "globalinclude.h"
+#include "scheduler.h"
+#include "iopins.h"
+#include "encoders.h"
+#include "button.h"
+#include "SPIdata.h"
+#include "tiger.h"
+#include "txqueue.h"
+#include "led.h"
+#include "timebase.h"
+
+
+//
+// tasks that aren't in another module
+//
+
+//
+// queue the tick's MCP23S17 reads and start them as one batch
+//
+void InputReadsTick(void)
+{
+  QueueEncoderReads();
+  QueueButtonReads();
+  RunSPIBatch();
+}
+
+
+#ifndef MCPINTERRUPTS
+bool GHeartbeatOn;                          // heartbeat LED state
+
+//
+// heartbeat LED: toggled each run
+//
+void HeartbeatTick(void)
+{
+  GHeartbeatOn = !GHeartbeatOn;
+  if (GHeartbeatOn)
+    digitalWrite(VPINBLINKLED, HIGH);       // Led on, off, on, off...
+  else
+    digitalWrite(VPINBLINKLED, LOW);
+}
+#endif
+
+
+//
+// the task table, made from TASKLIST
+//
+const STask GTasks[eNumTasks] =
+{
+#define X(Name, Function, Period, Phase, Budget) {Function, #Name, Period, Phase, (Budget) * 1000L / VTIMERCOUNTNS},
+  TASKLIST
+#undef X
+};
+
+byte GTaskCountdown[eNumTasks];             // ticks until each task next runs
+unsigned long GTaskRuns[eNumTasks];         // runs since last read
+unsigned int GTaskOverruns[eNumTasks];      // runs over budget since last read
+unsigned long GTicksHandled;                // timebase tick count when the main loop last ran a tick
+unsigned int GTickOverruns;                 // main loop passes that missed one or more ticks
+unsigned long GLostTicks;                   // total ticks missed
+unsigned int GWorstTickGap;                 // most ticks between main loop ticks
+
+#ifdef TASKPROFILE
+static_assert(VPROFILETICK < 99, "too many tasks for the ZZZW task profiles (99 clears them)");
+STaskProfile GTaskProfiles[VPROFILETICK + 1];   // one per task, then the whole tick
+#endif
+
+
+
+//
+// initialise the task phases and the tick accounting
+//
+void InitTasks(void)
+{
+  byte Task;
+
+  for (Task = 0; Task < eNumTasks; Task++)
+    GTaskCountdown[Task] = GTasks[Task].Phase;
+  GTicksHandled = 0;                        // the timebase starts from 0 too
+  GTickOverruns = 0;
+  GLostTicks = 0;
+  GWorstTickGap = 1;
+#ifdef TASKPROFILE
+  ClearTaskProfiles();
+#endif
+}
+
+
+#ifdef TICKCATCHUP
+//
+// keep the task countdowns in step with the tick count after missed ticks:
+// a task that missed runs just runs at its next due tick.
+// (long press, LED test and LED pattern timing come from the timebase, so keep time anyway;
+// debounce isn't caught up: it counts matrix reads, and the missed ticks had none)
+//
+void CatchUpTicks(unsigned int Lost)
+{
+  byte Task;
+  byte Period, Countdown;
+
+  for (Task = 0; Task < eNumTasks; Task++)
+  {
+    Period = GTasks[Task].Period;
+    Countdown = GTaskCountdown[Task];
+    if (Lost > Countdown)
+      GTaskCountdown[Task] = Period - 1 - (Lost - 1 - Countdown) % Period;
+    else
+      GTaskCountdown[Task] = Countdown - Lost;
+  }
+}
+#endif
+
+
+//
+// check for a tick from the timer interrupt
+// the timebase counts ticks, so if more than one has passed since the main loop
+// last ran one, the extra ticks were missed
+//
+bool TickDue(void)
+{
+  unsigned long Count;
+  unsigned int Gap;
+
+  Count = TimebaseTicks();
+  Gap = (unsigned int)(Count - GTicksHandled);
+  if (Gap == 0)
+    return false;
+  GTicksHandled = Count;
+  if (Gap > 1)
+  {
+    GTickOverruns++;
+    GLostTicks += Gap - 1;
+    if (Gap > GWorstTickGap)
+      GWorstTickGap = Gap;
+#ifdef TICKCATCHUP
+    CatchUpTicks(Gap - 1);
+#endif
+  }
+  return true;
+}
+
+
+#ifdef TASKPROFILE
+//
+// clear all of the task profiles
+//
+void ClearTaskProfiles(void)
+{
+  byte Entry;
+
+  memset(GTaskProfiles, 0, sizeof(GTaskProfiles));
+  for (Entry = 0; Entry <= VPROFILETICK; Entry++)
+    GTaskProfiles[Entry].MinCounts = 0xFFFF;
+}
+
+
+//
+// add one run to a task profile
+// the histogram bin is found by doubling from 1/8 of the budget
+//
+void ProfileRun(STaskProfile* Profile, unsigned int Counts, unsigned int BudgetCounts)
+{
+  byte Bin;
+  unsigned int Limit;
+
+  if (Counts < Profile->MinCounts)
+    Profile->MinCounts = Counts;
+  if (Counts > Profile->MaxCounts)
+    Profile->MaxCounts = Counts;
+  Profile->TotalCounts += Counts;
+  Profile->Runs++;
+  Limit = BudgetCounts >> 3;
+  for (Bin = 0; (Bin < VPROFILEBINS - 1) && (Counts >= Limit); Bin++)
+    Limit <<= 1;
+  if (Profile->Histogram[Bin] != 0xFFFF)
+    Profile->Histogram[Bin]++;
+}
+#endif
+
+
+//
+// run the tasks due this tick, in table order
+// each is timed against its budget (and profiled, if TASKPROFILE)
+//
+void RunTasks(void)
+{
+  const STask* TaskPtr;
+  byte Task;
+  unsigned int Start, Counts;
+#ifdef TASKPROFILE
+  unsigned int TickStart;
+
+  TickStart = TimerCounts();
+#endif
+  for (Task = 0; Task < eNumTasks; Task++)
+  {
+    if (GTaskCountdown[Task] == 0)
+    {
+      TaskPtr = GTasks + Task;
+      GTaskCountdown[Task] = TaskPtr->Period - 1;
+      Start = TimerCounts();
+      TaskPtr->Function();
+      Counts = TimerCounts() - Start;
+      if (Counts > TaskPtr->BudgetCounts)
+        GTaskOverruns[Task]++;
+      GTaskRuns[Task]++;
+#ifdef TASKPROFILE
+      ProfileRun(GTaskProfiles + Task, Counts, TaskPtr->BudgetCounts);
+#endif
+    }
+    else
+      GTaskCountdown[Task]--;
+  }
+#ifdef TASKPROFILE
+  ProfileRun(GTaskProfiles + VPROFILETICK, TimerCounts() - TickStart, VTICKCOUNTS);
+#endif
+}
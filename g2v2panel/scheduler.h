@@ -0,0 +1,147 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// scheduler.h
+// this file holds the static task table run from the 2ms tick
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __SCHEDULER_H
+#define __SCHEDULER_H
+#include <Arduino.h>
+#include "globalinclude.h"
+#include "timebase.h"
+
+
+#define VLEDTASKPERIOD 5                    // LED task period (ticks): 10ms
+
+//
+// the heartbeat LED's pin is the MCP23S17 interrupt input if MCPINTERRUPTS
+//
+#ifdef MCPINTERRUPTS
+#define HEARTBEATTASK
+#else
+#define HEARTBEATTASK X(Heartbeat, HeartbeatTick, 250, 0, 20)     /* blink LED: 500ms on, 500ms off */
+#endif
+
+//
+// the list of all of the tasks, in the order they run in a tick
+// this one list generates the ETasks enum and the GTasks table, so they can't get out of step.
+// One line per task:
+// X(name, function, period (ticks), phase (tick of the period it runs in), budget (us))
+// a task that runs for longer than its budget is counted as an overrun.
+// tasks that run every tick must stay that way: the MCP23S17 reads queued
+// by InputReadsTick are used by EncoderTick and ButtonTick, and AssertMatrixColumn
+// drives the column that the next tick's read sees
+//
+#define TASKLIST \
+  X(InputReads, InputReadsTick, 1, 0, 60)                  /* queue and start the MCP23S17 reads */ \
+  X(Encoders, EncoderTick, 1, 0, 200)                      /* encoder inputs */ \
+  X(Buttons, ButtonTick, 1, 0, 150)                        /* pushbutton sequencer */ \
+  X(CATParse, ScanParseSerial, 1, 0, 400)                  /* received CAT commands */ \
+  X(TXQueue, TXQueueTick, 1, 0, 300)                       /* send queued CAT messages */ \
+  X(CATLink, CATLinkTick, 1, 0, 50)                        /* CAT baud rate changes */ \
+  X(LEDs, LEDTick, VLEDTASKPERIOD, 2, 300)                 /* LED test, patterns and bit planes */ \
+  X(MCPLEDs, LEDMCPTick, 1, 0, 20)                         /* MCP23S17 LED bit plane for this tick */ \
+  HEARTBEATTASK \
+  X(MatrixColumn, AssertMatrixColumn, 1, 0, 60)            /* last: drive the next matrix column */
+
+
+//
+// enumerated list of all of the tasks, eg eTaskEncoders
+//
+enum ETasks
+{
+#define X(Name, Function, Period, Phase, Budget) eTask##Name,
+  TASKLIST
+#undef X
+  eNumTasks
+};
+
+
+//
+// this struct holds a record to describe one task
+// the table is const, so it stays in flash
+//
+struct STask
+{
+  void (*Function)(void);         // called when the task is due
+  const char* Name;               // for diagnostics
+  byte Period;                    // ticks between runs
+  byte Phase;                     // tick of the period it runs in (0 to period-1)
+  unsigned int BudgetCounts;      // longest expected run, in timer counts
+};
+
+extern const STask GTasks[eNumTasks];
+
+//
+// task statistics (ZZZG items eDiagTaskRuns and eDiagTaskOverruns + task number)
+//
+extern unsigned long GTaskRuns[eNumTasks];          // runs since last read
+extern unsigned int GTaskOverruns[eNumTasks];       // runs over budget since last read
+
+//
+// tick accounting: the timebase counts ticks, and the main loop counts the ticks it has run.
+// if a pass of the main loop takes longer than a tick, ticks are missed; they are
+// counted (ZZZG items eDiagTickOverruns, eDiagLostTicks, eDiagWorstTickGap)
+// and, with TICKCATCHUP, the task countdowns are moved on by the missed ticks
+//
+extern unsigned long GTicksHandled;                 // timebase tick count when the main loop last ran a tick
+extern unsigned int GTickOverruns;                  // main loop passes that missed one or more ticks
+extern unsigned long GLostTicks;                    // total ticks missed
+extern unsigned int GWorstTickGap;                  // most ticks between main loop ticks (1 = none missed)
+
+#ifdef TASKPROFILE
+//
+// task profiles (ZZZW): run time statistics for each task, and for the whole tick,
+// since they were last cleared. Times are in timer counts (0.5us)
+// the histogram bins are run times of <1/8, <1/4, <1/2, <1, <2 and >=2 times the budget
+//
+#define VPROFILEBINS 6
+#define VPROFILETICK eNumTasks              // profile entry for the whole tick, after the tasks
+#define VTICKCOUNTS (VTICKMICROS * 1000L / VTIMERCOUNTNS)  // timer counts in a tick: the whole tick's budget
+
+struct STaskProfile
+{
+  unsigned int MinCounts;                   // shortest run
+  unsigned int MaxCounts;                   // longest run
+  unsigned long TotalCounts;                // sum of all runs, for the mean
+  unsigned long Runs;                       // runs since cleared
+  unsigned int Histogram[VPROFILEBINS];     // runs in each bin (saturates)
+};
+
+extern STaskProfile GTaskProfiles[VPROFILETICK + 1];
+
+
+//
+// clear all of the task profiles
+//
+void ClearTaskProfiles(void);
+#endif
+
+
+//
+// initialise the task phases and the tick accounting
+//
+void InitTasks(void);
+
+
+//
+// check for a tick from the timer interrupt
+// returns true if a tick is due; missed ticks are counted (and caught up if TICKCATCHUP)
+//
+bool TickDue(void);
+
+
+//
+// run the tasks due this tick
+// called once per 2ms tick
+//
+void RunTasks(void);
+
+
+#endif //not defined
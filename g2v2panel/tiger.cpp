@@ -13,313 +13,415 @@
 
 #include "globalinclude.h"
 #include "tiger.h"
+#include "catformat.h"
 #include "cathandler.h"
 #include "led.h"
+#include "txqueue.h"
+#include "encoders.h"
 
 //
-// input buffer
+// CAT link baud rate
+// the host requests a new rate with ZZZBn; the panel replies ZZZBn; at the old rate,
+// then changes rate. The host must then send a valid command at the new rate
+// within VBAUDCONFIRMTICKS, or the panel falls back to VCATBAUD.
 //
-
-#define VBUFLENGTH 128
-char GCATInputBuffer[VBUFLENGTH];
-char* GCATWritePtr;
+#define VBAUDCONFIRMTICKS 1000                          // 2s to confirm a new baud rate
+#define VNUMBAUDRATES 6
+const unsigned long GCATBaudRates[VNUMBAUDRATES] =
+{
+  VCATBAUD,                                             // 0: default 9600
+  115200L,                                              // 1
+  230400L,                                              // 2
+  250000L,                                              // 3
+  500000L,                                              // 4
+  1000000L                                              // 5
+};
+byte GCATBaudCode;                                      // current rate
+byte GCATRequestedBaudCode;                             // rate to change to once the reply is sent
+bool GCATBaudChangePending;                             // true if a rate change has been requested
+bool GCATBaudReplySent;                                 // the reply has left the TX buffer (bar the last byte)
+unsigned int GCATBaudConfirmTicks;                      // ticks left to confirm new rate; 0 if confirmed
 char Output[40];                                        // TX CAT msg buffer
-byte GNumCommands;                                      // number of commands in table
 
 
 //
-// lookup initial divisor from number of digits
+// powers of ten for the numeric formatter (catformat.h)
+// 16 bit values are used for parameters of up to 4 digits
 //
-long DivisorTable[] =
+const unsigned long GCATPowersOf10[VMAXCATDIGITS - 1] =
 {
-  0L,                                                    // not used
-  1L,                                                    // 1 digit - already have units
-  10L,                                                   // 2 digits - tens is first
-  100L,                                                  // 3 digits - hundreds is 1st
-  1000L,                                                 // 4 digits - thousands is 1st
-  10000L,                                                // 5 digits - ten thousands is 1st
-  100000L,                                               // 6 digits - hundred thousands
-  1000000L,                                              // millions
-  10000000L,                                             // 10 millions
-  100000000L,                                            // 100 millions
-  1000000000L,                                           // 1000 millions
-  10000000000L,                                          // 10000 millions
-  100000000000L,                                         // 100000 millions
-  1000000000000L,                                        // 1000000 millions
-  10000000000000L                                        // 10000000 millions
+  1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+  10000UL, 1000UL, 100UL, 10UL
 };
 
+const unsigned int GCATShortPowersOf10[3] = {1000, 100, 10};
 
 
+
+//
+// 4 character command as one 32 bit word, as built up by the parser
 //
-// array of records. This must exactly match the enum ECATCommands in tiger.h
-// and the number of commands defined here must be correct
-// (not including the final eNoCommand)
-#define VNUMCATCMDS 7
+constexpr unsigned long CATWord(const char* Cmd)
+{
+  return ((unsigned long)Cmd[0] << 24) | ((unsigned long)Cmd[1] << 16) | ((unsigned long)Cmd[2] << 8) | (unsigned long)Cmd[3];
+}
+
 
-SCATCommands GCATCommands[VNUMCATCMDS] = 
+//
+// array of records, generated from CATCOMMANDLIST in tiger.h
+//
+const SCATCommands GCATCommands[VNUMCATCMDS] = 
 {
-  {"ZZZD", eNum, 0, 99, 2, false},                        // VFO down
-  {"ZZZU", eNum, 0, 99, 2, false},                        // VFO up
-  {"ZZZE", eNum, 0, 999, 3, false},                       // encoder
-  {"ZZZP", eNum, 0, 999, 3, false},                       // pushbutton
-  {"ZZZI", eNum, 0, 999, 3, false},                       // indicator
-  {"ZZZS", eNum, 0, 9999999, 7, false},                   // s/w version
-  {"ZZZX", eNum, 1, 999, 3, false}                        // encoder increments
+#define X(Cmd, RXType, MinValue, MaxValue, NumParams, AlwaysSigned) \
+  {#Cmd, CATWord(#Cmd), RXType, MinValue, MaxValue, NumParams, AlwaysSigned},
+  CATCOMMANDLIST
+#undef X
 };
 
 
+//
+// perfect hash to find a command from its 4 character word:
+// the word is multiplied by GCATHashMultiplier and the top VCATHASHBITS bits of the
+// 32 bit product index GCATHashTable, which holds the only command that can match,
+// or eNoCommand. The multiplier is searched for when compiling: the first odd
+// multiple of VCATHASHSEED that gives every command its own slot. 256 slots keep
+// the search short for up to about 50 commands.
+// the table is built when compiling, from a constexpr copy of the command words
+//
+#define VCATHASHBITS 8
+#define VCATHASHSIZE (1 << VCATHASHBITS)
+#define VCATHASHSEED 0x9E3779B1UL               // first multiplier tried (2^32 / golden ratio)
+#define VCATHASHTRIES 250                       // multipliers tried before giving up
 
-// this array holds a 32 bit representation of the CAT command
-// to so a compare in a single test
-unsigned long GCATMatch[VNUMCATCMDS];
+constexpr const char* GCATNames[] =
+{
+#define X(Cmd, RXType, MinValue, MaxValue, NumParams, AlwaysSigned) #Cmd,
+  CATCOMMANDLIST
+#undef X
+};
 
+constexpr byte CATHash(unsigned long Word, unsigned long Multiplier)
+{
+  return (byte)((uint32_t)(Word * Multiplier) >> (32 - VCATHASHBITS));
+}
 
-//
-// Make32BitStr
-// simply a 4 char CAT command in a single 32 bit word for easy compare
-//
-unsigned long Make32BitStr(char* Input)
+// the multiplier to try for attempt Try
+constexpr unsigned long CATHashCandidate(unsigned int Try)
 {
-  unsigned long Result;
-  byte CharCntr;
-  char Ch;
-  
-  Result = 0;
-  for(CharCntr=0; CharCntr < 4; CharCntr++)
-  {
-    Ch = Input[CharCntr];                                           // input character
-    if (isLowerCase(Ch))                                             // force lower case to upper case
-      Ch -= 0x20;
-    Result = (Result << 8) | Ch;
-  }
-  return Result;
+  return (uint32_t)(VCATHASHSEED * (2UL * Try + 1));
+}
+
+// true if command Cmd shares a slot with any command from Other onwards
+constexpr bool CATHashCollides(byte Cmd, byte Other, unsigned long Multiplier)
+{
+  return (Other == VNUMCATCMDS) ? false :
+         (CATHash(CATWord(GCATNames[Cmd]), Multiplier) == CATHash(CATWord(GCATNames[Other]), Multiplier))
+         || CATHashCollides(Cmd, Other + 1, Multiplier);
+}
+
+// true if no two commands share a slot, from command Cmd onwards
+constexpr bool CATHashIsPerfect(byte Cmd, unsigned long Multiplier)
+{
+  return (Cmd == VNUMCATCMDS) ? true :
+         !CATHashCollides(Cmd, Cmd + 1, Multiplier) && CATHashIsPerfect(Cmd + 1, Multiplier);
+}
+
+// the first attempt from Try onwards whose multiplier is a perfect hash (VCATHASHTRIES if none)
+constexpr unsigned int FindCATHashTry(unsigned int Try)
+{
+  return (Try == VCATHASHTRIES) ? Try :
+         CATHashIsPerfect(0, CATHashCandidate(Try)) ? Try : FindCATHashTry(Try + 1);
+}
+
+// true if every command from Cmd onwards is 4 upper case letters
+constexpr bool CATNamesValid(byte Cmd)
+{
+  return (Cmd == VNUMCATCMDS) ? true :
+         (GCATNames[Cmd][0] >= 'A') && (GCATNames[Cmd][0] <= 'Z') && (GCATNames[Cmd][1] >= 'A') && (GCATNames[Cmd][1] <= 'Z')
+         && (GCATNames[Cmd][2] >= 'A') && (GCATNames[Cmd][2] <= 'Z') && (GCATNames[Cmd][3] >= 'A') && (GCATNames[Cmd][3] <= 'Z')
+         && (GCATNames[Cmd][4] == 0) && CATNamesValid(Cmd + 1);
 }
 
+constexpr unsigned int GCATHashTry = FindCATHashTry(0);
+constexpr unsigned long GCATHashMultiplier = CATHashCandidate(GCATHashTry);
+
+static_assert(sizeof(GCATNames) / sizeof(GCATNames[0]) == VNUMCATCMDS, "CAT name list doesn't match the command enum");
+static_assert(VNUMCATCMDS < 255, "too many CAT commands for a byte index");
+static_assert(CATNamesValid(0), "CAT commands must be 4 letters");
+static_assert(GCATHashTry < VCATHASHTRIES, "no perfect CAT hash found: increase VCATHASHBITS");
+
+// find the command in a hash slot, starting from command Cmd
+constexpr byte FindCATHashSlot(byte Slot, byte Cmd)
+{
+  return (Cmd == VNUMCATCMDS) ? (byte)eNoCommand :
+         (CATHash(CATWord(GCATNames[Cmd]), GCATHashMultiplier) == Slot) ? Cmd : FindCATHashSlot(Slot, Cmd + 1);
+}
+
+#define CATHASHROW(n) FindCATHashSlot(n, 0), FindCATHashSlot(n + 1, 0), FindCATHashSlot(n + 2, 0), FindCATHashSlot(n + 3, 0), \
+                      FindCATHashSlot(n + 4, 0), FindCATHashSlot(n + 5, 0), FindCATHashSlot(n + 6, 0), FindCATHashSlot(n + 7, 0)
+#define CATHASHBLOCK(n) CATHASHROW(n), CATHASHROW(n + 8), CATHASHROW(n + 16), CATHASHROW(n + 24), \
+                        CATHASHROW(n + 32), CATHASHROW(n + 40), CATHASHROW(n + 48), CATHASHROW(n + 56)
+
+const byte GCATHashTable[VCATHASHSIZE] =
+{
+  CATHASHBLOCK(0), CATHASHBLOCK(64), CATHASHBLOCK(128), CATHASHBLOCK(192)
+};
+static_assert(VCATHASHSIZE == 256, "GCATHashTable blocks don't match VCATHASHBITS");
+
+
+
+
 
 //
 // initialise CAT handler
-// load up the match strings with either valid commands or debug commands
 //
 void InitCAT()
 {
-  int CmdCntr;
-  unsigned long MatchWord;
-// initialise the matching 32 bit words to hold a version of each CAT command
-  GNumCommands = VNUMCATCMDS;
-  for(CmdCntr=0; CmdCntr < VNUMCATCMDS; CmdCntr++)
+  InitTXQueue();
+  ResetCATParser();
+  GCATBaudCode = 0;
+  GCATBaudChangePending = false;
+  GCATBaudConfirmTicks = 0;
+}
+
+
+
+//
+// change the serial port baud rate
+// the parser is reset, as any partial line arrived at the old rate
+//
+void SetCATBaudRate(byte Code)
+{
+  unsigned long Baud;
+
+  GCATBaudCode = Code;
+  Baud = GCATBaudRates[Code];
+  CATSERIAL.end();
+  CATSERIAL.begin(Baud);
+  SetVFOLinkRate(Baud);
+  ResetCATParser();
+}
+
+
+
+//
+// host has requested a new baud rate: queue the reply, to be sent at the old rate
+// the TX queue is held after the reply, so later events are sent at the new rate
+//
+void RequestCATBaudRate(byte Code)
+{
+  if (Code < VNUMBAUDRATES)
   {
-    MatchWord = Make32BitStr(GCATCommands[CmdCntr].CATString);
-    GCATMatch[CmdCntr] = MatchWord;
+    GCATRequestedBaudCode = Code;
+    GCATBaudChangePending = true;
+    GCATBaudReplySent = false;
+    MakeCATMessageNumeric(eZZZB, Code);
+    HoldTXQueue();
   }
-  GCATWritePtr = GCATInputBuffer;                   // point to start of buffer
 }
 
 
 
 //
-// ScanParseSerial()
-// scans input serial stream for characters; parses complete commands
-// when it finds one
+// get the current baud rate code
 //
-void ScanParseSerial()
+byte GetCATBaudCode(void)
 {
-  int ReadChars;                                  // number of read characters available
-  char Ch;
-  byte Cntr;
-  if(CATSERIAL)
-  {
-    ReadChars = CATSERIAL.available();
-    if (ReadChars != 0)
-    {
+  return GCATBaudCode;
+}
+
+
+
 //
-// we have input data available, so read it one char at a time and write to buffer
-// if we find a terminating semicolon, process the command
-// if we get a control character, abandon the line so far and start again
+// CAT link tick: call after TXQueueTick()
+// once the reply to a rate change has left the TX queue, wait (without blocking)
+// for the serial TX buffer to empty, then one more tick for its last byte to
+// go, and change rate. The ring buffer holds one byte less than its size.
+// then, if no valid command arrives at the new rate in time, fall back to the default
 //
-      for(Cntr=0; Cntr < ReadChars; Cntr++)
-      {
-        Ch=CATSERIAL.read();
-        if(isControl(Ch))
-          GCATWritePtr = GCATInputBuffer;                   // point to start of buffer
-        else
-        {
-          *GCATWritePtr++ = Ch;
-          if (Ch == ';')
-          {
-            *GCATWritePtr++ = 0;
-            ParseCATCmd();     
-          }
-        }
-      }
+void CATLinkTick(void)
+{
+  if (GCATBaudChangePending && TXQueueHeld())
+  {
+    if (CATSERIAL.availableForWrite() < SERIAL_TX_BUFFER_SIZE - 1)
+      return;                                           // still sending
+    if (!GCATBaudReplySent)
+    {
+      GCATBaudReplySent = true;                         // the last byte goes this tick
+      return;
     }
+    GCATBaudChangePending = false;
+    SetCATBaudRate(GCATRequestedBaudCode);
+    ReleaseTXQueue();
+    if (GCATBaudCode != 0)
+      GCATBaudConfirmTicks = VBAUDCONFIRMTICKS;
+    else
+      GCATBaudConfirmTicks = 0;
+  }
+  else if (GCATBaudConfirmTicks != 0)
+  {
+    if (--GCATBaudConfirmTicks == 0)
+      SetCATBaudRate(0);                                // not confirmed: fall back
   }
 }
 
 
 
 //
-// helper function
-// returns true of the value found would be a legal character in a signed int, including the signs
+// streaming CAT parser
+// characters are handled one at a time as they arrive: the first 4 are the
+// command word, then an optional sign and digits are accumulated into the
+// parameter, and ';' completes the command. No line is buffered, so there is
+// no buffer to overrun. Anything unexpected abandons the line up to the next ';'
+// a parameter with more than VMAXPARAMDIGITS digits is invalid, so the
+// accumulated value can't overflow a long
 //
-bool isNumeric(char ch)
+#define VMAXCATBYTESPERTICK 32                  // max bytes parsed per 2ms tick (16KBytes/s)
+#define VMAXPARAMDIGITS 9                       // max digits in a parameter
+
+enum ECATParseState
 {
-  bool Result = false;
+  eParseCommand,                                // collecting the 4 command characters
+  eParseParam,                                  // collecting the parameter
+  eParseDiscard                                 // bad line: skip to the next ';'
+};
 
-  if (isDigit(ch))
-    Result = true;
-  else if ((ch == '+') || (ch == '-'))
-    Result = true;
+ECATParseState GCATParseState;
+byte GCATCharCount;                             // command characters, then parameter characters, found
+unsigned long GCATParseWord;                    // command word so far
+ECATCommands GCATParseCmd;                      // command matched
+long GCATParseParam;                            // parameter so far (without sign)
+bool GCATParseNegative;                         // true if a - sign found
+byte GCATParseDigits;                           // parameter digits found
 
-  return Result;
+
+//
+// abandon the current line and start again
+//
+void ResetCATParser(void)
+{
+  GCATParseState = eParseCommand;
+  GCATCharCount = 0;
+  GCATParseWord = 0;
 }
 
 
 //
-// ParseCATCmd()
-// Parse a single command in the local input buffer
-// process it if it is a valid command
+// a complete valid command has been parsed: act on it
 //
-void ParseCATCmd(void)
+void ExecuteCATCmd(void)
 {
-  int CharCnt;                              // number of characters in the buffer (same as length of string)
-  unsigned long MatchWord;                  // 32 bit compressed input cmd
-  ECATCommands MatchedCAT = eNoCommand;     // CAT command we've matched this to
-  int CmdCntr;                              // counts CAT commands
-  SCATCommands* StructPtr;                  // pointer to structure with CAT data
-  ERXParamType ParsedType;                  // type of parameter actually found
-  bool ParsedBool;                          // if a bool expected, it goes here
-  long ParsedInt;                            // if int expected, it goes here
-  char ParsedString[20];                    // if string expected, it goes here
-  int ByteCntr;
-  char ch;
-  bool ValidResult = true;                  // true if we get a valid parse result
+  const SCATCommands* StructPtr;
+  long Param;
+
+  GCATBaudConfirmTicks = 0;                     // a valid command confirms the baud rate
+  StructPtr = GCATCommands + (int)GCATParseCmd;
+  if (GCATParseDigits == 0)
+    HandleCATCommandNoParam(GCATParseCmd);
+  else if (StructPtr->RXType != eStr)
+  {
+    Param = GCATParseNegative ? -GCATParseParam : GCATParseParam;
+    Param = constrain(Param, StructPtr->MinParamValue, StructPtr->MaxParamValue);
+    if (StructPtr->RXType == eNum)
+      HandleCATCommandNumParam(GCATParseCmd, Param);
+  }
+}
+
 
-  
-  CharCnt = (GCATWritePtr - GCATInputBuffer) - 2;
 //
-// CharCnt holds the input string length excluding the terminating null and excluding the semicolon
-// test minimum length for a valid CAT command: ZZxx; plus terminating 0
+// ParseCATChar()
+// process one received character
 //
-  if (CharCnt < 4)
-    ValidResult = false;
-  else
+void ParseCATChar(char Ch)
+{
+  byte HashCmd;
+
+  if (isControl(Ch))                                                // abandon the line so far and start again
   {
-    MatchWord = Make32BitStr(GCATInputBuffer);
-    for (CmdCntr=0; CmdCntr < GNumCommands; CmdCntr++)         // loop thro commands we recognise
-    {
-      if (GCATMatch[CmdCntr] == MatchWord)
+    ResetCATParser();
+    return;
+  }
+
+  switch(GCATParseState)
+  {
+    case eParseCommand:
+      if (Ch == ';')                                                // too short
       {
-        MatchedCAT = (ECATCommands)CmdCntr;                           // if a match, exit loop
-        StructPtr = GCATCommands + (int)CmdCntr;
+        ResetCATParser();
         break;
       }
-    }
-    if(MatchedCAT == eNoCommand)                                      // if no match was found
-      ValidResult = false;
-    else
-    {
-//
-// we have recognised a 4 char ZZnn command that is terminated by a semicolon
-// now we need to process the parameter bytes (if any) in the middle
-// the CAT structs have the required information
-// any parameter starts at position 4 and ends at (charcnt-1)
-//
-      if (CharCnt == 4)
-        ParsedType=eNone;
-      else
+      if (isLowerCase(Ch))                                          // force lower case to upper case
+        Ch -= 0x20;
+      GCATParseWord = (GCATParseWord << 8) | (byte)Ch;
+      if (++GCATCharCount == 4)
       {
-//
-// strategy is: first copy just the param to a string
-// if required type is not a string, parse to a number
-// then if required type is bool, check the value
-//        
-        ParsedType = eStr;
-        for(ByteCntr = 0; ByteCntr < (CharCnt-4); ByteCntr++)
-          ParsedString[ByteCntr] = GCATInputBuffer[ByteCntr+4];
-        ParsedString[CharCnt - 4] = 0;
-// now see if we want a non string type
-// for an integer - use atoi, but see if 1st character is numeric, + or -
-        if (StructPtr->RXType != eStr)
+        HashCmd = GCATHashTable[CATHash(GCATParseWord, GCATHashMultiplier)];   // find the command from its word
+        if ((HashCmd != eNoCommand) && (GCATCommands[HashCmd].MatchWord == GCATParseWord))
         {
-          ch=ParsedString[0];
-          if (isNumeric(ch))
-          {
-            ParsedType = eNum;
-            ParsedInt = atoi(ParsedString);
-// finally see if we need a bool
-            if (StructPtr->RXType == eBool)
-            {
-              ParsedType = eBool;
-              if (ParsedInt == 1)
-                ParsedBool = true;
-              else
-                ParsedBool = false;
-            }
-          }
-          else
-          {
-            ParsedType = eNone;
-            ValidResult = false;            
-          }
+          GCATParseCmd = (ECATCommands)HashCmd;
+          GCATParseState = eParseParam;
+          GCATCharCount = 0;
+          GCATParseParam = 0;
+          GCATParseNegative = false;
+          GCATParseDigits = 0;
         }
+        else
+          GCATParseState = eParseDiscard;
       }
-    }
-  }
-  if (ValidResult == true)
-  {
-//    Serial.print("match= ");
-//    Serial.print(GCATCommands[MatchedCAT].CATString);
-//    Serial.print("; parameter=");
-    switch(ParsedType)
-    {
-      case eStr: 
-        break;
-      case eNum:
-        ParsedInt = constrain(ParsedInt, StructPtr->MinParamValue, StructPtr->MaxParamValue);
-        HandleCATCommandNumParam(MatchedCAT, ParsedInt);
-        break;
-      case eBool:
-        break;
-      case eNone:
-        HandleCATCommandNoParam(MatchedCAT);
-        break;
-    }
-  }
-  else
-  {
-//    Serial.print("Parse Error - cmd= ");
-//    Serial.println(GCATInputBuffer);
-  }
-//
-// finally clear the input buffer to start again for the next command
-//
-   GCATWritePtr = GCATInputBuffer;                   // point to start of buffer
-}
-
-
+      break;
 
+    case eParseParam:
+      if (Ch == ';')
+      {
+        if ((GCATCharCount == 0) || (GCATParseDigits != 0))         // no parameter, or a number
+          ExecuteCATCmd();
+        ResetCATParser();
+      }
+      else if (isDigit(Ch) && (GCATParseDigits < VMAXPARAMDIGITS))
+      {
+        GCATParseParam = GCATParseParam * 10 + (Ch - '0');
+        GCATParseDigits++;
+        GCATCharCount++;
+      }
+      else if (((Ch == '+') || (Ch == '-')) && (GCATCharCount == 0)) // sign allowed first
+      {
+        GCATParseNegative = (Ch == '-');
+        GCATCharCount++;
+      }
+      else
+        GCATParseState = eParseDiscard;
+      break;
 
-//
-// send a CAT command
-//
-void SendCATMessage(char* Msg)
-{
-  CATSERIAL.print(Msg);
+    case eParseDiscard:
+      if (Ch == ';')
+        ResetCATParser();
+      break;
+  }
 }
 
 
 
 //
-// helper to append a string with a character
+// ScanParseSerial()
+// scans input serial stream for characters; parses complete commands
+// when it finds one
+// at most VMAXCATBYTESPERTICK are taken each tick: any more are left for the next tick
+// a character is only taken if the TX queue has space for the longest reply
+// the command it completes could make, so a burst of queries waits in the
+// serial RX buffer until their replies can be sent, and no reply is lost
 //
-void Append(char* s, char ch)
+void ScanParseSerial()
 {
-  byte len;
+  int ReadChars;                                  // number of read characters available
 
-  len = strlen(s);
-  s[len++] = ch;
-  s[len] = 0;
+  if(CATSERIAL)
+  {
+    ReadChars = CATSERIAL.available();
+    if (ReadChars > VMAXCATBYTESPERTICK)
+      ReadChars = VMAXCATBYTESPERTICK;
+    while ((ReadChars-- > 0) && (TXReplySpace() >= VMAXCATREPLIES))
+      ParseCATChar(CATSERIAL.read());
+  }
 }
 
 
@@ -329,94 +431,81 @@ void Append(char* s, char ch)
 // create CAT message:
 // this creates a "basic" CAT command with no parameter
 // (for example to send a "get" command)
+// the message is queued, and sent when the serial link has space for it
 //
 void MakeCATMessageNoParam(ECATCommands Cmd)
 {
-  SCATCommands* StructPtr;
+  QueueCATMessageNoParam(Cmd);
+}
+
+
+//
+// format a CAT command with no parameter into Msg
+// returns the message length
+//
+byte FormatCATMessageNoParam(char* Msg, ECATCommands Cmd)
+{
+  const SCATCommands* StructPtr;
 
   StructPtr = GCATCommands + (int)Cmd;
-  strcpy(Output, StructPtr->CATString);
-  strcat(Output, ";");
-  SendCATMessage(Output);
+  strcpy(Msg, StructPtr->CATString);
+  strcat(Msg, ";");
+  return strlen(Msg);
 }
 
 
 
 //
 // make a CAT command with a numeric parameter
+// the message is queued, and sent when the serial link has space for it
 //
 void MakeCATMessageNumeric(ECATCommands Cmd, long Param)
 {
-  byte CharCount;                  // character count to add
-  unsigned long Divisor;           // initial divisor to convert to ascii
-  unsigned long Digit;             // decimal digit found
-  char ASCIIDigit;
-  SCATCommands* StructPtr;
+  QueueCATMessage(Cmd, Param);
+}
+
+
 
-  StructPtr = GCATCommands + (int)Cmd;
-  strcpy(Output, StructPtr->CATString);
-  CharCount = StructPtr->NumParams;
-//
-// clip the parameter to the allowed numeric range
-//
-  if (Param > StructPtr->MaxParamValue)
-    Param = StructPtr->MaxParamValue;
-  else if (Param < StructPtr->MinParamValue)
-    Param = StructPtr->MinParamValue;
-//
-// now add sign if needed
-//
-  if (StructPtr -> AlwaysSigned)
-  {
-    if (Param < 0)
-    {
-      strcat(Output, "-");
-      Param = -Param;                   // make positive
-    }
-    else
-      strcat(Output, "+");
-    CharCount--;
-  }
-  else if (Param < 0)                   // not always signed, but neg so it needs a sign
-  {
-      strcat(Output, "-");
-      Param = -Param;      
-      CharCount--;                      // make positive
-  }
 //
-// we now have a positive number to fit into <CharCount> digits
-// pad with zeros if needed
+// format a CAT command with a numeric parameter into Msg
+// returns the message length
+// for a command known when compiling, FormatCATNumeric<>() does the same
 //
-  Divisor = DivisorTable[CharCount];
-  while (Divisor > 1)
-  {
-    Digit = Param / Divisor;                  // get the digit for this decimal position
-    ASCIIDigit = (char)(Digit + '0');         // ASCII version - and output it
-    Append(Output, ASCIIDigit);
-    Param = Param - (Digit * Divisor);        // get remainder
-    Divisor = Divisor / 10;                   // set for next digit
-  }
-  ASCIIDigit = (char)(Param + '0');           // ASCII version of units digit
-  Append(Output, ASCIIDigit);
-  strcat(Output, ";");
-  SendCATMessage(Output);
+byte FormatCATMessageNumeric(char* Msg, ECATCommands Cmd, long Param)
+{
+  const SCATCommands* StructPtr;
+
+  StructPtr = GCATCommands + (int)Cmd;
+  return FormatCATFields(Msg, StructPtr->CATString[3], StructPtr->NumParams, StructPtr->MinParamValue,
+                         StructPtr->MaxParamValue, StructPtr->AlwaysSigned, Param);
 }
 
 
 //
 // make a CAT command with a bool parameter
+// the message is queued, and sent when the serial link has space for it
 //
 void MakeCATMessageBool(ECATCommands Cmd, bool Param) 
 {
-  SCATCommands* StructPtr;
+  QueueCATMessageBool(Cmd, Param);
+}
+
+
+//
+// format a CAT command with a bool parameter into Msg
+// returns the message length
+//
+byte FormatCATMessageBool(char* Msg, ECATCommands Cmd, bool Param)
+{
+  const SCATCommands* StructPtr;
 
   StructPtr = GCATCommands + (byte)Cmd;
-  strcpy(Output, StructPtr->CATString);               // copy the base message
+  strcpy(Msg, StructPtr->CATString);                  // copy the base message
   if (Param)
-    strcat(Output, "1;");
+    strcat(Msg, "1;");
   else
-    strcat(Output, "0;");
-  SendCATMessage(Output);
+    strcat(Msg, "0;");
+  return strlen(Msg);
 }
 
 
@@ -424,11 +513,12 @@ void MakeCATMessageBool(ECATCommands Cmd, bool Param)
 //
 // make a CAT command with a string parameter
 // the string is truncated if too long, or padded with spaces if too short
+// the formatted message is queued, and sent when the serial link has space for it
 //
 void MakeCATMessageString(ECATCommands Cmd, char* Param) 
 {
   byte ParamLength, ReqdLength;                        // string lengths
-  SCATCommands* StructPtr;
+  const SCATCommands* StructPtr;
   byte Cntr;
 
   StructPtr = GCATCommands + (byte)Cmd;
@@ -446,8 +536,8 @@ void MakeCATMessageString(ECATCommands Cmd, char* Param)
   for (Cntr=0; Cntr < (ReqdLength-ParamLength); Cntr++)
     strcat(Output, " ");
 //
-// finally terminate and send  
+// finally terminate and queue
 //
   strcat(Output, ";");                                // add the terminating semicolon
-  SendCATMessage(Output);
+  QueueCATString(Cmd, Output);
 }
@@ -13,23 +13,70 @@
 #ifndef __tiger_h
 #define __tiger_h
 #include <Arduino.h>
+#include "globalinclude.h"
 
 
 //
-// firstly an enumerated list of all of the CAT commands
+// task profile reads only exist if TASKPROFILE
+//
+#ifdef TASKPROFILE
+#define PROFILECATCOMMAND X(ZZZW, eNum, 0, 999999999, 9, false)    /* task profile: task (2 digits), statistic (1), value (6) */
+#else
+#define PROFILECATCOMMAND
+#endif
+
+//
+// the list of all of the CAT commands
 // ordered as per documentation, not alphsabetically!
+// this one list generates the ECATCommands enum and the GCATCommands table,
+// so they can't get out of step. One line per command:
+// X(command, RX parameter type, min param value, max param value, number of param digits, always signed)
+// commands are found by a perfect hash of all 4 letters, searched for when compiling
+// (if none is found, the build fails: see VCATHASHBITS in tiger.cpp)
+//
+#define CATCOMMANDLIST \
+  X(ZZZD, eNum, 0, 99, 2, false)                              /* VFO steps down */ \
+  X(ZZZU, eNum, 0, 99, 2, false)                              /* VFO steps up */ \
+  X(ZZZE, eNum, 0, 999, 3, false)                             /* other encoder */ \
+  X(ZZZP, eNum, 0, 999, 3, false)                             /* pushbutton */ \
+  X(ZZZI, eNum, 0, 999, 3, false)                             /* indicator */ \
+  X(ZZZS, eNum, 0, 9999999, 7, false)                         /* s/w version */ \
+  X(ZZZX, eNum, 1, 999, 3, false)                             /* encoder increments */ \
+  X(ZZZM, eNum, 0, 1, 1, false)                               /* encoder reporting mode */ \
+  X(ZZZG, eNum, 0, 999999999, 9, false)                       /* diagnostic value: item (2 digits) + value (7 digits) */ \
+  X(ZZZV, eNum, 0, 99, 2, false)                              /* VFO report policy */ \
+  X(ZZZA, eNum, 10000, 29999, 5, false)                       /* encoder acceleration: class, threshold, gain */ \
+  X(ZZZB, eNum, 0, 5, 1, false)                               /* CAT link baud rate code */ \
+  X(ZZZF, eNum, 0, 1, 1, false)                               /* binary event frame mode */ \
+  X(ZZZK, eNum, 10, 39, 2, false)                             /* button debounce policy: class, eager */ \
+  X(ZZZL, eNum, 0, 117, 3, false)                             /* LED brightness: LED (00 = all), level (MCPINTERRUPTS: LEDs 1-4 full while no key pressed) */ \
+  X(ZZZN, eNum, 100, 1139, 4, false)                          /* LED pattern: LED, pattern, period (x 200ms) */ \
+  X(ZZZT, eNum, 0, 2, 1, false)                               /* event timestamp mode (ETimestampMode) */ \
+  X(ZZZC, eNum, 0, 999999999, 9, false)                       /* event timestamp, sent after an event message */ \
+  PROFILECATCOMMAND
+
+
+//
+// the most messages any CAT command may reply with (checked in cathandler.cpp)
+// ZZZL; sends 12, and ZZZW; one per task and one for the whole tick, so this
+// leaves room for the task table to grow
+//
+#define VMAXCATREPLIES 16
+
+
+//
+// enumerated list of all of the CAT commands, eg eZZZD
+//
 enum ECATCommands
 {
-  eZZZD,                          // VFO steps down
-  eZZZU,                          // VFO steps up
-  eZZZE,                          // other encoder
-  eZZZP,                          // pushbutton
-  eZZZI,                          // indicator
-  eZZZS,                          // s/w version
-  eZZZX,
+#define X(Cmd, RXType, MinValue, MaxValue, NumParams, AlwaysSigned) e##Cmd,
+  CATCOMMANDLIST
+#undef X
   eNoCommand                      // this is an exception condition
 };
 
+#define VNUMCATCMDS ((int)eNoCommand)
+
 
 typedef enum
 {
@@ -43,10 +90,13 @@ typedef enum
 
 //
 // this struct holds a record to describe one CAT command
+// the table is const, so on the ATmega4809 it stays in flash (which is mapped
+// into the data address space, so it is read as normal without pgm_read)
 //
 struct SCATCommands
 {
-  char* CATString;                // eg "ZZAR"
+  const char* CATString;          // eg "ZZAR"
+  unsigned long MatchWord;        // the 4 characters as one 32 bit word, for a single compare
   ERXParamType RXType;            // type of parameter expected on receive
   long MinParamValue;             // eg "-999"
   long MaxParamValue;             // eg "9999"
@@ -56,7 +106,7 @@ struct SCATCommands
 
 
 
-extern SCATCommands GCATCommands[];
+extern const SCATCommands GCATCommands[];
 
 //
 // initialise CAT handler
@@ -64,6 +114,21 @@ extern SCATCommands GCATCommands[];
 void InitCAT(void);
 
 
+//
+// CAT link baud rate, as a code 0-5 (0 = 9600 default; see GCATBaudRates)
+// RequestCATBaudRate() replies to the host, then changes rate;
+// CATLinkTick() must be called each tick to make the change, and to fall back
+// to the default rate if the host does not confirm the new rate.
+// the change is made within VBAUDSETTLEMS of the last byte of the reply, so
+// the host must wait that long before sending at the new rate
+//
+#define VBAUDSETTLEMS 10
+
+void RequestCATBaudRate(byte Code);
+byte GetCATBaudCode(void);
+void CATLinkTick(void);
+
+
 //
 // ScanParseSerial()
 // scans input serial stream for characters; parses complete commands
@@ -74,27 +139,48 @@ void ScanParseSerial(void);
 
 
 //
-// ParseCATCmd()
-// Parse a single command in the local input buffer
-// process it if it is a valid command
+// ParseCATChar()
+// process one received character; complete commands are executed
+//
+void ParseCATChar(char Ch);
+
+
+//
+// abandon any partly received command
 //
-void ParseCATCmd(void);
+void ResetCATParser(void);
 
 //
 // create CAT message:
 // this creates a "basic" CAT command with no parameter
 // (for example to send a "get" command)
+// (queued: sent when the serial link has space)
 //
 void MakeCATMessageNoParam(ECATCommands Cmd);
 
 
 //
 // make a CAT command with a numeric parameter
+// (queued: sent when the serial link has space)
 //
 void MakeCATMessageNumeric(ECATCommands Cmd, long Param);
 
+
+//
+// format a CAT command with a numeric parameter into Msg, and return its length
+//
+byte FormatCATMessageNumeric(char* Msg, ECATCommands Cmd, long Param);
+
+
+//
+// format a CAT command with no parameter, or a bool parameter, into Msg, and return its length
+//
+byte FormatCATMessageNoParam(char* Msg, ECATCommands Cmd);
+byte FormatCATMessageBool(char* Msg, ECATCommands Cmd, bool Param);
+
 //
 // make a CAT command with a bool parameter
+// (queued: sent when the serial link has space)
 //
 void MakeCATMessageBool(ECATCommands Cmd, bool Param);
 
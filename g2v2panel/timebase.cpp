@@ -0,0 +1,146 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// timebase.cpp
+// this file holds the panel's clock: the 2ms tick count and a microsecond time,
+// from TCA0 and TCB0
+// the timer interrupt adds each timer period to a base count; a read adds the
+// TCB0 count since then. Reads save and restore the interrupt enable, so they
+// can be made from an interrupt handler or the main loop
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "globalinclude.h"
+#include "timebase.h"
+#include "encoders.h"
+
+
+static_assert(VTIMERCOUNTNS == 500, "TimebaseMicros() assumes 2 timer counts per microsecond");
+
+volatile unsigned long GTimebaseTicks;          // ticks since the timer was started
+volatile unsigned long GTimebaseMicros;         // microseconds at the last timer interrupt
+volatile byte GTimebaseHalfMicro;               // and the half microsecond left over
+volatile unsigned int GTimerCountBase;          // TCB0 counts at the last timer interrupt
+
+
+//
+// counter clocked by CK/8 (0.5us)
+// note this is faster than I've used in other sketches because timer 8 set to run 8x faster
+// the interrupt is VINPUTSAMPLESPERTICK times per tick, to sample the direct wired encoders
+//
+void InitTimebase(void)
+{
+  int Count;
+
+  GTimebaseTicks = 0;
+  GTimebaseMicros = 0;
+  GTimebaseHalfMicro = 0;
+  GTimerCountBase = 0;
+  Count = VTICKMICROS * (1000 / VTIMERCOUNTNS) / VINPUTSAMPLESPERTICK;
+  TCB0.CTRLB = TCB_CNTMODE_INT_gc; // Use timer compare mode
+  TCB0.CCMP = Count - 1; // Value to compare with: the period is CCMP + 1 counts of 0.5us, so 1000 counts = 500us
+  TCB0.INTCTRL = TCB_CAPT_bm; // Enable the interrupt
+  TCB0.CTRLA = TCB_CLKSEL_CLKTCA_gc | TCB_ENABLE_bm; // Use Timer A as clock, enable timer
+
+  // setup timer A for 8x faster than normal clock, so we get 8KHz PRF
+  // this will cause ny use of delay() millis() etc to be wrong
+  TCA0.SINGLE.CTRLA = (TCA_SINGLE_CLKSEL_DIV8_gc) | (TCA_SINGLE_ENABLE_bm);
+}
+
+
+//
+// timer interrupt: add one timer period to the base counts, and a tick if due
+// the interrupt flag is cleared here, so reads made later in the same
+// interrupt don't add the period again
+//
+void TimebaseInterrupt(bool TickDue)
+{
+  unsigned int Period;
+
+  Period = TCB0.CCMP + 1;
+  GTimerCountBase += Period;
+  Period += GTimebaseHalfMicro;
+  GTimebaseMicros += Period >> 1;
+  GTimebaseHalfMicro = Period & 1;
+  if (TickDue)
+    GTimebaseTicks++;
+  TCB0.INTFLAGS = TCB_CAPT_bm;
+}
+
+
+//
+// ticks since the timer was started
+//
+unsigned long TimebaseTicks(void)
+{
+  unsigned long Ticks;
+  byte OldSREG;
+
+  OldSREG = SREG;
+  cli();
+  Ticks = GTimebaseTicks;
+  SREG = OldSREG;
+  return Ticks;
+}
+
+
+//
+// microseconds since the timer was started
+// if the timer has wrapped but its interrupt hasn't run yet, the period is added here
+//
+unsigned long TimebaseMicros(void)
+{
+  unsigned long Micros;
+  unsigned int Count;
+  byte Half, Flags, OldSREG;
+
+  OldSREG = SREG;
+  cli();
+  Micros = GTimebaseMicros;
+  Half = GTimebaseHalfMicro;
+  Count = TCB0.CNT;
+  Flags = TCB0.INTFLAGS;
+  SREG = OldSREG;
+  if ((Flags & TCB_CAPT_bm) && (Count < TCB0.CCMP / 2))
+    Count += TCB0.CCMP + 1;
+  return Micros + ((Count + Half) >> 1);
+}
+
+
+//
+// the tick count at a recent TimebaseMicros() time: the tick count now, less
+// the whole ticks since then
+//
+unsigned long TimebaseTicksAt(unsigned long Micros)
+{
+  unsigned long Ticks;
+
+  Ticks = TimebaseTicks();
+  return Ticks - (TimebaseMicros() - Micros) / VTICKMICROS;
+}
+
+
+//
+// free running TCB0 count (0.5us per count, wraps every 32ms)
+// if the timer has wrapped but its interrupt hasn't run yet, the period is added here
+//
+unsigned int TimerCounts(void)
+{
+  unsigned int Base, Count;
+  byte Flags, OldSREG;
+
+  OldSREG = SREG;
+  cli();
+  Base = GTimerCountBase;
+  Count = TCB0.CNT;
+  Flags = TCB0.INTFLAGS;
+  SREG = OldSREG;
+  if ((Flags & TCB_CAPT_bm) && (Count < TCB0.CCMP / 2))
+    Base += TCB0.CCMP + 1;
+  return Base + Count;
+}
@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// timebase.h
+// this file holds the panel's clock: the 2ms tick count and a microsecond time,
+// from TCA0 and TCB0
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __TIMEBASE_H
+#define __TIMEBASE_H
+#include <Arduino.h>
+
+
+//
+// TCA0 is run 8x faster than normal (2MHz), which breaks delay() and millis();
+// it clocks TCB0, whose interrupt runs VINPUTSAMPLESPERTICK times per 2ms tick.
+// all panel timing should use the functions here instead
+//
+#define VTIMERCOUNTNS 500                       // timer count period (ns)
+#define VTICKMICROS 2000                        // tick period (us)
+
+
+//
+// the timebase, kept by the timer interrupt
+//
+extern volatile unsigned long GTimebaseTicks;   // ticks since the timer was started
+
+
+//
+// set up TCA0 and TCB0, and start the timer interrupt
+// the tick count and time start from 0
+//
+void InitTimebase(void);
+
+
+//
+// called from the timer interrupt: move the time on by one timer period,
+// and the tick count on if this interrupt completes a tick
+//
+void TimebaseInterrupt(bool TickDue);
+
+
+//
+// ticks since the timer was started (wraps after 99 days)
+// safe to call from interrupts and the main loop
+//
+unsigned long TimebaseTicks(void);
+
+
+//
+// microseconds since the timer was started (wraps after 71 minutes)
+// safe to call from interrupts and the main loop
+//
+unsigned long TimebaseMicros(void);
+
+
+//
+// the tick count at a recent TimebaseMicros() time (to within a tick)
+// for times up to 71 minutes ago
+//
+unsigned long TimebaseTicksAt(unsigned long Micros);
+
+
+//
+// free running TCB0 count (0.5us per count, wraps every 32ms)
+// for timing short sections of code: subtract a start count
+// safe to call from interrupts and the main loop
+//
+unsigned int TimerCounts(void);
+
+
+#endif //not defined
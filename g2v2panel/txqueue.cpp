@@ -0,0 +1,518 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// txqueue.cpp
+// outgoing CAT event queue
+//
+// the queue is a ring of events. VFO steps are held as an eZZZU event
+// and encoder clicks as an eZZZE event, each with a signed count; any
+// other command is held with its parameter (or none, or a bool) and sent
+// unchanged. A string message is held already formatted, in a single slot.
+// each event's format is set when it is queued, so a change of frame
+// mode (ZZZF) only applies to events queued after the reply to it.
+// every CAT message the panel sends goes through the queue, so they leave
+// in the order they were made.
+// new steps for a control that already has an event waiting are added
+// to it, so there is never more than one waiting event per control and
+// a long wait for the serial link just makes the messages bigger.
+// a step event bigger than one message can carry is sent in several
+// messages, the head event staying in the queue until it is all sent.
+// the last VTXSTEPCONTROLS places are kept for step events, so steps are
+// never lost, and the VTXBUTTONEVENTS before them for button events, one
+// per key state change, so a flood of replies can't push out a key press.
+// replies only use the rest: the CAT parser stops taking commands while
+// there isn't space for the longest reply (see TXReplySpace()), so replies
+// are paced by the serial link rather than lost. If the queue is full
+// anyway, a message is dropped and counted rather than waiting for the link.
+// for a baud rate change the queue can be held once the reply has been sent
+// (see HoldTXQueue()); events queued after it wait for the new rate.
+// every event holds the TimebaseMicros() time its input was detected (a
+// merged step event keeps the time of its first steps). If timestamps were
+// on when it was queued, its ZZZC message is formatted on the end of its
+// message, so the two are sent together.
+/////////////////////////////////////////////////////////////////////////
+
+#include "globalinclude.h"
+#include "txqueue.h"
+#include "catframe.h"
+#include "catformat.h"
+#include "timebase.h"
+
+
+#define VTXQUEUESIZE 40
+#define VTXSTEPCONTROLS (VMAXENCODERS + 3)      // VFO, encoders and 2 shifted encoders: one step event each
+#define VTXBUTTONEVENTS 8                       // key state changes that can wait for the link
+#define VTXREPLYEVENTS (VTXQUEUESIZE - VTXSTEPCONTROLS - VTXBUTTONEVENTS)
+#define VTXSTRINGSIZE 20                        // longest string message
+static_assert(VTXREPLYEVENTS >= VMAXCATREPLIES, "no TX queue space for the longest CAT reply");
+#define VMAXVFOMSGSTEPS 99                      // max steps in one ZZZU/ZZZD message
+#define VMAXENCODERMSGCLICKS 9                  // max clicks in one ZZZE message
+#define VTIMESTAMPMODULUS 1000000000UL          // ZZZC carries 9 digits
+
+
+//
+// how an event's message is formatted
+//
+enum ETXFormat
+{
+  eTXNumeric,                                   // numeric parameter, or step count
+  eTXNoParam,                                   // no parameter
+  eTXBool,                                      // bool parameter
+  eTXString,                                    // preformatted message in GTXString
+  eTXFrame                                      // binary frame (queued in frame mode)
+};
+
+struct STXEvent
+{
+  byte Cmd;                                     // ECATCommands value
+  byte Format;                                  // ETXFormat
+  byte Timestamp;                               // ETimestampMode when queued
+  byte Control;                                 // encoder number for eZZZE
+  long Param;                                   // parameter, or signed step count
+  unsigned long Time;                           // TimebaseMicros() when detected; 0 if not an input event
+};
+
+STXEvent GTXQueue[VTXQUEUESIZE];
+byte GTXQueueHead;                              // next event to send
+byte GTXQueueCount;                             // number of events queued
+
+char GTXMessage[40];                            // message being sent, and its timestamp
+bool GTXFrameMode;                              // true if events are queued as binary frames
+bool GTXMessageIsFrame;                         // true if GTXMessage holds a binary frame
+byte GTXFrameSeq;                               // sequence number for the next frame
+byte GTXTimestampMode;                          // ETimestampMode
+char GTXString[VTXSTRINGSIZE + 1];              // queued string message
+bool GTXStringQueued;                           // true if GTXString is in use
+bool GTXHoldPending;                            // hold once GTXHoldCount more events are sent
+byte GTXHoldCount;                              // events still to send before the hold
+
+byte GTXQueueHighWater;                         // max number of events ever queued
+unsigned long GTXQueueMerges;                   // steps merged into an already queued event
+unsigned long GTXQueueDrops;                    // messages dropped because the queue was full
+
+
+//
+// initialise: empty the queue
+//
+void InitTXQueue(void)
+{
+  GTXQueueHead = 0;
+  GTXQueueCount = 0;
+  GTXFrameMode = false;
+  GTXFrameSeq = 0;
+  GTXTimestampMode = eTimestampOff;
+  GTXStringQueued = false;
+  GTXHoldPending = false;
+}
+
+
+//
+// select binary frames or ASCII messages for VFO, encoder and button events
+//
+void SetTXFrameMode(bool FrameMode)
+{
+  GTXFrameMode = FrameMode;
+}
+
+
+bool GetTXFrameMode(void)
+{
+  return GTXFrameMode;
+}
+
+
+//
+// select event timestamps: ETimestampMode
+//
+void SetTXTimestampMode(byte Mode)
+{
+  GTXTimestampMode = Mode;
+}
+
+
+byte GetTXTimestampMode(void)
+{
+  return GTXTimestampMode;
+}
+
+
+//
+// true if a command is an event that can carry a timestamp
+//
+bool IsTimestampedEvent(byte Cmd)
+{
+  return (Cmd == eZZZU) || (Cmd == eZZZE) || (Cmd == eZZZP);
+}
+
+
+//
+// the timestamp to send for an event, in the units it was queued with
+//
+unsigned long EventTimestamp(STXEvent* Event)
+{
+  if (Event->Timestamp == eTimestampTicks)
+    return TimebaseTicksAt(Event->Time);
+  return Event->Time;
+}
+
+
+//
+// true if a command is an event that is sent as a binary frame in frame mode
+//
+bool IsFrameEvent(byte Cmd)
+{
+  return (Cmd == eZZZU) || (Cmd == eZZZE) || (Cmd == eZZZP);
+}
+
+
+//
+// the format to queue a numeric event in: a binary frame if in frame mode
+//
+byte NumericEventFormat(byte Cmd)
+{
+  if (GTXFrameMode && IsFrameEvent(Cmd))
+    return eTXFrame;
+  return eTXNumeric;
+}
+
+
+//
+// true if a command is a VFO or encoder step event
+//
+bool IsStepEvent(byte Cmd)
+{
+  return (Cmd == eZZZU) || (Cmd == eZZZE);
+}
+
+
+//
+// the number of queue places an event can use: all of them for a step event,
+// all but the step places for a button event, and the rest for replies
+//
+byte EventLimit(byte Cmd)
+{
+  if (IsStepEvent(Cmd))
+    return VTXQUEUESIZE;
+  if (Cmd == eZZZP)
+    return VTXQUEUESIZE - VTXSTEPCONTROLS;
+  return VTXREPLYEVENTS;
+}
+
+
+//
+// format the event at the head of the queue as a binary frame
+// returns the number of steps it carries
+//
+int FormatHeadFrame(STXEvent* Event, byte* Length)
+{
+  int Steps = 0;
+
+  *Length = VCATFRAMESIZE;
+  switch(Event->Cmd)
+  {
+    case eZZZU:                                 // VFO steps
+      Steps = constrain(Event->Param, -VMAXFRAMEVFOSTEPS, VMAXFRAMEVFOSTEPS);
+      MakeCATFrame((byte*)GTXMessage, eFrameVFO, GTXFrameSeq, 0, Steps);
+      break;
+
+    case eZZZE:                                 // encoder clicks
+      Steps = constrain(Event->Param, -VMAXFRAMECLICKS, VMAXFRAMECLICKS);
+      MakeCATFrame((byte*)GTXMessage, eFrameEncoder, GTXFrameSeq, Event->Control, Steps);
+      break;
+
+    case eZZZP:                                 // button: param = button*10 + state
+      MakeCATFrame((byte*)GTXMessage, eFrameButton, GTXFrameSeq, Event->Param / 10, Event->Param % 10);
+      break;
+  }
+  return Steps;
+}
+
+
+//
+// format the message for the event at the head of the queue into GTXMessage
+// in frame mode, VFO, encoder and button events are binary frames
+// returns the number of steps it carries, for step events
+//
+int FormatHeadEvent(STXEvent* Event, byte* Length)
+{
+  int Steps = 0;
+  long Param;
+
+  GTXMessageIsFrame = (Event->Format == eTXFrame);
+  if (GTXMessageIsFrame)
+    return FormatHeadFrame(Event, Length);
+  switch(Event->Cmd)
+  {
+    case eZZZU:                                 // VFO steps
+      Steps = constrain(Event->Param, -VMAXVFOMSGSTEPS, VMAXVFOMSGSTEPS);
+      if (Steps < 0)
+        *Length = FormatCATNumeric<eZZZD>(GTXMessage, -Steps);
+      else
+        *Length = FormatCATNumeric<eZZZU>(GTXMessage, Steps);
+      break;
+
+    case eZZZE:                                 // encoder clicks
+      Steps = constrain(Event->Param, -VMAXENCODERMSGCLICKS, VMAXENCODERMSGCLICKS);
+      if (Steps < 0)
+        Param = (Event->Control + 51) * 10 - Steps;
+      else
+        Param = (Event->Control + 1) * 10 + Steps;
+      *Length = FormatCATNumeric<eZZZE>(GTXMessage, Param);
+      break;
+
+    default:
+      if (Event->Format == eTXNoParam)
+        *Length = FormatCATMessageNoParam(GTXMessage, (ECATCommands)Event->Cmd);
+      else if (Event->Format == eTXBool)
+        *Length = FormatCATMessageBool(GTXMessage, (ECATCommands)Event->Cmd, Event->Param != 0);
+      else if (Event->Format == eTXString)
+      {
+        strcpy(GTXMessage, GTXString);
+        *Length = strlen(GTXMessage);
+      }
+      else
+        *Length = FormatCATMessageNumeric(GTXMessage, (ECATCommands)Event->Cmd, Event->Param);
+      break;
+  }
+  if (Event->Timestamp != eTimestampOff)
+    *Length += FormatCATNumeric<eZZZC>(GTXMessage + *Length, EventTimestamp(Event) % VTIMESTAMPMODULUS);
+  return Steps;
+}
+
+
+//
+// send the message for the event at the head of the queue, and remove it
+// if it has all been sent.
+// only sends if the serial TX buffer has space for all of it
+// returns true if a message was sent
+//
+bool SendHeadEvent(void)
+{
+  STXEvent* Event;
+  int Steps;
+  byte Length;
+
+  Event = GTXQueue + GTXQueueHead;
+  Steps = 0;
+  if ((Event->Param != 0) || !IsStepEvent(Event->Cmd))
+  {
+    Steps = FormatHeadEvent(Event, &Length);
+    if (CATSERIAL.availableForWrite() < Length)
+      return false;
+    CATSERIAL.write((const uint8_t*)GTXMessage, Length);     // a frame can hold zero bytes
+    if (GTXMessageIsFrame)
+      GTXFrameSeq++;
+  }
+  Event->Param -= Steps;
+  if ((Steps == 0) || (Event->Param == 0))            // all sent
+  {
+    if (Event->Format == eTXString)
+      GTXStringQueued = false;
+    if (++GTXQueueHead == VTXQUEUESIZE)
+      GTXQueueHead = 0;
+    GTXQueueCount--;
+    if (GTXHoldPending && (GTXHoldCount != 0))
+      GTXHoldCount--;
+  }
+  return true;
+}
+
+
+//
+// add an event to the tail of the queue
+// if the queue is full up to the event's limit (see EventLimit()) the event is dropped
+// Time is when an input event was detected (TimebaseMicros()), else 0
+// returns true if the event was queued
+//
+bool AddEvent(byte Cmd, byte Format, byte Control, long Param, unsigned long Time)
+{
+  STXEvent* Event;
+  byte Tail;
+
+  if (GTXQueueCount >= EventLimit(Cmd))
+  {
+    GTXQueueDrops++;
+    return false;
+  }
+  Tail = GTXQueueHead + GTXQueueCount;
+  if (Tail >= VTXQUEUESIZE)
+    Tail -= VTXQUEUESIZE;
+  Event = GTXQueue + Tail;
+  Event->Cmd = Cmd;
+  Event->Format = Format;
+  Event->Control = Control;
+  Event->Param = Param;
+  Event->Time = Time;
+  Event->Timestamp = IsTimestampedEvent(Cmd) ? GTXTimestampMode : (byte)eTimestampOff;
+  if (++GTXQueueCount > GTXQueueHighWater)
+    GTXQueueHighWater = GTXQueueCount;
+  return true;
+}
+
+
+//
+// add steps to an existing event for the same control if there is one,
+// else queue a new one
+//
+void AddStepEvent(byte Cmd, byte Control, int Steps, unsigned long Time)
+{
+  STXEvent* Event;
+  byte Posn, Cntr;
+  byte Format;
+
+  Format = NumericEventFormat(Cmd);
+  Posn = GTXQueueHead;
+  for (Cntr = 0; Cntr < GTXQueueCount; Cntr++)
+  {
+    Event = GTXQueue + Posn;
+    if ((Event->Cmd == Cmd) && (Event->Control == Control) && (Event->Format == Format)
+        && (Event->Timestamp == GTXTimestampMode))
+    {
+      Event->Param += Steps;
+      GTXQueueMerges++;
+      return;
+    }
+    if (++Posn == VTXQUEUESIZE)
+      Posn = 0;
+  }
+  AddEvent(Cmd, Format, Control, Steps, Time);
+}
+
+
+//
+// queue a CAT message with a numeric parameter
+//
+void QueueCATMessage(ECATCommands Cmd, long Param)
+{
+  AddEvent(Cmd, NumericEventFormat(Cmd), 0, Param, 0);
+}
+
+
+//
+// queue an input event message, detected at time Time (TimebaseMicros())
+//
+void QueueCATEvent(ECATCommands Cmd, long Param, unsigned long Time)
+{
+  AddEvent(Cmd, NumericEventFormat(Cmd), 0, Param, Time);
+}
+
+
+//
+// queue a CAT message with no parameter
+//
+void QueueCATMessageNoParam(ECATCommands Cmd)
+{
+  AddEvent(Cmd, eTXNoParam, 0, 0, 0);
+}
+
+
+//
+// queue a CAT message with a bool parameter
+//
+void QueueCATMessageBool(ECATCommands Cmd, bool Param)
+{
+  AddEvent(Cmd, eTXBool, 0, Param ? 1 : 0, 0);
+}
+
+
+//
+// queue a formatted string message. There is one place for a string
+// message: if it is in use, the new message is dropped
+//
+void QueueCATString(ECATCommands Cmd, const char* Msg)
+{
+  if (GTXStringQueued)
+  {
+    GTXQueueDrops++;
+    return;
+  }
+  strncpy(GTXString, Msg, VTXSTRINGSIZE);
+  GTXString[VTXSTRINGSIZE] = 0;
+  GTXStringQueued = AddEvent(Cmd, eTXString, 0, 0, 0);
+}
+
+
+//
+// queue VFO steps (+ve = up, -ve = down), the first detected at time Time
+//
+void QueueVFOSteps(int Steps, unsigned long Time)
+{
+  if (Steps != 0)
+    AddStepEvent(eZZZU, 0, Steps, Time);
+}
+
+
+//
+// queue encoder clicks (+ve = clockwise), detected at time Time. Encoder = 0..N-1
+//
+void QueueEncoderClicks(byte Encoder, int Clicks, unsigned long Time)
+{
+  if (Clicks != 0)
+    AddStepEvent(eZZZE, Encoder, Clicks, Time);
+}
+
+
+//
+// the number of reply messages there is space to queue
+// 0 while the string message place is in use
+//
+byte TXReplySpace(void)
+{
+  if (GTXStringQueued || (GTXQueueCount >= VTXREPLYEVENTS))
+    return 0;
+  return VTXREPLYEVENTS - GTXQueueCount;
+}
+
+
+//
+// hold the queue once the events queued so far have been sent
+// events queued after this wait until ReleaseTXQueue()
+//
+void HoldTXQueue(void)
+{
+  GTXHoldPending = true;
+  GTXHoldCount = GTXQueueCount;
+}
+
+
+//
+// true if the queue is held: everything queued before HoldTXQueue() has been sent
+//
+bool TXQueueHeld(void)
+{
+  return GTXHoldPending && (GTXHoldCount == 0);
+}
+
+
+//
+// start sending again after a hold
+//
+void ReleaseTXQueue(void)
+{
+  GTXHoldPending = false;
+}
+
+
+//
+// return true if there is nothing left in the queue
+//
+bool TXQueueEmpty(void)
+{
+  return (GTXQueueCount == 0);
+}
+
+
+//
+// send as many queued events as there is serial TX buffer space for
+//
+void TXQueueTick(void)
+{
+  while ((GTXQueueCount != 0) && !TXQueueHeld())
+    if (!SendHeadEvent())
+      break;
+}
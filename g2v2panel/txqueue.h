@@ -0,0 +1,132 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller sketch by Laurence Barker G8NJJ
+// this sketch provides a knob and switch interface through USB serial
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// the code is written for an Arduino Nano Every module
+//
+// txqueue.h
+// outgoing CAT event queue
+// every CAT message is queued, by the input and CAT handling code, and sent by
+// TXQueueTick() only as fast as the serial TX buffer has space, so the
+// 2ms tick never waits for the serial link. Places are kept for VFO and
+// encoder steps and for button events; replies to CAT commands are paced
+// by TXReplySpace(). If the queue is full anyway, a message is dropped (and counted).
+// VFO and encoder steps waiting to be sent are merged into one event per control
+// optionally each VFO, encoder and button message is followed by a ZZZC message
+// with the time its input was detected
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __TXQUEUE_H
+#define __TXQUEUE_H
+#include <Arduino.h>
+#include "tiger.h"
+
+
+//
+// queue statistics (readable with ZZZG)
+//
+extern byte GTXQueueHighWater;                  // max number of events ever queued
+extern unsigned long GTXQueueMerges;            // steps merged into an already queued event
+extern unsigned long GTXQueueDrops;             // messages dropped because the queue was full
+
+
+//
+// initialise: empty the queue
+//
+void InitTXQueue(void);
+
+
+//
+// select binary frames (see catframe.h) or ASCII messages for VFO, encoder and button events
+// replies to CAT commands are always ASCII. The mode applies to events
+// queued after it is set; events already queued keep their format
+//
+void SetTXFrameMode(bool FrameMode);
+bool GetTXFrameMode(void);
+
+
+//
+// event timestamps (ZZZT): when on, each ZZZU/ZZZD, ZZZE and ZZZP message is
+// followed by ZZZCnnnnnnnnn; with the time its input was detected (for merged
+// steps, the first of them; for a button, the first scan of the press or release
+// edge), modulo 10^9 (in ticks: 23 days; in us: 1000s). Nothing extra is sent when off.
+// like ZZZF, the mode applies to events queued after it is set.
+// binary frames (ZZZF) are not timestamped
+//
+enum ETimestampMode
+{
+  eTimestampOff,
+  eTimestampTicks,                              // timebase ticks (2ms)
+  eTimestampMicros                              // timebase microseconds
+};
+
+void SetTXTimestampMode(byte Mode);
+byte GetTXTimestampMode(void);
+
+
+//
+// queue a CAT message with a numeric parameter, no parameter or a bool parameter
+//
+void QueueCATMessage(ECATCommands Cmd, long Param);
+void QueueCATMessageNoParam(ECATCommands Cmd);
+void QueueCATMessageBool(ECATCommands Cmd, bool Param);
+
+
+//
+// queue an input event message (eg ZZZP), detected at time Time (TimebaseMicros())
+//
+void QueueCATEvent(ECATCommands Cmd, long Param, unsigned long Time);
+
+
+//
+// queue a formatted CAT string message (up to 20 characters)
+// only one string message can be queued at a time
+//
+void QueueCATString(ECATCommands Cmd, const char* Msg);
+
+
+//
+// queue VFO steps (+ve = up, -ve = down), the first detected at time Time (TimebaseMicros())
+//
+void QueueVFOSteps(int Steps, unsigned long Time);
+
+
+//
+// queue encoder clicks (+ve = clockwise), detected at time Time. Encoder = 0..N-1
+//
+void QueueEncoderClicks(byte Encoder, int Clicks, unsigned long Time);
+
+
+//
+// the number of reply messages there is space to queue
+// the CAT parser only takes a command when this is at least VMAXCATREPLIES
+//
+byte TXReplySpace(void);
+
+
+//
+// hold the queue once the events queued so far have been sent (eg the reply
+// to a baud rate change); events queued after it wait until it is released
+// TXQueueHeld() is true once everything before the hold has been sent
+//
+void HoldTXQueue(void);
+bool TXQueueHeld(void);
+void ReleaseTXQueue(void);
+
+
+//
+// return true if there is nothing left in the queue
+//
+bool TXQueueEmpty(void);
+
+
+//
+// send as many queued events as there is serial TX buffer space for
+// call every tick
+//
+void TXQueueTick(void);
+
+
+#endif // not defined
@@ -0,0 +1,268 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// Arduino.h
+// host replacement for the Arduino core header. Provides just enough of
+// the Arduino API and the ATmega4809 peripheral registers used by the
+// g2v2panel sketch to compile and run it on a Linux PC.
+// the "hardware" behind these calls is in simhardware.cpp
+/////////////////////////////////////////////////////////////////////////
+#ifndef __hostsim_arduino_h
+#define __hostsim_arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+
+//
+// pin numbers, as for the Nano Every
+//
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+#define VSIMNUMPINS 22
+
+
+//
+// digital I/O
+//
+void pinMode(uint8_t Pin, uint8_t Mode);
+void digitalWrite(uint8_t Pin, uint8_t Value);
+int digitalRead(uint8_t Pin);
+
+
+//
+// time: these run from the simulated clock, not the PC clock
+//
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long Milliseconds);
+void delayMicroseconds(unsigned int Microseconds);
+
+
+//
+// interrupt enable. Pending simulated interrupts are delivered
+// when interrupts are re-enabled
+//
+void noInterrupts(void);
+void interrupts(void);
+#define cli() noInterrupts()
+#define sei() interrupts()
+
+//
+// status register: only the global interrupt enable (bit 7) is modelled, so the
+// "save SREG, cli(), restore SREG" pattern works. It reads 0 in an interrupt handler
+//
+struct SSimSREG
+{
+  operator byte() const;
+  SSimSREG& operator=(byte Value);
+};
+extern SSimSREG SREG;
+
+//
+// interrupt handlers are ordinary functions that the simulator calls
+//
+#define ISR(vector) void vector(void)
+
+
+//
+// character classification and helpers
+//
+#define isLowerCase(c) (islower((unsigned char)(c)) != 0)
+#define isUpperCase(c) (isupper((unsigned char)(c)) != 0)
+#define isControl(c) (iscntrl((unsigned char)(c)) != 0)
+#define isDigit(c) (isdigit((unsigned char)(c)) != 0)
+#define constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+
+
+//
+// ATmega4809 peripheral registers used by the sketch
+// only the fields that are accessed are modelled
+//
+struct TCB_t
+{
+  volatile uint8_t CTRLA;
+  volatile uint8_t CTRLB;
+  volatile uint8_t INTCTRL;
+  volatile uint8_t INTFLAGS;
+  volatile uint16_t CNT;
+  volatile uint16_t CCMP;
+};
+
+struct TCA_SINGLE_t
+{
+  volatile uint8_t CTRLA;
+  volatile uint16_t CNT;
+  volatile uint16_t PER;
+};
+
+struct TCA_t
+{
+  TCA_SINGLE_t SINGLE;
+};
+
+struct PORT_t
+{
+  volatile uint8_t DIR;
+  volatile uint8_t OUT;
+  volatile uint8_t IN;
+  volatile uint8_t INTFLAGS;
+  volatile uint8_t PIN0CTRL;
+  volatile uint8_t PIN1CTRL;
+  volatile uint8_t PIN2CTRL;
+  volatile uint8_t PIN3CTRL;
+  volatile uint8_t PIN4CTRL;
+  volatile uint8_t PIN5CTRL;
+  volatile uint8_t PIN6CTRL;
+  volatile uint8_t PIN7CTRL;
+};
+
+//
+// registers with side effects are classes that call into the simulation:
+// a VPORT output write moves the pins (eg SPI chip selects, LEDs); an SPI0 DATA
+// write starts a byte transfer, and reading INTFLAGS while a byte is being
+// sent waits (advancing the simulated clock) for it to finish
+//
+class SimVPortOut
+{
+public:
+  SimVPortOut(uint8_t PortNumber) : Port(PortNumber), Value(0) {}
+  operator uint8_t() const { return Value; }
+  SimVPortOut& operator=(uint8_t NewValue) { return Write(NewValue, 0xFF); }
+  SimVPortOut& operator|=(uint8_t Bits) { return Write(Value | Bits, Bits); }      // single bit instructions:
+  SimVPortOut& operator&=(uint8_t Bits) { return Write(Value & Bits, ~Bits); }     // only those bits are written
+  SimVPortOut& Write(uint8_t NewValue, uint8_t Written);
+  uint8_t Port;                                 // 0 = A, 1 = B ...
+  uint8_t Value;
+};
+
+struct VPORT_t
+{
+  VPORT_t(uint8_t PortNumber) : OUT(PortNumber) {}
+  volatile uint8_t DIR;
+  SimVPortOut OUT;
+  volatile uint8_t IN;
+  volatile uint8_t INTFLAGS;
+};
+
+class SimSPIData
+{
+public:
+  operator uint8_t();
+  SimSPIData& operator=(uint8_t Value);
+};
+
+class SimSPIFlags
+{
+public:
+  operator uint8_t();
+  SimSPIFlags& operator=(uint8_t Value);
+};
+
+struct SPI_t
+{
+  volatile uint8_t CTRLA;
+  volatile uint8_t CTRLB;
+  volatile uint8_t INTCTRL;
+  SimSPIFlags INTFLAGS;
+  SimSPIData DATA;
+};
+
+extern TCB_t TCB0;
+extern TCA_t TCA0;
+extern PORT_t PORTA;
+extern VPORT_t VPORTA;
+extern VPORT_t VPORTB;
+extern VPORT_t VPORTC;
+extern VPORT_t VPORTD;
+extern VPORT_t VPORTE;
+extern VPORT_t VPORTF;
+extern SPI_t SPI0;
+
+#define TCB_ENABLE_bm 0x01
+#define TCB_CLKSEL_CLKDIV1_gc (0x00<<1)
+#define TCB_CLKSEL_CLKDIV2_gc (0x01<<1)
+#define TCB_CLKSEL_CLKTCA_gc (0x02<<1)
+#define TCB_CNTMODE_INT_gc (0x00<<0)
+#define TCB_CAPT_bm 0x01
+
+#define TCA_SINGLE_ENABLE_bm 0x01
+#define TCA_SINGLE_CLKSEL_DIV1_gc (0x00<<1)
+#define TCA_SINGLE_CLKSEL_DIV8_gc (0x03<<1)
+#define TCA_SINGLE_CLKSEL_DIV64_gc (0x05<<1)
+
+#define SPI_ENABLE_bm 0x01
+#define SPI_PRESC_gm 0x06
+#define SPI_PRESC_DIV4_gc (0x00<<1)
+#define SPI_PRESC_DIV16_gc (0x01<<1)
+#define SPI_PRESC_DIV64_gc (0x02<<1)
+#define SPI_PRESC_DIV128_gc (0x03<<1)
+#define SPI_CLK2X_bm 0x10
+#define SPI_MASTER_bm 0x20
+#define SPI_DORD_bm 0x40
+#define SPI_SSD_bm 0x04
+#define SPI_MODE_0_gc (0x00<<0)
+#define SPI_IE_bm 0x01
+#define SPI_IF_bm 0x80
+
+#define PORT_PULLUPEN_bm 0x08
+#define PORT_ISC_gm 0x07
+#define PORT_ISC_INTDISABLE_gc (0x00<<0)
+#define PORT_ISC_BOTHEDGES_gc (0x01<<0)
+
+
+
+//
+// serial port: received bytes arrive from the simulated host at the
+// programmed baud rate; transmitted bytes drain from a 64 byte buffer
+// at the same rate. A write to a full buffer blocks (advancing the
+// simulated clock) just as it does on the real UART.
+//
+#define SERIAL_TX_BUFFER_SIZE 64
+
+class HardwareSerial
+{
+public:
+  void begin(unsigned long Baud);
+  void end(void);
+  int available(void);
+  int read(void);
+  int peek(void);
+  int availableForWrite(void);
+  void flush(void);
+  size_t write(uint8_t Ch);
+  size_t write(const uint8_t* Buffer, size_t Size);
+  size_t print(const char* Str);
+  size_t println(const char* Str);
+  operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+
+#endif      // file sentry
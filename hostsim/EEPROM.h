@@ -0,0 +1,29 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// EEPROM.h
+// host replacement for the Arduino EEPROM library
+// 256 bytes, erased to 0xFF, as for the ATmega4809
+/////////////////////////////////////////////////////////////////////////
+#ifndef __hostsim_eeprom_h
+#define __hostsim_eeprom_h
+
+#include "Arduino.h"
+
+#define VSIMEEPROMSIZE 256
+
+
+class EEPROMClass
+{
+public:
+  uint8_t read(int Address);
+  void write(int Address, uint8_t Value);
+  void update(int Address, uint8_t Value);
+  uint16_t length(void) { return VSIMEEPROMSIZE; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif      // file sentry
@@ -0,0 +1,46 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// SPI.h
+// host replacement for the Arduino SPI library. Bytes are exchanged
+// with whichever simulated MCP23S17 has its chip select asserted.
+/////////////////////////////////////////////////////////////////////////
+#ifndef __hostsim_spi_h
+#define __hostsim_spi_h
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+
+class SPISettings
+{
+public:
+  SPISettings(uint32_t Clock = 4000000, uint8_t BitOrder = MSBFIRST, uint8_t DataMode = SPI_MODE0)
+    : ClockRate(Clock), Order(BitOrder), Mode(DataMode) {}
+  uint32_t ClockRate;
+  uint8_t Order;
+  uint8_t Mode;
+};
+
+
+class SPIClass
+{
+public:
+  void begin(void);
+  void end(void);
+  void beginTransaction(SPISettings Settings);
+  void endTransaction(void);
+  uint8_t transfer(uint8_t Data);
+};
+
+extern SPIClass SPI;
+
+#endif      // file sentry
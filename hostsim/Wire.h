@@ -0,0 +1,15 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// Wire.h
+// host replacement for the Arduino Wire library
+// the G2V2 panel no longer uses I2C, so nothing is needed here
+/////////////////////////////////////////////////////////////////////////
+#ifndef __hostsim_wire_h
+#define __hostsim_wire_h
+
+#include "Arduino.h"
+
+#endif      // file sentry
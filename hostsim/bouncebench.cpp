@@ -0,0 +1,190 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// bouncebench.cpp
+// compares the two button debounce policies (ZZZK): waiting for a stable
+// input, and eager (report on the first scan, then ignore the key).
+// a panel button is pressed and released many times with its contacts
+// bouncing for a random time on each change. In the "noisy" runs the input
+// also has single tick glitches (as from interference) while it is steady.
+// reports press and release latency percentiles (from the first contact
+// change to the report), and false triggers: presses or releases reported
+// more than once, or for a glitch; and presses missed.
+//
+// bouncebench [presses]
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "simhardware.h"
+
+
+#define VLEDTESTTICKS 1200                  // ticks for LED self test to complete
+#define VTICKMS 2                           // ms per tick
+#define VKEY 10                             // scan code of the button used (report code 23)
+#define VPRESSMSG "ZZZP231;"
+#define VRELEASEMSG "ZZZP230;"
+#define VMAXBOUNCETICKS 5                   // contacts bounce for up to 10ms
+#define VMINHOLDTICKS 25                    // button held 50-300ms
+#define VMAXHOLDTICKS 150
+#define VGLITCHCHANCE 100                   // noisy: 1 in this many steady ticks is inverted
+
+
+struct SBounceStats
+{
+  std::vector<int> PressLatency;           // ms from first contact to press report
+  std::vector<int> ReleaseLatency;         // ms from first release bounce to release report
+  unsigned long ExtraPresses;              // presses reported more than once per real press
+  unsigned long ExtraReleases;
+  unsigned long MissedPresses;             // real presses not reported
+  unsigned long MissedReleases;
+};
+
+
+//
+// count the messages in the panel output
+//
+int CountMessages(const std::string& Output, const char* Msg)
+{
+  size_t Pos = 0;
+  int Result = 0;
+
+  while ((Pos = Output.find(Msg, Pos)) != std::string::npos)
+  {
+    Result++;
+    Pos++;
+  }
+  return Result;
+}
+
+
+//
+// run one tick with the key in the given state; returns the messages reported
+// in a noisy run the state is sometimes inverted, unless it is bouncing
+//
+void RunTick(bool Pressed, bool Bouncing, bool Noisy, int* Presses, int* Releases)
+{
+  std::string Output;
+
+  if (Noisy && !Bouncing && (rand() % VGLITCHCHANCE == 0))
+    Pressed = !Pressed;
+  SimSetKey(VKEY, Pressed);
+  SimRunTicks(1);
+  Output = SimHostReceive();
+  *Presses += CountMessages(Output, VPRESSMSG);
+  *Releases += CountMessages(Output, VRELEASEMSG);
+}
+
+
+//
+// one contact change: bounce, then hold the new state
+// records the latency to the first report, and any extra or missed reports
+//
+void RunChange(bool Pressed, bool Noisy, std::vector<int>* Latency, unsigned long* Extra, unsigned long* Missed)
+{
+  int Presses = 0, Releases = 0;
+  int* Reports = Pressed ? &Presses : &Releases;
+  int* Others = Pressed ? &Releases : &Presses;
+  int BounceTicks = rand() % (VMAXBOUNCETICKS + 1);
+  int HoldTicks = VMINHOLDTICKS + rand() % (VMAXHOLDTICKS - VMINHOLDTICKS + 1);
+  int Tick, FirstReport = -1;
+
+  for (Tick = 0; Tick < BounceTicks + HoldTicks; Tick++)
+  {
+    if (Tick < BounceTicks)
+      RunTick((Tick == 0) ? Pressed : (rand() & 1), true, Noisy, &Presses, &Releases);
+    else
+      RunTick(Pressed, false, Noisy, &Presses, &Releases);
+    if ((*Reports > 0) && (FirstReport < 0))
+      FirstReport = Tick + 1;
+  }
+  if (FirstReport < 0)
+    (*Missed)++;
+  else
+  {
+    Latency->push_back(FirstReport * VTICKMS);
+    *Extra += *Reports - 1;
+  }
+  *Extra += *Others;                       // the opposite change reported: a glitch got through
+}
+
+
+//
+// press and release the button many times with one policy
+//
+void RunPolicy(bool Eager, bool Noisy, unsigned long Presses, SBounceStats* Stats)
+{
+  unsigned long Cntr;
+
+  SimEraseEEPROM();
+  SimPowerOn();
+  SimRunTicks(VLEDTESTTICKS);
+  SimSetHostBaudRate(0);
+  SimHostSend("ZZZB5;");                    // 1Mbaud, so reports aren't delayed by the link
+  SimRunTicks(20);
+  SimHostSend("ZZZB;");
+  SimHostSend(Eager ? "ZZZK11;" : "ZZZK10;");
+  SimRunTicks(20);
+  SimHostReceive();
+
+  srand(1);
+  *Stats = SBounceStats();
+  for (Cntr = 0; Cntr < Presses; Cntr++)
+  {
+    RunChange(true, Noisy, &Stats->PressLatency, &Stats->ExtraPresses, &Stats->MissedPresses);
+    RunChange(false, Noisy, &Stats->ReleaseLatency, &Stats->ExtraReleases, &Stats->MissedReleases);
+  }
+}
+
+
+//
+// latency percentile, in ms
+//
+int Percentile(std::vector<int>& Values, int Percent)
+{
+  if (Values.size() == 0)
+    return 0;
+  std::sort(Values.begin(), Values.end());
+  return Values[(Values.size() - 1) * Percent / 100];
+}
+
+
+void PrintStats(const char* Name, SBounceStats* Stats)
+{
+  printf("%-14s %4d %4d %4d %4d   %4d %4d %4d %4d   %7lu %7lu %7lu\n", Name,
+         Percentile(Stats->PressLatency, 50), Percentile(Stats->PressLatency, 90),
+         Percentile(Stats->PressLatency, 99), Percentile(Stats->PressLatency, 100),
+         Percentile(Stats->ReleaseLatency, 50), Percentile(Stats->ReleaseLatency, 90),
+         Percentile(Stats->ReleaseLatency, 99), Percentile(Stats->ReleaseLatency, 100),
+         Stats->ExtraPresses, Stats->ExtraReleases, Stats->MissedPresses + Stats->MissedReleases);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+  unsigned long Presses = 1000;
+  SBounceStats Stats;
+
+  if (argc > 1)
+    Presses = strtoul(argv[1], NULL, 0);
+
+  printf("%lu presses, contacts bounce 0-%dms on each change\n", Presses, VMAXBOUNCETICKS * VTICKMS);
+  printf("%-14s %-22s %-22s %-24s\n", "", "press latency ms", "release latency ms", "false triggers");
+  printf("%-14s %4s %4s %4s %4s   %4s %4s %4s %4s   %7s %7s %7s\n", "policy", "p50", "p90", "p99", "max",
+         "p50", "p90", "p99", "max", "presses", "release", "missed");
+  RunPolicy(false, false, Presses, &Stats);
+  PrintStats("stable", &Stats);
+  RunPolicy(true, false, Presses, &Stats);
+  PrintStats("eager", &Stats);
+  RunPolicy(false, true, Presses, &Stats);
+  PrintStats("stable, noisy", &Stats);
+  RunPolicy(true, true, Presses, &Stats);
+  PrintStats("eager, noisy", &Stats);
+  return 0;
+}
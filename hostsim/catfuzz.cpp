@@ -0,0 +1,456 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// catfuzz.cpp
+// tests the streaming CAT parser (ParseCATChar() in tiger.cpp)
+// 1. every line of the corpus files is sent to a freshly powered on panel,
+//    and the reply must be exactly as expected
+// 2. corpus lines are mutated (bytes changed, inserted, deleted, lines
+//    spliced) and sent back to back as fast as the link allows. The
+//    parser must never take more than its per tick byte limit, all
+//    replies must be well formed, and the panel must still answer after.
+// 3. single bytes are dropped from a stream of binary event frames: the
+//    frame decoder must lose only the damaged frame, and resync at once.
+// with -b, benchmarks the parser: PC time per byte, and per tick when
+// the host floods the link.
+//
+// catfuzz [-b] [-n iterations] [corpus files...]
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "simhardware.h"
+#include "simtest.h"
+#include "tiger.h"
+#include "catframe.h"
+#include "txqueue.h"
+
+
+#define VLEDTESTTICKS 1200                  // ticks for LED self test to complete
+#define VMAXCATBYTESPERTICK 32              // parser limit, as tiger.cpp
+#define VCORPUSTICKS 100                    // ticks to run each corpus line: 12 replies take 100ms at 9600 baud
+#define VDEFAULTCORPUS "catcorpus/parser.txt"
+
+struct SCorpusLine
+{
+  std::string Input;
+  std::string Expected;
+};
+
+std::vector<SCorpusLine> GCorpus;
+
+
+uint64_t HostNanoseconds(void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+
+//
+// decode \r \n \t \\ and \xNN escapes
+//
+std::string Unescape(const std::string& Str)
+{
+  std::string Result;
+  size_t Cntr;
+
+  for (Cntr = 0; Cntr < Str.size(); Cntr++)
+  {
+    if ((Str[Cntr] != '\\') || (Cntr + 1 == Str.size()))
+      Result += Str[Cntr];
+    else
+    {
+      switch (Str[++Cntr])
+      {
+        case 'r': Result += '\r'; break;
+        case 'n': Result += '\n'; break;
+        case 't': Result += '\t'; break;
+        case 'x':
+          Result += (char)strtoul(Str.substr(Cntr + 1, 2).c_str(), NULL, 16);
+          Cntr += 2;
+          break;
+        default: Result += Str[Cntr]; break;
+      }
+    }
+  }
+  return Result;
+}
+
+
+//
+// read a corpus file: "input => expected" per line; # starts a comment
+//
+bool ReadCorpus(const char* FileName)
+{
+  FILE* File;
+  char Line[512];
+  std::string Str;
+  size_t Arrow, End;
+  SCorpusLine Entry;
+
+  File = fopen(FileName, "r");
+  if (File == NULL)
+  {
+    printf("can't open corpus file %s\n", FileName);
+    return false;
+  }
+  while (fgets(Line, sizeof(Line), File))
+  {
+    Str = Line;
+    End = Str.find_last_not_of("\r\n");
+    Str = (End == std::string::npos) ? "" : Str.substr(0, End + 1);
+    if ((Str.size() == 0) || (Str[0] == '#'))
+      continue;
+    Arrow = Str.find(" =>");
+    if (Arrow == std::string::npos)
+      continue;
+    Entry.Input = Unescape(Str.substr(0, Arrow));
+    Entry.Expected = (Arrow + 4 <= Str.size()) ? Str.substr(Arrow + 4) : "";
+    GCorpus.push_back(Entry);
+  }
+  fclose(File);
+  return true;
+}
+
+
+//
+// power on from blank EEPROM, with the host following the panel's baud rate
+//
+void FreshPanel(void)
+{
+  SimEraseEEPROM();
+  SimPowerOn();
+  SimRunTicks(VLEDTESTTICKS);
+  SimHostReceive();
+}
+
+
+//
+// run ticks, checking the parser takes no more than its limit each tick
+// (a tick that waits for a full TX queue lets the next tick run in the same step)
+//
+std::string RunChecked(unsigned long Ticks, bool* Bounded)
+{
+  std::string Output;
+  unsigned long RXBytes, TicksFired;
+
+  while (Ticks--)
+  {
+    RXBytes = GSimStats.RXBytes;
+    TicksFired = GSimStats.TicksFired;
+    SimRunTicks(1);
+    TicksFired = GSimStats.TicksFired - TicksFired;
+    if (GSimStats.RXBytes - RXBytes > VMAXCATBYTESPERTICK * (TicksFired ? TicksFired : 1))
+      *Bounded = false;
+    Output += SimHostReceive();
+  }
+  return Output;
+}
+
+
+//
+// true if the panel output is all well formed: binary frames with good CRCs,
+// or ZZZ, a letter, an optional sign, digits then ;
+//
+bool WellFormed(const std::string& Output)
+{
+  SCATFrameDecoder Decoder;
+  SCATFrameEvent Event;
+  std::string Text;
+  size_t Pos, Cntr;
+
+  InitCATFrameDecoder(&Decoder);
+  for (Cntr = 0; Cntr < Output.size(); Cntr++)
+    switch (DecodeCATFrameByte(&Decoder, (byte)Output[Cntr], &Event))
+    {
+      case eDecodeText: Text += Output[Cntr]; break;
+      case eDecodeError: return false;
+      default: break;
+    }
+  if (Decoder.Count != 0)
+    return false;
+  Pos = 0;
+  while (Pos < Text.size())
+  {
+    if ((Text.compare(Pos, 3, "ZZZ") != 0) || (Pos + 4 >= Text.size()) || !isupper(Text[Pos + 3]))
+      return false;
+    Pos += 4;
+    if ((Text[Pos] == '+') || (Text[Pos] == '-'))
+      Pos++;
+    while ((Pos < Text.size()) && isdigit(Text[Pos]))
+      Pos++;
+    if ((Pos >= Text.size()) || (Text[Pos++] != ';'))
+      return false;
+  }
+  return true;
+}
+
+
+//
+// run every corpus line against a fresh panel
+//
+void RunCorpus(void)
+{
+  std::string Output;
+  bool Bounded = true;
+  size_t Line;
+
+  for (Line = 0; Line < GCorpus.size(); Line++)
+  {
+    FreshPanel();
+    SimHostSend(GCorpus[Line].Input.c_str());
+    Output = RunChecked(VCORPUSTICKS, &Bounded);
+    if (Output != GCorpus[Line].Expected)
+    {
+      printf("FAIL: corpus line %d: expected \"%s\" got \"%s\"\n", (int)Line + 1,
+             GCorpus[Line].Expected.c_str(), Output.c_str());
+      GFailCount++;
+    }
+  }
+  Check("corpus: parser byte limit per tick", Bounded);
+  printf("%d corpus lines run\n", (int)GCorpus.size());
+}
+
+
+//
+// make a mutated input from the corpus
+//
+std::string Mutate(void)
+{
+  std::string Str = GCorpus[rand() % GCorpus.size()].Input;
+  int Mutations = 1 + rand() % 4;
+  size_t Pos;
+
+  while (Mutations--)
+  {
+    Pos = Str.size() ? rand() % Str.size() : 0;
+    switch (rand() % 6)
+    {
+      case 0: if (Str.size()) Str[Pos] = (char)(rand() & 0xFF); break;        // change a byte
+      case 1: Str.insert(Pos, 1, (char)(rand() & 0xFF)); break;              // insert a byte
+      case 2: if (Str.size()) Str.erase(Pos, 1); break;                       // delete a byte
+      case 3: Str.insert(Pos, 1, "0123456789+-;"[rand() % 13]); break;        // insert a parser character
+      case 4: Str.insert(Pos, GCorpus[rand() % GCorpus.size()].Input); break; // splice
+      case 5: Str.insert(Pos, std::string(rand() % 40, '9')); break;           // long number
+    }
+  }
+  Str.erase(std::remove(Str.begin(), Str.end(), 0), Str.end());           // SimHostSend takes a C string
+  return Str;
+}
+
+
+//
+// send mutated corpus lines as fast as the link allows:
+// each batch is sent as soon as the previous one has arrived
+//
+void RunFuzz(unsigned long Iterations)
+{
+  std::string Output, Flood;
+  bool Bounded = true;
+  unsigned long Cntr;
+
+  FreshPanel();
+  srand(1);
+  for (Cntr = 0; Cntr < Iterations; Cntr++)
+  {
+    Flood.clear();
+    while (Flood.size() < 200)
+      Flood += Mutate();
+    SimHostSend(Flood.c_str());
+    while (SimHostSendPending() != 0)
+      Output += RunChecked(1, &Bounded);
+  }
+  Output += RunChecked(2000, &Bounded);                // let any baud rate change fall back
+  Check("fuzz: output well formed", WellFormed(Output));
+  SimHostSend("\n");                                   // abandon any part line
+  SimHostSend("ZZZS;");
+  Output = RunChecked(100, &Bounded);
+  Check("fuzz: parser byte limit per tick", Bounded);
+  Check("fuzz: panel still answers", Output.find("ZZZS0502009;") != std::string::npos);
+  printf("%lu fuzz iterations, %lu bytes received, %lu dropped by a full RX buffer\n",
+         Iterations, GSimStats.RXBytes, GSimStats.RXDropped);
+}
+
+
+//
+// drop each byte in turn from a stream of binary frames, and decode it
+// only the damaged frame should be lost; a false frame (bad bytes that
+// happen to pass the CRC) can cost one more
+//
+#define VRESYNCFRAMES 40                    // frames in each test stream
+#define VRESYNCTRIALS 50                    // test streams
+
+static bool SameEvent(const SCATFrameEvent& A, const SCATFrameEvent& B)
+{
+  return (A.Type == B.Type) && (A.Control == B.Control) && (A.Value == B.Value) && (A.Seq == B.Seq);
+}
+
+void RunFrameResync(void)
+{
+  std::vector<SCATFrameEvent> Sent, Decoded;
+  std::vector<byte> Stream;
+  SCATFrameDecoder Decoder;
+  SCATFrameEvent Event;
+  byte Frame[VCATFRAMESIZE];
+  unsigned long Trial, Cntr, Next, Drop, Matched, Pos;
+  unsigned long Runs = 0, Clean = 0, WorstLost = 0, False = 0, DamagedIndex;
+
+  srand(1);
+  for (Trial = 0; Trial < VRESYNCTRIALS; Trial++)
+  {
+    Sent.clear();
+    Stream.clear();
+    for (Cntr = 0; Cntr < VRESYNCFRAMES; Cntr++)
+    {
+      Event.Type = (ECATFrameType)(rand() % 3);
+      Event.Seq = Cntr & 0x0F;
+      switch (Event.Type)
+      {
+        case eFrameVFO:
+          Event.Control = 0;
+          Event.Value = rand() % (2 * VMAXFRAMEVFOSTEPS + 1) - VMAXFRAMEVFOSTEPS;
+          break;
+        case eFrameEncoder:
+          Event.Control = rand() % 10;
+          Event.Value = rand() % (2 * VMAXFRAMECLICKS + 1) - VMAXFRAMECLICKS;
+          break;
+        default:
+          Event.Control = rand() % (VMAXFRAMEBUTTON + 1);
+          Event.Value = rand() % 3;
+          break;
+      }
+      MakeCATFrame(Frame, Event.Type, Event.Seq, Event.Control, Event.Value);
+      Stream.insert(Stream.end(), Frame, Frame + VCATFRAMESIZE);
+      Sent.push_back(Event);
+    }
+
+    for (Drop = 0; Drop < Stream.size(); Drop++)
+    {
+      InitCATFrameDecoder(&Decoder);
+      Decoded.clear();
+      for (Pos = 0; Pos < Stream.size(); Pos++)
+        if ((Pos != Drop) && (DecodeCATFrameByte(&Decoder, Stream[Pos], &Event) == eDecodeEvent))
+          Decoded.push_back(Event);
+      // match the decoded events in order against those sent, less the damaged one
+      DamagedIndex = Drop / VCATFRAMESIZE;
+      Matched = 0;
+      Cntr = 0;
+      for (Pos = 0; Pos < Decoded.size(); Pos++)
+      {
+        Next = Cntr;
+        while ((Next < Sent.size()) && ((Next == DamagedIndex) || !SameEvent(Sent[Next], Decoded[Pos])))
+          Next++;
+        if (Next == Sent.size())
+          continue;                         // a false frame
+        Matched++;
+        Cntr = Next + 1;
+      }
+      Runs++;
+      False += Decoded.size() - Matched;
+      if ((Sent.size() - 1) - Matched > WorstLost)
+        WorstLost = (Sent.size() - 1) - Matched;
+      if ((Matched == Sent.size() - 1) && (Decoded.size() == Matched))
+        Clean++;
+    }
+  }
+  Check("frames: resync after a lost byte costs at most one more frame", WorstLost <= 1);
+  Check("frames: nearly every lost byte costs only its own frame", Clean * 100 >= Runs * 98);
+  printf("%lu streams with one byte dropped: %lu lost only the damaged frame, %lu false frames\n",
+         Runs, Clean, False);
+}
+
+
+//
+// benchmark: PC time per byte parsed, and per tick with the link flooded
+// the per byte test uses commands without replies, so it doesn't wait for the serial link
+//
+void RunBenchmark(void)
+{
+  const char* SetCommands = "ZZZI010;ZZZI011;zzzi050;ZZZI+051;ZZZQ123;ZZZI99999999999;ZZ;";
+  const char* Commands = "ZZZS;ZZZX;zzzv;ZZZG01;ZZZI010;ZZZX+012;ZZZQ123;ZZZX99999999999;";
+  unsigned long Cntr, Bytes = 0, Iterations = 200000;
+  uint64_t Start, Time, MaxTick = 0, TotalTick = 0;
+  unsigned long Ticks = 0;
+
+  FreshPanel();
+  Start = HostNanoseconds();
+  for (Cntr = 0; Cntr < Iterations; Cntr++)
+  {
+    const char* Ch;
+    for (Ch = SetCommands; *Ch; Ch++)
+      ParseCATChar(*Ch);
+    Bytes += strlen(SetCommands);
+  }
+  Time = HostNanoseconds() - Start;
+  printf("ParseCATChar: %.1f ns per byte (including command execution)\n", (double)Time / Bytes);
+
+  FreshPanel();
+  SimSetHostBaudRate(0);
+  SimHostSend("ZZZB5;");                              // 1Mbaud: 200 bytes arrive per tick
+  SimRunTicks(20);
+  SimHostSend("ZZZS;");
+  SimRunTicks(20);
+  for (Cntr = 0; Cntr < 2000; Cntr++)
+  {
+    SimHostSend(Commands);
+    SimAdvanceTime(2000 - (unsigned long)(SimGetMicros() % 2000));
+    Start = HostNanoseconds();
+    ScanParseSerial();
+    Time = HostNanoseconds() - Start;
+    TotalTick += Time;
+    if (Time > MaxTick)
+      MaxTick = Time;
+    Ticks++;
+    TXQueueTick();                                    // send the replies
+    SimHostReceive();
+  }
+  printf("ScanParseSerial with the link flooded at 1Mbaud: mean %.1f ns, max %.1f ns per tick\n",
+         (double)TotalTick / Ticks, (double)MaxTick);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+  int Arg;
+  bool Benchmark = false;
+  bool CorpusGiven = false;
+  unsigned long Iterations = 2000;
+
+  GQuietPasses = true;                      // thousands of checks: only print failures
+  for (Arg = 1; Arg < argc; Arg++)
+  {
+    if (strcmp(argv[Arg], "-b") == 0)
+      Benchmark = true;
+    else if ((strcmp(argv[Arg], "-n") == 0) && (Arg + 1 < argc))
+      Iterations = strtoul(argv[++Arg], NULL, 0);
+    else
+    {
+      if (!ReadCorpus(argv[Arg]))
+        return 2;
+      CorpusGiven = true;
+    }
+  }
+  if (!CorpusGiven && !ReadCorpus(VDEFAULTCORPUS))
+    return 2;
+
+  if (Benchmark)
+  {
+    RunBenchmark();
+    return 0;
+  }
+  RunCorpus();
+  RunFuzz(Iterations);
+  RunFrameResync();
+  return CheckSummary();
+}
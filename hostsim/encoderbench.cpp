@@ -0,0 +1,185 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// encoderbench.cpp
+// compares the bit sliced mechanical encoder decoder (encoderslice.cpp)
+// with the previous one NoClickEncoder2 object per encoder path.
+// both are fed the same input words; the reported movements must match.
+//
+// encoderbench [ticks]
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <time.h>
+#include "Arduino.h"
+#include "mechencoder2.h"
+#include "encoderslice.h"
+
+
+#define VNUMENCODERS 10
+#define VSTEPSPERNOTCH 2
+
+const byte EncoderPair[VNUMENCODERS] = {3, 2, 1, 0, 7, 6, 5, 4, 8, 9};
+const byte Quadrature[4] = {0b00, 0b10, 0b11, 0b01};
+
+NoClickEncoder2* EncoderList[VNUMENCODERS];
+
+
+uint64_t HostNanoseconds(void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+
+//
+// generate the input words for a run: each encoder random walks,
+// with movement on a proportion of ticks set by Activity (0-256)
+//
+void MakeInputs(unsigned int* MCPWords, byte* DirectWords, unsigned long Ticks, unsigned int Activity)
+{
+  int Position[VNUMENCODERS] = {0};
+  unsigned long Tick;
+  unsigned int Word;
+  byte Direct;
+  byte Cntr;
+
+  srand(1);
+  for (Tick = 0; Tick < Ticks; Tick++)
+  {
+    Word = 0;
+    Direct = 0;
+    for (Cntr = 0; Cntr < VNUMENCODERS; Cntr++)
+    {
+      if ((unsigned int)(rand() & 0xFF) < Activity)
+        Position[Cntr] += (rand() & 1) ? 1 : -1;
+      if (EncoderPair[Cntr] < 8)
+        Word |= Quadrature[Position[Cntr] & 3] << (EncoderPair[Cntr] * 2);
+      else
+        Direct |= Quadrature[Position[Cntr] & 3] << ((EncoderPair[Cntr] - 8) * 2);
+    }
+    MCPWords[Tick] = Word;
+    DirectWords[Tick] = Direct;
+  }
+}
+
+
+//
+// previous path: shift out 2 bits per encoder and service each object
+//
+long RunObjects(const unsigned int* MCPWords, const byte* DirectWords, unsigned long Ticks, uint64_t* Time)
+{
+  unsigned long Tick;
+  unsigned int Values;
+  byte Direct, Cntr;
+  long Checksum = 0;
+  uint64_t Start;
+
+  for (Cntr = 0; Cntr < VNUMENCODERS; Cntr++)
+  {
+    byte Pair = EncoderPair[Cntr];
+    byte State = (Pair < 8) ? (MCPWords[0] >> (Pair * 2)) & 3 : (DirectWords[0] >> ((Pair - 8) * 2)) & 3;
+    EncoderList[Cntr] = new NoClickEncoder2(VSTEPSPERNOTCH, State, true);
+  }
+
+  Start = HostNanoseconds();
+  for (Tick = 1; Tick < Ticks; Tick++)
+  {
+    Values = MCPWords[Tick];
+    Direct = DirectWords[Tick];
+    EncoderList[3]->service((byte)(Values & 0b11)); Values >>= 2;
+    EncoderList[2]->service((byte)(Values & 0b11)); Values >>= 2;
+    EncoderList[1]->service((byte)(Values & 0b11)); Values >>= 2;
+    EncoderList[0]->service((byte)(Values & 0b11)); Values >>= 2;
+    EncoderList[7]->service((byte)(Values & 0b11)); Values >>= 2;
+    EncoderList[6]->service((byte)(Values & 0b11)); Values >>= 2;
+    EncoderList[5]->service((byte)(Values & 0b11)); Values >>= 2;
+    EncoderList[4]->service((byte)(Values & 0b11));
+    EncoderList[8]->service(Direct & 0b11);
+    EncoderList[9]->service((Direct >> 2) & 0b11);
+    for (Cntr = 0; Cntr < VNUMENCODERS; Cntr++)
+    {
+      int16_t Movement = EncoderList[Cntr]->getValue();
+      if (Movement != 0)
+        Checksum = Checksum * 31 + (Cntr + 1) * Movement;
+    }
+  }
+  *Time = HostNanoseconds() - Start;
+
+  for (Cntr = 0; Cntr < VNUMENCODERS; Cntr++)
+    delete EncoderList[Cntr];
+  return Checksum;
+}
+
+
+//
+// new path: bit planes through the sliced decoder
+//
+long RunSliced(const unsigned int* MCPWords, const byte* DirectWords, unsigned long Ticks, uint64_t* Time)
+{
+  unsigned long Tick;
+  unsigned int APlane, BPlane, Active;
+  byte Cntr;
+  long Checksum = 0;
+  uint64_t Start;
+
+  MakeEncoderPlanes(MCPWords[0], DirectWords[0], &APlane, &BPlane);
+  InitSlicedEncoders(APlane, BPlane);
+
+  Start = HostNanoseconds();
+  for (Tick = 1; Tick < Ticks; Tick++)
+  {
+    MakeEncoderPlanes(MCPWords[Tick], DirectWords[Tick], &APlane, &BPlane);
+    Active = ServiceSlicedEncoders(APlane, BPlane);
+    if (Active)
+      for (Cntr = 0; Cntr < VNUMENCODERS; Cntr++)
+        if (Active & (1 << EncoderPair[Cntr]))
+        {
+          int16_t Movement = GetSlicedEncoderValue(EncoderPair[Cntr], VSTEPSPERNOTCH, false);
+          if (Movement != 0)
+            Checksum = Checksum * 31 + (Cntr + 1) * Movement;
+        }
+  }
+  *Time = HostNanoseconds() - Start;
+  return Checksum;
+}
+
+
+
+int main(int argc, char* argv[])
+{
+  unsigned long Ticks = 1000000;
+  const unsigned int Activity[3] = {0, 16, 128};
+  const char* ActivityName[3] = {"idle", "light use", "heavy use"};
+  unsigned int* MCPWords;
+  byte* DirectWords;
+  uint64_t ObjectTime, SlicedTime;
+  long ObjectSum, SlicedSum;
+  int Failed = 0;
+  int Run;
+
+  if (argc > 1)
+    Ticks = strtoul(argv[1], NULL, 0);
+  MCPWords = new unsigned int[Ticks];
+  DirectWords = new byte[Ticks];
+
+  printf("%lu ticks, 10 encoders, %d steps per notch\n", Ticks, VSTEPSPERNOTCH);
+  for (Run = 0; Run < 3; Run++)
+  {
+    MakeInputs(MCPWords, DirectWords, Ticks, Activity[Run]);
+    ObjectSum = RunObjects(MCPWords, DirectWords, Ticks, &ObjectTime);
+    SlicedSum = RunSliced(MCPWords, DirectWords, Ticks, &SlicedTime);
+    printf("%-10s objects %6.1f ns/tick   sliced %6.1f ns/tick   %s\n", ActivityName[Run],
+           (double)ObjectTime / Ticks, (double)SlicedTime / Ticks,
+           (ObjectSum == SlicedSum) ? "same reports" : "REPORTS DIFFER");
+    if (ObjectSum != SlicedSum)
+      Failed = 1;
+  }
+  delete[] MCPWords;
+  delete[] DirectWords;
+  return Failed;
+}
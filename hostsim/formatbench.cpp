@@ -0,0 +1,387 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// formatbench.cpp
+// compares the one pass numeric CAT formatter (catformat.h) with the
+// previous strcpy/strcat/divide formatter, copied below.
+// 1. checks both make identical messages for every CAT command, and for
+//    signed test fields, over a sweep of values including out of range ones
+// 2. times both on the PC
+// 3. estimates AVR cycles per message for both, by counting the operations
+//    each does and costing them (see the constants below). There is no AVR
+//    toolchain here, so this is an estimate, not a measurement.
+//
+// formatbench [iterations]
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "simhardware.h"
+#include "simtest.h"
+#include "tiger.h"
+#include "catformat.h"
+
+
+//
+// AVR (ATmega4809) cycle costs used for the estimate
+// __udivmodsi4 is the libgcc 32 bit divide: a 32 pass shift/subtract loop
+//
+#define VCYCLESDIV32 620                    // __udivmodsi4, typical
+#define VCYCLESMUL32 22                     // __mulsi3, with the hardware multiplier
+#define VCYCLESPERCHAR 5                    // strlen/strcpy/strcat, per character scanned
+#define VCYCLESCALL 8                       // call + return + set up of a library call
+#define VCYCLESLOOP32 12                    // compare, subtract and count loop, 32 bit
+#define VCYCLESLOOP16 8                     // compare, subtract and count loop, 16 bit
+#define VCYCLESDIGIT 10                     // load a power of ten, store a digit
+#define VCYCLESFIXED 40                     // clip, sign, header and terminator (both formatters)
+
+
+/////////////////////////////////////////////////////////////////////////
+//
+// previous formatter, as it was in tiger.cpp
+// (it took the command code; here it takes the table entry, so it can be
+// run on the signed test fields)
+//
+const long DivisorTable[] =
+{
+  0L,                                                    // not used
+  1L,                                                    // 1 digit - already have units
+  10L,                                                   // 2 digits - tens is first
+  100L,                                                  // 3 digits - hundreds is 1st
+  1000L,                                                 // 4 digits - thousands is 1st
+  10000L,                                                // 5 digits - ten thousands is 1st
+  100000L,                                               // 6 digits - hundred thousands
+  1000000L,                                              // millions
+  10000000L,                                             // 10 millions
+  100000000L,                                            // 100 millions
+  1000000000L,                                           // 1000 millions
+  10000000000L,                                          // 10000 millions
+  100000000000L,                                         // 100000 millions
+  1000000000000L,                                        // 1000000 millions
+  10000000000000L                                        // 10000000 millions
+};
+
+
+void Append(char* s, char ch)
+{
+  byte len;
+
+  len = strlen(s);
+  s[len++] = ch;
+  s[len] = 0;
+}
+
+
+byte LegacyFormatCATMessageNumeric(char* Msg, const SCATCommands* StructPtr, long Param)
+{
+  byte CharCount;                  // character count to add
+  unsigned long Divisor;           // initial divisor to convert to ascii
+  unsigned long Digit;             // decimal digit found
+  char ASCIIDigit;
+
+  strcpy(Msg, StructPtr->CATString);
+  CharCount = StructPtr->NumParams;
+//
+// clip the parameter to the allowed numeric range
+//
+  if (Param > StructPtr->MaxParamValue)
+    Param = StructPtr->MaxParamValue;
+  else if (Param < StructPtr->MinParamValue)
+    Param = StructPtr->MinParamValue;
+//
+// now add sign if needed
+//
+  if (StructPtr -> AlwaysSigned)
+  {
+    if (Param < 0)
+    {
+      strcat(Msg, "-");
+      Param = -Param;                   // make positive
+    }
+    else
+      strcat(Msg, "+");
+    CharCount--;
+  }
+  else if (Param < 0)                   // not always signed, but neg so it needs a sign
+  {
+      strcat(Msg, "-");
+      Param = -Param;
+      CharCount--;                      // make positive
+  }
+//
+// we now have a positive number to fit into <CharCount> digits
+// pad with zeros if needed
+//
+  Divisor = DivisorTable[CharCount];
+  while (Divisor > 1)
+  {
+    Digit = Param / Divisor;                  // get the digit for this decimal position
+    ASCIIDigit = (char)(Digit + '0');         // ASCII version - and output it
+    Append(Msg, ASCIIDigit);
+    Param = Param - (Digit * Divisor);        // get remainder
+    Divisor = Divisor / 10;                   // set for next digit
+  }
+  ASCIIDigit = (char)(Param + '0');           // ASCII version of units digit
+  Append(Msg, ASCIIDigit);
+  strcat(Msg, ";");
+  return strlen(Msg);
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//
+// test fields: the real command table, plus signed fields no command uses yet
+//
+const SCATCommands GSignedFields[] =
+{
+  {"ZZZY", 0, eNum, -999, 999, 4, true},
+  {"ZZZY", 0, eNum, -99, 99, 3, false},
+  {"ZZZY", 0, eNum, -9, 9, 1, false},
+  {"ZZZY", 0, eNum, -999999999, 999999999, 10, true},
+  {"ZZZY", 0, eNum, -99999999, 999999999, 9, false}
+};
+#define VNUMSIGNEDFIELDS (int)(sizeof(GSignedFields) / sizeof(GSignedFields[0]))
+
+std::vector<const SCATCommands*> GFields;
+std::vector<long> GValues;
+
+
+//
+// values to try for a field: everything near zero and the limits,
+// each power of ten and its neighbours, and a spread of random values
+//
+void MakeValues(const SCATCommands* Field)
+{
+  long Power, Cntr;
+
+  GValues.clear();
+  for (Cntr = -1100; Cntr <= 1100; Cntr++)
+  {
+    GValues.push_back(Cntr);
+    GValues.push_back(Field->MinParamValue + Cntr);
+    GValues.push_back(Field->MaxParamValue + Cntr);
+  }
+  for (Power = 10; Power <= 1000000000L; Power *= 10)
+    for (Cntr = -1; Cntr <= 1; Cntr++)
+    {
+      GValues.push_back(Power + Cntr);
+      GValues.push_back(-Power + Cntr);
+    }
+  srand(1);
+  for (Cntr = 0; Cntr < 20000; Cntr++)
+    GValues.push_back((long)(((unsigned long)rand() << 16) ^ rand()) % (Field->MaxParamValue + 1 - Field->MinParamValue)
+                      + Field->MinParamValue);
+  GValues.push_back(-2000000000L);
+  GValues.push_back(2000000000L);
+}
+
+
+//
+// check the new formatter matches the old for every field and value
+// the runtime wrapper is checked for real commands; FormatCATFields() for the rest
+//
+void CheckIdentical(void)
+{
+  char Old[40], New[40];
+  byte OldLength, NewLength;
+  size_t Field, Value;
+  unsigned long Compared = 0;
+
+  for (Field = 0; Field < GFields.size(); Field++)
+  {
+    MakeValues(GFields[Field]);
+    for (Value = 0; Value < GValues.size(); Value++)
+    {
+      const SCATCommands* Ptr = GFields[Field];
+      OldLength = LegacyFormatCATMessageNumeric(Old, Ptr, GValues[Value]);
+      if (Field < VNUMCATCMDS)
+        NewLength = FormatCATMessageNumeric(New, (ECATCommands)Field, GValues[Value]);
+      else
+        NewLength = FormatCATFields(New, Ptr->CATString[3], Ptr->NumParams, Ptr->MinParamValue,
+                                    Ptr->MaxParamValue, Ptr->AlwaysSigned, GValues[Value]);
+      if ((OldLength != NewLength) || (strcmp(Old, New) != 0))
+      {
+        if (GFailCount++ < 10)
+          printf("FAIL: field %d value %ld: old \"%s\" new \"%s\"\n", (int)Field, GValues[Value], Old, New);
+      }
+      Compared++;
+    }
+  }
+  printf("%lu messages compared over %d fields\n", Compared, (int)GFields.size());
+}
+
+
+//
+// the compile time formatters must match the runtime one
+//
+template <ECATCommands Cmd>
+void CheckTemplate(void)
+{
+  char Msg1[40], Msg2[40];
+  long Value;
+
+  for (Value = -100; Value <= 10000000L; Value += (Value < 2000) ? 1 : 997)
+  {
+    FormatCATNumeric<Cmd>(Msg1, Value);
+    FormatCATMessageNumeric(Msg2, Cmd, Value);
+    if (strcmp(Msg1, Msg2) != 0)
+    {
+      printf("FAIL: FormatCATNumeric<%s> value %ld: \"%s\" not \"%s\"\n", GCATCommands[Cmd].CATString, Value, Msg1, Msg2);
+      GFailCount++;
+      return;
+    }
+  }
+}
+
+
+uint64_t HostNanoseconds(void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+
+//
+// PC time per message for one command, over in range values
+//
+void TimeCommand(ECATCommands Cmd, unsigned long Iterations)
+{
+  char Msg[40];
+  const SCATCommands* Ptr = GCATCommands + Cmd;
+  unsigned long Cntr;
+  unsigned long Range = Ptr->MaxParamValue + 1 - Ptr->MinParamValue;
+  uint64_t Start, OldTime, NewTime;
+  volatile byte Sink = 0;
+
+  Start = HostNanoseconds();
+  for (Cntr = 0; Cntr < Iterations; Cntr++)
+    Sink += LegacyFormatCATMessageNumeric(Msg, Ptr, Ptr->MinParamValue + (Cntr * 7919) % Range);
+  OldTime = HostNanoseconds() - Start;
+  Start = HostNanoseconds();
+  for (Cntr = 0; Cntr < Iterations; Cntr++)
+    Sink += FormatCATMessageNumeric(Msg, Cmd, Ptr->MinParamValue + (Cntr * 7919) % Range);
+  NewTime = HostNanoseconds() - Start;
+  printf("  %s (%d digits): old %6.1f ns  new %6.1f ns  (%.1fx)\n", Ptr->CATString, Ptr->NumParams,
+         (double)OldTime / Iterations, (double)NewTime / Iterations, (double)OldTime / NewTime);
+}
+
+
+//
+// estimated AVR cycles to format one message
+// the old formatter divides twice and multiplies once per digit, and
+// rescans the message with strlen() for each character added
+// the new one loops once per unit of each digit's value
+//
+unsigned long LegacyCycles(const SCATCommands* Ptr, const char* Msg)
+{
+  unsigned long Cycles = VCYCLESFIXED;
+  byte Digits = strlen(Msg) - 5;              // ZZZx and ;
+  byte Length = 4;
+  byte Cntr;
+
+  Cycles += VCYCLESCALL + 5 * VCYCLESPERCHAR;           // strcpy
+  if ((Msg[4] == '+') || (Msg[4] == '-'))
+  {
+    Cycles += VCYCLESCALL + ++Length * VCYCLESPERCHAR;   // strcat sign
+    Digits--;
+  }
+  for (Cntr = 0; Cntr < Digits; Cntr++)
+  {
+    if (Cntr < Digits - 1)
+      Cycles += 2 * (VCYCLESCALL + VCYCLESDIV32) + VCYCLESCALL + VCYCLESMUL32;
+    Cycles += VCYCLESCALL + ++Length * VCYCLESPERCHAR;   // Append: strlen
+  }
+  Cycles += 2 * (VCYCLESCALL + ++Length * VCYCLESPERCHAR); // strcat ; then strlen
+  (void)Ptr;
+  return Cycles;
+}
+
+
+unsigned long NewCycles(const SCATCommands* Ptr, const char* Msg)
+{
+  unsigned long Cycles = VCYCLESFIXED;
+  const char* Digit = Msg + 4;
+  byte Width = Ptr->NumParams;
+
+  if ((*Digit == '+') || (*Digit == '-'))
+  {
+    Digit++;
+    Width--;
+  }
+  for (; *Digit != ';'; Digit++)
+    Cycles += VCYCLESDIGIT + (*Digit - '0' + 1) * ((Width <= 4) ? VCYCLESLOOP16 : VCYCLESLOOP32);
+  return Cycles;
+}
+
+
+//
+// mean estimated cycles for each command over its in range values
+//
+void EstimateCycles(void)
+{
+  char Msg[40];
+  size_t Field, Value;
+  const SCATCommands* Ptr;
+  double OldTotal, NewTotal, OldAll = 0, NewAll = 0;
+  unsigned long Count;
+
+  printf("estimated AVR cycles per message (mean over in range values; at 20MHz, 20 cycles = 1us):\n");
+  for (Field = 0; Field < GFields.size(); Field++)
+  {
+    Ptr = GFields[Field];
+    MakeValues(Ptr);
+    OldTotal = NewTotal = 0;
+    Count = 0;
+    for (Value = 0; Value < GValues.size(); Value++)
+      if ((GValues[Value] >= Ptr->MinParamValue) && (GValues[Value] <= Ptr->MaxParamValue))
+      {
+        LegacyFormatCATMessageNumeric(Msg, Ptr, GValues[Value]);
+        OldTotal += LegacyCycles(Ptr, Msg);
+        NewTotal += NewCycles(Ptr, Msg);
+        Count++;
+      }
+    printf("  %s%s (%2d digits): old %6.0f  new %4.0f  (%.1fx)\n", Ptr->CATString,
+           (Field < VNUMCATCMDS) ? "" : " test", Ptr->NumParams, OldTotal / Count, NewTotal / Count, OldTotal / NewTotal);
+    OldAll += OldTotal / Count;
+    NewAll += NewTotal / Count;
+  }
+  printf("  all fields: old %.0f  new %.0f  (%.1fx)\n", OldAll / GFields.size(), NewAll / GFields.size(), OldAll / NewAll);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+  unsigned long Iterations = 2000000;
+  int Cntr;
+
+  if (argc > 1)
+    Iterations = strtoul(argv[1], NULL, 0);
+  for (Cntr = 0; Cntr < VNUMCATCMDS; Cntr++)
+    GFields.push_back(GCATCommands + Cntr);
+  for (Cntr = 0; Cntr < VNUMSIGNEDFIELDS; Cntr++)
+    GFields.push_back(GSignedFields + Cntr);
+
+  CheckIdentical();
+  CheckTemplate<eZZZD>();
+  CheckTemplate<eZZZU>();
+  CheckTemplate<eZZZE>();
+  CheckTemplate<eZZZG>();
+  CheckTemplate<eZZZS>();
+
+  printf("PC time per message:\n");
+  TimeCommand(eZZZU, Iterations);
+  TimeCommand(eZZZE, Iterations);
+  TimeCommand(eZZZA, Iterations);
+  TimeCommand(eZZZS, Iterations);
+  TimeCommand(eZZZG, Iterations);
+  EstimateCycles();
+  return CheckSummary();
+}
@@ -0,0 +1,180 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// framebench.cpp
+// compares ASCII CAT event messages with binary event frames (ZZZF1;)
+// at each CAT baud rate. All 10 encoders are turned one click every tick
+// (with the encoder increment set to 1 edge per click),
+// which is more than the link can carry at the lower rates; clicks that
+// can't be sent straight away are merged in the TX queue.
+// reports events (messages or frames) and clicks delivered per second,
+// and the PC time to make one ASCII message or one frame.
+//
+// framebench [ticks]
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include "simhardware.h"
+#include "tiger.h"
+#include "catframe.h"
+
+
+#define VLEDTESTTICKS 1200                  // ticks for LED self test to complete
+#define VWARMUPTICKS 100                    // ticks to fill the queue before measuring
+#define VNUMRATES 6
+
+const unsigned long GRates[VNUMRATES] = {9600, 115200, 230400, 250000, 500000, 1000000};
+
+
+uint64_t HostNanoseconds(void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+
+//
+// count encoder events and clicks in ASCII output
+//
+void CountASCII(const std::string& Output, unsigned long* Events, long* Clicks)
+{
+  size_t Pos = 0;
+  int Param;
+
+  while ((Pos = Output.find("ZZZE", Pos)) != std::string::npos)
+  {
+    Param = atoi(Output.c_str() + Pos + 4);
+    (*Events)++;
+    *Clicks += (Param >= 510) ? -(Param % 10) : (Param % 10);
+    Pos += 4;
+  }
+}
+
+
+//
+// count encoder events and clicks in binary output
+//
+void CountFrames(const std::string& Output, SCATFrameDecoder* Decoder, unsigned long* Events, long* Clicks)
+{
+  SCATFrameEvent Event;
+  size_t Cntr;
+
+  for (Cntr = 0; Cntr < Output.size(); Cntr++)
+    if (DecodeCATFrameByte(Decoder, (byte)Output[Cntr], &Event) == eDecodeEvent)
+      if (Event.Type == eFrameEncoder)
+      {
+        (*Events)++;
+        *Clicks += Event.Value;
+      }
+}
+
+
+//
+// run the panel at one baud rate, with frames on or off
+// returns false if any frame failed to decode
+//
+bool RunRate(byte RateCode, bool Frames, unsigned long Ticks, double* EventRate, double* ClickRate)
+{
+  char Cmd[16];
+  unsigned long Tick, Events = 0;
+  long Clicks = 0;
+  byte Encoder;
+  SCATFrameDecoder Decoder;
+  std::string Output;                               // ASCII output, as messages can be split between ticks
+
+  SimEraseEEPROM();
+  SimPowerOn();
+  SimRunTicks(VLEDTESTTICKS);
+  SimHostSend("ZZZX011;");                          // 1 click per edge
+  snprintf(Cmd, sizeof(Cmd), "ZZZB%d;", RateCode);
+  SimHostSend(Cmd);
+  SimRunTicks(20);
+  SimHostSend("ZZZB;");                             // confirm the new rate
+  SimHostSend(Frames ? "ZZZF1;" : "ZZZF0;");
+  SimRunTicks(20);
+  SimHostReceive();
+  InitCATFrameDecoder(&Decoder);
+
+  for (Tick = 0; Tick < VWARMUPTICKS + Ticks; Tick++)
+  {
+    for (Encoder = 0; Encoder < VMAXSIMENCODERS; Encoder++)
+      SimTurnEncoder(Encoder, 1);
+    SimRunTicks(1);
+    if (Tick == VWARMUPTICKS)
+      SimHostReceive();
+    else if (Tick > VWARMUPTICKS)
+    {
+      if (Frames)
+        CountFrames(SimHostReceive(), &Decoder, &Events, &Clicks);
+      else
+        Output += SimHostReceive();
+    }
+  }
+  CountASCII(Output, &Events, &Clicks);
+  *EventRate = Events * 500.0 / Ticks;
+  *ClickRate = Clicks * 500.0 / Ticks;
+  return (Decoder.CRCErrors == 0) && (Decoder.Missed == 0);
+}
+
+
+//
+// PC time to make one message each way
+//
+void TimeFormatting(void)
+{
+  char Message[20];
+  byte Frame[VCATFRAMESIZE];
+  unsigned long Cntr, Count = 1000000;
+  uint64_t Start, ASCIITime, FrameTime;
+  volatile byte Sink = 0;
+
+  Start = HostNanoseconds();
+  for (Cntr = 0; Cntr < Count; Cntr++)
+    Sink += FormatCATMessageNumeric(Message, eZZZE, 10 + (Cntr % 90) * 10 + (Cntr % 9));
+  ASCIITime = HostNanoseconds() - Start;
+  Start = HostNanoseconds();
+  for (Cntr = 0; Cntr < Count; Cntr++)
+  {
+    MakeCATFrame(Frame, eFrameEncoder, Cntr, Cntr % 10, (int)(Cntr % 15) - 7);
+    Sink += Frame[2];
+  }
+  FrameTime = HostNanoseconds() - Start;
+  printf("PC time per event: ASCII message %.1f ns, binary frame %.1f ns\n",
+         (double)ASCIITime / Count, (double)FrameTime / Count);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+  unsigned long Ticks = 2500;
+  double ASCIIEvents, ASCIIClicks, FrameEvents, FrameClicks;
+  byte Rate;
+  int Failed = 0;
+
+  if (argc > 1)
+    Ticks = strtoul(argv[1], NULL, 0);
+
+  printf("10 encoders turning 1 click per tick (5000 clicks/s offered), %lu ticks\n", Ticks);
+  printf("%8s  %22s  %22s\n", "", "ASCII", "binary frames");
+  printf("%8s  %10s %11s  %10s %11s\n", "baud", "events/s", "clicks/s", "events/s", "clicks/s");
+  for (Rate = 0; Rate < VNUMRATES; Rate++)
+  {
+    RunRate(Rate, false, Ticks, &ASCIIEvents, &ASCIIClicks);
+    if (!RunRate(Rate, true, Ticks, &FrameEvents, &FrameClicks))
+      Failed = 1;
+    printf("%8lu  %10.0f %11.0f  %10.0f %11.0f\n", GRates[Rate], ASCIIEvents, ASCIIClicks, FrameEvents, FrameClicks);
+  }
+  TimeFormatting();
+  if (Failed)
+    printf("FAIL: frames lost or corrupted\n");
+  return Failed;
+}
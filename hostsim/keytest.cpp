@@ -0,0 +1,334 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// keytest.cpp
+// tests the switch matrix scanning and debounce (button.cpp) with
+// overlapping key presses: chords, a press during another key's hold,
+// every key at once, long presses overlapping short ones, contact bounce,
+// shift changes while a key is held, and eager debounce (ZZZK).
+// every key's press, long press and release must be reported on its own.
+//
+// keytest
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "simhardware.h"
+#include "simtest.h"
+
+
+#define VLEDTESTTICKS 1200                  // ticks for LED self test to complete
+#define VBANDSHIFTSCANCODE 9                // as button.cpp
+#define VENCODERSHIFTSCANCODE 27
+#define VNUMCOLUMNS 4                       // ticks to scan every column
+#define VMAXDEBOUNCETICKS 16                // 4 scans of each column
+#define VWAKETICKS 1                        // tick to wake an idle matrix (MCPINTERRUPTS)
+
+//
+// report code for each scan code with band shift off, as button.cpp; 0 = not reported
+//
+const int GReportCodes[32] =
+{
+  4, 5, 6, 7, 1, 2, 3, 0,
+  8, 39, 23, 20, 17, 14, 0, 0,
+  24, 25, 21, 22, 18, 19, 15, 16,
+  9, 10, 11, 40, 12, 13, 0, 0
+};
+
+//
+// check the same messages were sent, in any order
+// (keys in different columns are reported in the order the columns are scanned)
+//
+std::string SortMessages(const std::string& Output)
+{
+  std::vector<std::string> Messages;
+  std::string Result;
+  size_t Pos = 0, End;
+
+  while ((End = Output.find(';', Pos)) != std::string::npos)
+  {
+    Messages.push_back(Output.substr(Pos, End - Pos + 1));
+    Pos = End + 1;
+  }
+  std::sort(Messages.begin(), Messages.end());
+  for (Pos = 0; Pos < Messages.size(); Pos++)
+    Result += Messages[Pos];
+  return Result + Output.substr(Pos ? Output.rfind(';') + 1 : 0);
+}
+
+
+void CheckEvents(const char* Name, const std::string& Output, const std::string& Expected)
+{
+  CheckOutput(Name, SortMessages(Output), SortMessages(Expected));
+}
+
+
+//
+// the ZZZP message for a key event: State 0 = release, 1 = press, 2 = long press
+//
+std::string KeyMessage(byte ScanCode, int State)
+{
+  char Msg[24];
+
+  snprintf(Msg, sizeof(Msg), "ZZZP%03d;", GReportCodes[ScanCode] * 10 + State);
+  return Msg;
+}
+
+
+//
+// true if a key is reported: it has a report code, and isn't a shift key
+//
+bool IsReported(byte ScanCode)
+{
+  return (GReportCodes[ScanCode] != 0) && (ScanCode != VBANDSHIFTSCANCODE) && (ScanCode != VENCODERSHIFTSCANCODE);
+}
+
+
+void TestChord(void)
+{
+  std::string Output;
+
+  SimSetKey(0, true);
+  SimSetKey(10, true);
+  SimSetKey(17, true);
+  CheckEvents("3 key chord pressed", RunAndReceive(50), KeyMessage(0, 1) + KeyMessage(10, 1) + KeyMessage(17, 1));
+  SimSetKey(0, false);
+  SimSetKey(10, false);
+  SimSetKey(17, false);
+  CheckEvents("3 key chord released", RunAndReceive(50), KeyMessage(0, 0) + KeyMessage(10, 0) + KeyMessage(17, 0));
+
+  SimSetKey(3, true);                       // 2 keys in the same column
+  SimSetKey(5, true);
+  CheckOutput("same column chord pressed", RunAndReceive(50), KeyMessage(3, 1) + KeyMessage(5, 1));
+  SimSetKey(5, false);
+  CheckOutput("same column: one released", RunAndReceive(50), KeyMessage(5, 0));
+  SimSetKey(3, false);
+  CheckOutput("same column: other released", RunAndReceive(50), KeyMessage(3, 0));
+}
+
+
+void TestPressDuringHold(void)
+{
+  SimSetKey(0, true);
+  CheckOutput("held key pressed", RunAndReceive(50), KeyMessage(0, 1));
+  SimSetKey(16, true);
+  CheckOutput("2nd key pressed during hold", RunAndReceive(50), KeyMessage(16, 1));
+  SimSetKey(0, false);
+  CheckOutput("1st key released while 2nd held", RunAndReceive(50), KeyMessage(0, 0));
+  SimSetKey(24, true);
+  CheckOutput("3rd key pressed during hold", RunAndReceive(50), KeyMessage(24, 1));
+  SimSetKey(16, false);
+  SimSetKey(24, false);
+  CheckEvents("both released", RunAndReceive(50), KeyMessage(16, 0) + KeyMessage(24, 0));
+}
+
+
+void TestAllKeys(void)
+{
+  std::string Output, Expected;
+  byte ScanCode;
+
+  for (ScanCode = 0; ScanCode < 32; ScanCode++)
+    if (IsReported(ScanCode))
+    {
+      SimSetKey(ScanCode, true);
+      Expected += KeyMessage(ScanCode, 1);
+    }
+  CheckEvents("every key pressed at once", RunAndReceive(300), Expected);
+  Expected.clear();
+  for (ScanCode = 0; ScanCode < 32; ScanCode++)
+    if (IsReported(ScanCode))
+    {
+      SimSetKey(ScanCode, false);
+      Expected += KeyMessage(ScanCode, 0);
+    }
+  CheckEvents("every key released at once", RunAndReceive(300), Expected);
+}
+
+
+void TestLongPress(void)
+{
+  std::string Output;
+
+  SimSetKey(16, true);
+  Output = RunAndReceive(200);
+  SimSetKey(0, true);
+  Output += RunAndReceive(100);
+  SimSetKey(0, false);
+  Output += RunAndReceive(600);
+  SimSetKey(1, true);                       // pressed before key 16 is long pressed
+  Output += RunAndReceive(1100);
+  SimSetKey(16, false);
+  Output += RunAndReceive(50);
+  SimSetKey(1, false);
+  Output += RunAndReceive(50);
+  CheckOutput("long press overlapping other presses", Output,
+              KeyMessage(16, 1) + KeyMessage(0, 1) + KeyMessage(0, 0) + KeyMessage(1, 1) + KeyMessage(16, 2)
+              + KeyMessage(1, 2) + KeyMessage(16, 0) + KeyMessage(1, 0));
+}
+
+
+//
+// press and release a key 50 times, with its contacts bouncing for 10ms each time
+// returns the number of times it gave exactly one press and one release
+//
+int BounceTrials(byte ScanCode)
+{
+  std::string Output;
+  int Cntr, Trial, Good = 0;
+
+  srand(1);
+  for (Trial = 0; Trial < 50; Trial++)
+  {
+    for (Cntr = 0; Cntr < 5; Cntr++)
+    {
+      SimSetKey(ScanCode, rand() & 1);
+      Output += RunAndReceive(1);
+    }
+    SimSetKey(ScanCode, true);
+    Output += RunAndReceive(50);
+    for (Cntr = 0; Cntr < 5; Cntr++)
+    {
+      SimSetKey(ScanCode, rand() & 1);
+      Output += RunAndReceive(1);
+    }
+    SimSetKey(ScanCode, false);
+    Output += RunAndReceive(50);
+    if (Output == KeyMessage(ScanCode, 1) + KeyMessage(ScanCode, 0))
+      Good++;
+    Output.clear();
+  }
+  return Good;
+}
+
+
+//
+// worst time from a press to its report, in ticks, for a set of keys
+//
+int WorstLatency(const byte* ScanCodes, byte Count)
+{
+  byte Cntr;
+  int Ticks, Worst = 0;
+
+  for (Cntr = 0; Cntr < Count; Cntr++)
+  {
+    SimSetKey(ScanCodes[Cntr], true);
+    for (Ticks = 1; Ticks < 50; Ticks++)
+      if (RunAndReceive(1) != "")
+        break;
+    if (Ticks > Worst)
+      Worst = Ticks;
+    SimSetKey(ScanCodes[Cntr], false);
+    RunAndReceive(50);
+  }
+  return Worst;
+}
+
+
+//
+// a pulse shorter than a column scan is ignored
+//
+void TestBounce(void)
+{
+  std::string Output;
+
+  Check("bouncing contacts give one press and one release", BounceTrials(2) == 50);
+  SimSetKey(2, true);
+  Output = RunAndReceive(3);
+  SimSetKey(2, false);
+  Output += RunAndReceive(50);
+  CheckOutput("6ms glitch ignored", Output, "");
+}
+
+
+//
+// time from a press to its report, for a key in each column
+//
+void TestLatency(void)
+{
+  const byte ScanCodes[] = {0, 10, 17, 24};
+  int Worst;
+
+  Worst = WorstLatency(ScanCodes, sizeof(ScanCodes));
+  printf("worst case press to report: %d ticks\n", Worst);
+  Check("press reported within 4 scans", Worst <= VMAXDEBOUNCETICKS + VWAKETICKS + 1);
+}
+
+
+//
+// eager debounce (ZZZK) for panel buttons only:
+// they report on the first scan, and still give one press per bounced press
+//
+void TestEagerDebounce(void)
+{
+  const byte PanelKeys[] = {0, 10, 17, 24};
+  const byte EncoderKeys[] = {4, 28};
+  int Worst;
+
+  SimHostSend("ZZZK;");
+  CheckOutput("debounce policy default", RunAndReceive(50), "ZZZK10;ZZZK20;ZZZK30;");
+  SimHostSend("ZZZK11;");
+  SimHostSend("ZZZK;");
+  CheckOutput("eager debounce for panel buttons", RunAndReceive(50), "ZZZK11;ZZZK20;ZZZK30;");
+  Worst = WorstLatency(PanelKeys, sizeof(PanelKeys));
+  printf("eager: worst case press to report: %d ticks\n", Worst);
+  Check("eager press reported within 1 scan", Worst <= VNUMCOLUMNS + VWAKETICKS + 1);
+  Check("eager: encoder buttons still wait for a stable input", WorstLatency(EncoderKeys, sizeof(EncoderKeys)) > VNUMCOLUMNS + VWAKETICKS + 1);
+  Check("eager: bouncing contacts give one press and one release", BounceTrials(2) == 50);
+
+  SimPowerOn();                             // setting kept in EEPROM
+  RunAndReceive(VLEDTESTTICKS);
+  SimHostSend("ZZZK;");
+  CheckOutput("debounce policy kept after power on", RunAndReceive(50), "ZZZK11;ZZZK20;ZZZK30;");
+  SimHostSend("ZZZK10;");
+  SimHostSend("ZZZK;");
+  CheckOutput("eager debounce off", RunAndReceive(50), "ZZZK10;ZZZK20;ZZZK30;");
+}
+
+
+//
+// the release of a key uses the code sent for its press,
+// even if band shift changed while it was held
+//
+void TestShiftDuringHold(void)
+{
+  SimSetKey(10, true);
+  CheckOutput("key pressed unshifted", RunAndReceive(50), "ZZZP231;");
+  SimSetKey(VBANDSHIFTSCANCODE, true);
+  RunAndReceive(50);
+  SimSetKey(VBANDSHIFTSCANCODE, false);
+  RunAndReceive(50);
+  SimSetKey(11, true);
+  CheckOutput("2nd key pressed shifted", RunAndReceive(50), "ZZZP331;");
+  SimSetKey(10, false);
+  SimSetKey(11, false);
+  CheckOutput("releases match presses", RunAndReceive(50), "ZZZP230;ZZZP330;");
+  SimSetKey(VBANDSHIFTSCANCODE, true);
+  RunAndReceive(50);
+  SimSetKey(VBANDSHIFTSCANCODE, false);
+  RunAndReceive(50);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+  SimEraseEEPROM();
+  SimPowerOn();
+  RunAndReceive(VLEDTESTTICKS);
+
+  TestChord();
+  TestPressDuringHold();
+  TestAllKeys();
+  TestLongPress();
+  TestBounce();
+  TestLatency();
+  TestShiftDuringHold();
+  TestEagerDebounce();
+  return CheckSummary();
+}
@@ -0,0 +1,919 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// panelsim.cpp
+// runs the g2v2panel sketch against the simulated hardware
+//
+// panelsim            run the regression scenario; exit code 0 if all passed
+// panelsim -b N       benchmark N ticks with the panel in use
+// panelsim -v         as the scenario, but print all CAT traffic
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include "simhardware.h"
+#include "simtest.h"
+#include "globalinclude.h"
+#include "SPIdata.h"
+#include "encoders.h"
+#include "button.h"
+#include "tiger.h"
+#include "cathandler.h"
+#include "led.h"
+#include "txqueue.h"
+#include "catframe.h"
+#include "iopins.h"
+#include "scheduler.h"
+
+
+#define VLEDTESTTICKS 1200                  // ticks for LED self test to complete
+
+
+//
+// turn an encoder one edge per tick
+//
+std::string TurnEncoder(byte Encoder, int Edges)
+{
+  std::string Output;
+  int Step = (Edges > 0) ? 1 : -1;
+
+  while (Edges != 0)
+  {
+    SimTurnEncoder(Encoder, Step);
+    Output += RunAndReceive(1);
+    Edges -= Step;
+  }
+  return Output + RunAndReceive(20);
+}
+
+
+//
+// run one tick at a time until the panel sends something, for up to Ticks ticks
+//
+std::string WaitForOutput(unsigned long Ticks)
+{
+  std::string Output;
+
+  while (Output.empty() && (Ticks-- != 0))
+    Output = RunAndReceive(1);
+  return Output;
+}
+
+
+//
+// count the messages for one command in a string of messages
+//
+int CountMessages(const std::string& Output, const char* Cmd)
+{
+  size_t Pos = 0;
+  int Count = 0;
+
+  while ((Pos = Output.find(Cmd, Pos)) != std::string::npos)
+  {
+    Count++;
+    Pos += 4;
+  }
+  return Count;
+}
+
+
+//
+// add up the clicks reported for one encoder (1-12) in a string of ZZZE messages
+//
+int EncoderClicks(const std::string& Output, int Encoder)
+{
+  size_t Pos = 0;
+  int Clicks = 0;
+  int Param;
+
+  while ((Pos = Output.find("ZZZE", Pos)) != std::string::npos)
+  {
+    Param = atoi(Output.c_str() + Pos + 4);
+    if (Param / 10 == Encoder)
+      Clicks += Param % 10;
+    else if (Param / 10 == Encoder + 50)
+      Clicks -= Param % 10;
+    Pos += 4;
+  }
+  return Clicks;
+}
+
+
+//
+// add up the VFO steps in a string of ZZZU/ZZZD messages
+//
+int VFOSteps(const std::string& Output, int* Messages)
+{
+  size_t Pos = 0;
+  int Steps = 0;
+
+  *Messages = 0;
+  while ((Pos = Output.find("ZZZ", Pos)) != std::string::npos)
+  {
+    if (Output[Pos + 3] == 'U')
+      Steps += atoi(Output.c_str() + Pos + 4);
+    else if (Output[Pos + 3] == 'D')
+      Steps -= atoi(Output.c_str() + Pos + 4);
+    (*Messages)++;
+    Pos += 4;
+  }
+  return Steps;
+}
+
+
+//
+// spin the VFO at a steady rate: every step must be reported,
+// using no more than half the CAT link
+//
+bool SteadySpin(int EdgesPerTick, int Ticks)
+{
+  std::string Output;
+  int Cntr, Messages, Steps;
+  unsigned long MaxMessages;
+
+  for (Cntr = 0; Cntr < Ticks; Cntr++)
+  {
+    SimTurnVFO(EdgesPerTick);
+    Output += RunAndReceive(1);
+  }
+  Output += RunAndReceive(50);
+  Steps = VFOSteps(Output, &Messages);
+  MaxMessages = (SimGetBaudRate() / 10) * (Ticks + 50) / 500 / 7 / 2 + 1;
+  if (GVerbose)
+    printf("  %d steps in %d messages (max %lu)\n", Steps, Messages, MaxMessages);
+  return (Steps == EdgesPerTick * Ticks) && ((unsigned long)Messages <= MaxMessages);
+}
+
+
+//
+// decode binary frames and text from the panel into a readable string:
+// frames appear as [type control value]
+//
+std::string DecodeFrames(const std::string& Output, SCATFrameDecoder* Decoder)
+{
+  std::string Result;
+  SCATFrameEvent Event;
+  char Str[32];
+  size_t Cntr;
+
+  for (Cntr = 0; Cntr < Output.size(); Cntr++)
+    switch (DecodeCATFrameByte(Decoder, (byte)Output[Cntr], &Event))
+    {
+      case eDecodeText:
+        Result += Output[Cntr];
+        break;
+      case eDecodeEvent:
+        snprintf(Str, sizeof(Str), "[%d %d %d]", (int)Event.Type, Event.Control, Event.Value);
+        Result += Str;
+        break;
+      case eDecodeError:
+        Result += "[CRC]";
+        break;
+      default:
+        break;
+    }
+  return Result;
+}
+
+
+//
+// the regression scenario: power on from blank EEPROM and exercise
+// each control and CAT command, checking the messages sent
+//
+void RunScenario(void)
+{
+  std::string Output;
+
+  SimEraseEEPROM();
+  SimPowerOn();
+  Check("CAT link at 9600 baud", SimGetBaudRate() == 9600);
+  Output = RunAndReceive(VLEDTESTTICKS);
+  CheckOutput("quiet during LED self test", Output, "");
+
+  {
+    const byte LEDPins[] = {VPININDICATOR5, VPININDICATOR6, VPININDICATOR7, VPININDICATOR8,
+                            VPININDICATOR9, VPININDICATOR10, VPININDICATOR11};
+    unsigned long Transactions = GSimStats.SPITransactions;
+    unsigned long LEDWrites = 0;
+    size_t Cntr;
+
+    RunAndReceive(20);                                  // the planes made at the end of the self test go out
+    Transactions = GSimStats.SPITransactions;
+    for (Cntr = 0; Cntr < sizeof(LEDPins); Cntr++)
+      LEDWrites -= SimGetPinPortWrites(LEDPins[Cntr]);
+    RunAndReceive(5000);
+    Transactions = GSimStats.SPITransactions - Transactions;
+    for (Cntr = 0; Cntr < sizeof(LEDPins); Cntr++)
+      LEDWrites += SimGetPinPortWrites(LEDPins[Cntr]);
+    if (GVerbose)
+      printf("  idle panel: %.1f SPI transactions/s, %lu LED pin writes\n", Transactions / 10.0, LEDWrites);
+#ifdef MCPINTERRUPTS
+    Check("idle panel: SPI only for keep-alive reads", Transactions <= 50);
+#endif
+    Check("idle panel: LED pins not rewritten", LEDWrites == 0);
+  }
+
+  HostSend("ZZZS;");
+  CheckOutput("version query", RunAndReceive(10), "ZZZS0502009;");
+  HostSend("ZZZX;");
+  CheckOutput("encoder increment query", RunAndReceive(10), "ZZZX012;");
+
+  SimSetKey(0, true);
+  CheckOutput("button press", RunAndReceive(50), "ZZZP041;");
+  SimSetKey(0, false);
+  CheckOutput("button release", RunAndReceive(50), "ZZZP040;");
+
+  SimSetKey(16, true);
+  Output = RunAndReceive(1100);
+  SimSetKey(16, false);
+  Output += RunAndReceive(50);
+  CheckOutput("button long press", Output, "ZZZP241;ZZZP242;ZZZP240;");
+  {
+    unsigned long PressTime, LongPressTime;
+    SimSetKey(16, true);
+    Output = RunAndReceive(50);
+    PressTime = micros();
+    while ((Output.find("ZZZP242;") == std::string::npos) && (micros() - PressTime < 4000000))
+    {
+      SimAdvanceTime(18000);                          // main loop stalled for 9 ticks in every 10
+      Output += RunAndReceive(1);
+    }
+    LongPressTime = micros() - PressTime;
+    SimSetKey(16, false);
+    Output += RunAndReceive(50);
+    if (GVerbose)
+      printf("  long press with a stalled main loop after %lu ms\n", LongPressTime / 1000);
+    CheckOutput("stalled main loop: long press keeps time", Output, "ZZZP241;ZZZP242;ZZZP240;");
+    Check("stalled main loop: long press after 2s", (LongPressTime > 1800000) && (LongPressTime < 2200000));
+  }
+
+  SimSetKey(9, true);
+  RunAndReceive(50);
+  SimSetKey(9, false);
+  CheckOutput("band shift is local", RunAndReceive(50), "");
+  Check("band shift LED lit", SimGetPinOutput(VPININDICATOR10) == HIGH);
+  SimSetKey(10, true);
+  CheckOutput("shifted button press", RunAndReceive(50), "ZZZP361;");
+  SimSetKey(10, false);
+  RunAndReceive(50);
+  SimSetKey(9, true);
+  RunAndReceive(50);
+  SimSetKey(9, false);
+  RunAndReceive(50);
+  Check("band shift LED off", SimGetPinOutput(VPININDICATOR10) == LOW);
+
+  CheckOutput("encoder 1 clockwise", TurnEncoder(0, 2), "ZZZE011;");
+  CheckOutput("encoder 1 anticlockwise", TurnEncoder(0, -2), "ZZZE511;");
+  CheckOutput("encoder 8 clockwise", TurnEncoder(7, 2), "ZZZE081;");
+  CheckOutput("encoder 10 anticlockwise", TurnEncoder(9, -2), "ZZZE601;");
+
+  HostSend("ZZZM;");
+  CheckOutput("encoder mode query", RunAndReceive(10), "ZZZM0;");
+  HostSend("ZZZM1;");
+  RunAndReceive(10);
+  CheckOutput("counting mode clockwise", TurnEncoder(2, 4), "ZZZE031;ZZZE031;");
+  CheckOutput("counting mode anticlockwise", TurnEncoder(2, -3), "ZZZE531;");
+  CheckOutput("counting mode keeps residue", TurnEncoder(2, -1), "ZZZE531;");
+  CATHandleEncoder(1, 20, TimebaseMicros());
+  CheckOutput("large movement split into messages", RunAndReceive(50), "ZZZE029;ZZZE029;ZZZE022;");
+  CATHandleEncoder(1, -10, TimebaseMicros());
+  CATHandleEncoder(1, 3, TimebaseMicros());
+  CATHandleEncoder(2, 1, TimebaseMicros());
+  CheckOutput("queued clicks merged", RunAndReceive(50), "ZZZE527;ZZZE031;");
+  HostSend("ZZZM0;");
+  RunAndReceive(10);
+
+  {
+    std::string Output;
+    long Overruns, SPITime, SPIMaxTime, TickOverruns, LostTicks;
+    HostSend("ZZZM1;");
+    RunAndReceive(10);
+    for (int Cntr = 0; Cntr < 40; Cntr++)             // 2 edges per tick: oversampled by the timer interrupt
+    {
+      SimTurnEncoder(8, 1);
+      SimAdvanceTime(1000);
+      if (Cntr & 1)
+        Output += RunAndReceive(1);
+    }
+    Output += RunAndReceive(200);
+    Check("direct wired encoder: 2 edges per tick decoded", EncoderClicks(Output, 9) == 20);
+#ifdef MCPINTERRUPTS
+    Output.clear();
+    for (int Cntr = 0; Cntr < 20; Cntr++)             // 2 edges per tick: 1st held by INTCAP
+    {
+      SimTurnEncoder(1, 1);
+      SimTurnEncoder(1, 1);
+      Output += RunAndReceive(1);
+    }
+    Output += RunAndReceive(200);
+    Check("MCP encoder: 2 edges per tick decoded", EncoderClicks(Output, 2) == 20);
+#endif
+    HostSend("ZZZM0;");
+    RunAndReceive(10);
+    SimTurnEncoder(8, 1);                             // glitch seen by one sample only
+    SimAdvanceTime(500);
+    SimTurnEncoder(8, -1);
+    CheckOutput("direct wired encoder: 0.5ms glitch ignored", RunAndReceive(20), "");
+
+    SimSetTimerLatency(6);
+    RunAndReceive(5);
+    SimSetTimerLatency(0);
+    RunAndReceive(5);
+    HostSend("ZZZG05;");
+    CheckOutput("input sampling jitter", RunAndReceive(20), "ZZZG050003000;");
+    HostSend("ZZZG06;");
+    CheckOutput("input sampling latency", RunAndReceive(20), "ZZZG060003000;");
+    HostSend("ZZZG08;");
+    RunAndReceive(20);
+    for (int Cntr = 0; Cntr < 100; Cntr++)            // every tick reads the encoder expander
+    {
+      SimTurnEncoder(0, 1);
+      RunAndReceive(1);
+    }
+    RunAndReceive(100);                               // let the encoder reports drain
+    HostSend("ZZZG08;");
+    Output = RunAndReceive(20);
+    SPITime = (Output.find("ZZZG08") == std::string::npos) ? 0 : atol(Output.c_str() + Output.find("ZZZG08") + 6);
+    HostSend("ZZZG09;");
+    Output = RunAndReceive(20);
+    SPIMaxTime = (Output.find("ZZZG09") == std::string::npos) ? 0 : atol(Output.c_str() + Output.find("ZZZG09") + 6);
+    if (GVerbose)
+      printf("  SPI time per tick: mean %ld ns, max %ld ns\n", SPITime, SPIMaxTime);
+    Check("SPI time per tick measured", (SPITime > 0) && (SPITime <= SPIMaxTime));
+    Check("SPI time per tick within one burst of each device", SPIMaxTime <= 25000);
+    {
+      char Cmd[40];
+      long TickRuns = 0, LEDRuns = 0, TaskOverruns = 0;
+      size_t Pos;
+      byte Task;
+
+      sprintf(Cmd, "ZZZG%02d;ZZZG%02d;", eDiagTaskRuns + eTaskInputReads, eDiagTaskRuns + eTaskLEDs);
+      HostSend(Cmd);                                                // read to reset, then count 500 ticks
+      RunAndReceive(20);
+      RunAndReceive(500);
+      HostSend(Cmd);
+      Output = RunAndReceive(20);
+      sprintf(Cmd, "ZZZG%02d", eDiagTaskRuns + eTaskInputReads);
+      if ((Pos = Output.find(Cmd)) != std::string::npos)
+        TickRuns = atol(Output.c_str() + Pos + 6);
+      sprintf(Cmd, "ZZZG%02d", eDiagTaskRuns + eTaskLEDs);
+      if ((Pos = Output.find(Cmd)) != std::string::npos)
+        LEDRuns = atol(Output.c_str() + Pos + 6);
+      for (Task = 0; Task < eNumTasks; Task++)                      // overruns since power on
+      {
+        sprintf(Cmd, "ZZZG%02d;", eDiagTaskOverruns + Task);
+        HostSend(Cmd);
+        Output = RunAndReceive(20);
+        if ((Pos = Output.find(Cmd, 0, 6)) != std::string::npos)
+          TaskOverruns += atol(Output.c_str() + Pos + 6);
+      }
+      if (GVerbose)
+        printf("  task runs: every tick %ld, LEDs %ld; overruns %ld\n", TickRuns, LEDRuns, TaskOverruns);
+      Check("every tick task runs counted", (TickRuns >= 520) && (TickRuns <= 540));
+      Check("LED task runs every 10ms", (LEDRuns * VLEDTASKPERIOD >= TickRuns - VLEDTASKPERIOD)
+                                     && (LEDRuns * VLEDTASKPERIOD <= TickRuns + VLEDTASKPERIOD));
+      Check("no task over budget", TaskOverruns == 0);
+    }
+#ifdef TASKPROFILE
+    {
+      char Cmd[40];
+      long Stats[eProfileHistogram + VPROFILEBINS];
+      long BinRuns = 0;
+      size_t Pos;
+      int Stat;
+
+      HostSend("ZZZW99;");                                        // clear, then profile 500 ticks
+      RunAndReceive(20);
+      RunAndReceive(500);
+      sprintf(Cmd, "ZZZW%02d;", VPROFILETICK);
+      HostSend(Cmd);
+      Output = RunAndReceive(200);
+      for (Stat = 0; Stat < eProfileHistogram + VPROFILEBINS; Stat++)
+      {
+        sprintf(Cmd, "ZZZW%02d%d", VPROFILETICK, Stat);
+        Pos = Output.find(Cmd);
+        Stats[Stat] = (Pos == std::string::npos) ? -1 : atol(Output.c_str() + Pos + 7);
+        if (Stat >= eProfileHistogram)
+          BinRuns += Stats[Stat];
+      }
+      if (GVerbose)
+        printf("  tick profile: runs %ld, min %ld us, mean %ld us, max %ld us\n",
+               Stats[eProfileRuns], Stats[eProfileMin], Stats[eProfileMean], Stats[eProfileMax]);
+      Check("tick profile: runs counted", (Stats[eProfileRuns] >= 520) && (Stats[eProfileRuns] <= 540));
+      Check("tick profile: min <= mean <= max", (Stats[eProfileMin] >= 0) && (Stats[eProfileMin] <= Stats[eProfileMean])
+                                                && (Stats[eProfileMean] <= Stats[eProfileMax]));
+      Check("tick profile: histogram holds every run", BinRuns == Stats[eProfileRuns]);
+      Check("tick profile: every tick within the 2ms budget", (Stats[eProfileHistogram + VPROFILEBINS - 1] == 0)
+                                                              && (Stats[eProfileMax] < 2000));
+      HostSend("ZZZW;");
+      Output = RunAndReceive(200);
+      Check("task profile summary: one message per task and the tick",
+            Output.size() == (eNumTasks + 1) * 14);
+      sprintf(Cmd, "ZZZW%02d;", eTaskLEDs);
+      HostSend(Cmd);
+      Output = RunAndReceive(200);
+      sprintf(Cmd, "ZZZW%02d%d", eTaskLEDs, eProfileRuns);
+      Pos = Output.find(Cmd);
+      Check("LED task profile: runs every 10ms", (Pos != std::string::npos)
+                                                 && (atol(Output.c_str() + Pos + 7) * VLEDTASKPERIOD >= Stats[eProfileRuns] - VLEDTASKPERIOD));
+    }
+#endif
+    HostSend("ZZZG07;");
+    Overruns = atol(RunAndReceive(20).c_str() + 6);
+    HostSend("ZZZG30;ZZZG31;");
+    Output = RunAndReceive(30);
+    TickOverruns = (Output.find("ZZZG30") == std::string::npos) ? -1 : atol(Output.c_str() + Output.find("ZZZG30") + 6);
+    LostTicks = (Output.find("ZZZG31") == std::string::npos) ? -1 : atol(Output.c_str() + Output.find("ZZZG31") + 6);
+    SimAdvanceTime(6000);                             // main loop stalled for 3 ticks
+    HostSend("ZZZG07;");
+    Check("input sample overruns counted", atol(RunAndReceive(20).c_str() + 6) == Overruns + 2);
+    HostSend("ZZZG30;ZZZG31;ZZZG32;");
+    Output = RunAndReceive(40);
+    if (GVerbose)
+      printf("  tick overruns before stall %ld, lost ticks %ld: %s\n", TickOverruns, LostTicks, Output.c_str());
+    Check("stalled main loop: tick overrun counted", (TickOverruns >= 0) && (Output.find("ZZZG30") != std::string::npos)
+                                                     && (atol(Output.c_str() + Output.find("ZZZG30") + 6) == TickOverruns + 1));
+    Check("stalled main loop: lost ticks counted", (LostTicks >= 0) && (Output.find("ZZZG31") != std::string::npos)
+                                                   && (atol(Output.c_str() + Output.find("ZZZG31") + 6) == LostTicks + 2));
+    Check("stalled main loop: worst tick gap", (Output.find("ZZZG32") != std::string::npos)
+                                               && (atol(Output.c_str() + Output.find("ZZZG32") + 6) >= 3));
+  }
+
+  SimTurnVFO(5);
+  CheckOutput("VFO up", RunAndReceive(20), "ZZZU05;");
+  SimTurnVFO(-3);
+  CheckOutput("VFO down", RunAndReceive(20), "ZZZD03;");
+  SimTurnVFO(250);
+  CheckOutput("fast VFO spin not lost", RunAndReceive(40), "ZZZU99;ZZZU99;ZZZU52;");
+  SimTurnVFO(1);
+  CheckOutput("slow VFO step reported next tick", RunAndReceive(1) + RunAndReceive(5), "ZZZU01;");
+  Check("steady VFO spin: exact and within link rate", SteadySpin(3, 200));
+  HostSend("ZZZV;");
+  CheckOutput("VFO policy query", RunAndReceive(10), "ZZZV10;");
+  HostSend("ZZZV00;");
+  RunAndReceive(20);
+  SimTurnVFO(1);
+  Check("fixed 20ms VFO policy", RunAndReceive(1) == "");
+  RunAndReceive(20);
+  Check("fixed 20ms VFO policy: steady spin exact", SteadySpin(3, 200));
+  HostSend("ZZZV10;");
+  RunAndReceive(20);
+  HostSend("ZZZG01;");
+  CheckOutput("VFO overflow count", RunAndReceive(30), "ZZZG010000000;");
+
+  HostSend("ZZZA;");
+  CheckOutput("acceleration query", RunAndReceive(20), "ZZZA10000;ZZZA20000;");
+  HostSend("ZZZA10502;");
+  RunAndReceive(20);
+  SimTurnVFO(1);
+  CheckOutput("accelerated VFO: slow step not multiplied", RunAndReceive(20), "ZZZU01;");
+  {
+    std::string Output;
+    int Messages;
+    unsigned long BlockedMicros = GSimStats.TXBlockedMicros;
+    for (int Cntr = 0; Cntr < 100; Cntr++)
+    {
+      SimTurnVFO(4);
+      SimSetKey(0, (Cntr >= 40) && (Cntr < 60));
+      Output += RunAndReceive(1);
+    }
+    Output += RunAndReceive(400);
+    Check("accelerated VFO: fast spin multiplied", VFOSteps(Output, &Messages) > 400);
+    Check("saturated CAT link: tick never waits", GSimStats.TXBlockedMicros == BlockedMicros);
+    Check("saturated CAT link: button events kept", (Output.find("ZZZP041;") != std::string::npos)
+                                                     && (Output.find("ZZZP040;") != std::string::npos));
+    HostSend("ZZZG03;");
+    Output = RunAndReceive(30);
+    Check("TX queue merge count", (Output.size() == 14) && (Output.compare(0, 6, "ZZZG03") == 0)
+                                  && (Output != "ZZZG030000000;"));
+  }
+  {
+    std::string Output;
+    unsigned long BlockedMicros = GSimStats.TXBlockedMicros;
+    int Clicks;
+
+    Output = TurnEncoder(2, 60);
+    Clicks = EncoderClicks(Output + RunAndReceive(400), 3);
+
+    HostSend("ZZZL;ZZZL;ZZZL;ZZZL;");                    // 48 replies: more than the queue holds
+    Output = TurnEncoder(2, 60);
+    Output += RunAndReceive(400);
+    Check("full TX queue: tick never waits", GSimStats.TXBlockedMicros == BlockedMicros);
+    Check("full TX queue: encoder steps kept", EncoderClicks(Output, 3) == Clicks);
+    Check("full TX queue: replies paced, none lost", CountMessages(Output, "ZZZL") == 48);
+    HostSend("ZZZG04;");
+    CheckOutput("full TX queue: nothing dropped", RunAndReceive(30), "ZZZG040000000;");
+  }
+  {
+    std::string Output;
+    unsigned long Drops = GTXQueueDrops;
+
+    HostSend("ZZZL;ZZZN;");                              // 23 replies
+    Output = RunAndReceive(1);
+    SimSetKey(0, true);
+    Output += RunAndReceive(20);
+    HostSend("ZZZL;");
+    SimSetKey(0, false);
+    Output += RunAndReceive(400);
+    Check("query flood: key press and release kept", (Output.find("ZZZP041;") != std::string::npos)
+                                                     && (Output.find("ZZZP040;") != std::string::npos));
+    Check("query flood: every reply sent", (CountMessages(Output, "ZZZL") == 24) && (CountMessages(Output, "ZZZN") == 11));
+    Check("query flood: nothing dropped", GTXQueueDrops == Drops);
+    while (TXReplySpace() != 0)                          // every reply place in use
+      QueueCATMessage(eZZZG, 0);
+    CATHandlePushbutton(5, true, false, TimebaseMicros());
+    Output = RunAndReceive(400);
+    Check("reply places full: button event kept", (Output.find("ZZZP051;") != std::string::npos)
+                                                  && (GTXQueueDrops == Drops));
+  }
+  HostSend("ZZZA10000;");
+  RunAndReceive(20);
+  HostSend("ZZZA20504;");
+  RunAndReceive(20);
+  CheckOutput("accelerated encoder", TurnEncoder(0, 8), "ZZZE011;ZZZE016;ZZZE016;ZZZE016;");
+  HostSend("ZZZA20599;");
+  RunAndReceive(20);
+  Output = TurnEncoder(0, 8);
+  Check("accelerated clicks beyond one message all sent", EncoderClicks(Output, 1) > 4 * 9);
+  HostSend("ZZZA20504;");
+  RunAndReceive(20);
+  SimPowerOn();
+  RunAndReceive(VLEDTESTTICKS);
+  HostSend("ZZZA;");
+  CheckOutput("acceleration kept in EEPROM", RunAndReceive(20), "ZZZA10000;ZZZA20504;");
+  HostSend("ZZZA20000;");
+  RunAndReceive(20);
+
+  HostSend("ZZZB;");
+  CheckOutput("baud rate query", RunAndReceive(20), "ZZZB0;");
+  SimSetHostBaudRate(9600);
+  {
+    unsigned long BlockedMicros = GSimStats.TXBlockedMicros;
+    int Cntr;
+
+    HostSend("ZZZB1;");
+    Output.clear();
+    for (Cntr = 0; (Cntr < 40) && (SimGetBaudRate() != 115200); Cntr++)
+    {
+      SimTurnEncoder(3, 1);                             // events keep coming
+      Output += RunAndReceive(1);
+    }
+    Check("baud rate change acknowledged at old rate", (Output.size() >= 6) && (Output.compare(Output.size() - 6, 6, "ZZZB1;") == 0)
+                                                       && (Output.find('\0') == std::string::npos));
+    Check("baud rate changed while events keep coming", SimGetBaudRate() == 115200);
+    Check("baud rate change never waits", GSimStats.TXBlockedMicros == BlockedMicros);
+    SimSetHostBaudRate(115200);
+    Output = RunAndReceive(20);
+    Check("events held for the new rate", (EncoderClicks(Output, 4) != 0) && (Output.find('\0') == std::string::npos));
+  }
+  HostSend("ZZZB;");
+  CheckOutput("baud rate confirmed", RunAndReceive(20), "ZZZB1;");
+  RunAndReceive(1100);
+  Check("confirmed baud rate kept", SimGetBaudRate() == 115200);
+  HostSend("ZZZB4;");
+  CheckOutput("second baud rate change acknowledged", RunAndReceive(20), "ZZZB4;");
+  RunAndReceive(1100);
+  Check("unconfirmed baud rate falls back to 9600", SimGetBaudRate() == 9600);
+  SimSetHostBaudRate(0);
+
+  {
+    SCATFrameDecoder Decoder;
+    InitCATFrameDecoder(&Decoder);
+    HostSend("ZZZF1;");
+    CheckOutput("frame mode set", RunAndReceive(20), "ZZZF1;");
+    CheckOutput("encoder frame", DecodeFrames(TurnEncoder(3, -2), &Decoder), "[1 3 -1]");
+    SimTurnVFO(42);
+    CheckOutput("VFO frame", DecodeFrames(RunAndReceive(20), &Decoder), "[0 0 42]");
+    SimSetKey(0, true);
+    Output = RunAndReceive(50);
+    SimSetKey(0, false);
+    Output += RunAndReceive(50);
+    CheckOutput("button frames", DecodeFrames(Output, &Decoder), "[2 4 1][2 4 0]");
+    HostSend("ZZZS;");
+    CheckOutput("replies still ASCII", DecodeFrames(RunAndReceive(20), &Decoder), "ZZZS0502009;");
+    Check("frame sequence numbers", (Decoder.Frames == 4) && (Decoder.Missed == 0) && (Decoder.CRCErrors == 0));
+    HostSend("ZZZF0;");
+    RunAndReceive(20);
+    CheckOutput("ASCII mode again", TurnEncoder(3, 2), "ZZZE041;");
+    HostSend("ZZZL;");                                  // keep the link busy, so events wait in the queue
+    Output = RunAndReceive(10);
+    SimTurnVFO(7);
+    Output += RunAndReceive(2);
+    HostSend("ZZZF1;");
+    Output += RunAndReceive(4);
+    SimTurnVFO(9);
+    Output += RunAndReceive(200);
+    Check("events queued before ZZZF1 stay ASCII", (Output.size() > 109) && (Output.compare(96, 13, "ZZZU07;ZZZF1;") == 0));
+    CheckOutput("events queued after ZZZF1 are frames", DecodeFrames(Output.substr(109), &Decoder), "[0 0 9]");
+    HostSend("ZZZF0;");
+    RunAndReceive(20);
+  }
+
+  {
+    unsigned long Before, Reported, Stamp;
+    size_t Pos;
+
+    HostSend("ZZZT;");
+    CheckOutput("timestamps off by default", RunAndReceive(20), "ZZZT0;");
+    HostSend("ZZZT1;ZZZT;");
+    CheckOutput("tick timestamps set", RunAndReceive(20), "ZZZT1;");
+    Before = TimebaseTicks();
+    SimSetKey(0, true);
+    Output = WaitForOutput(50);
+    Reported = TimebaseTicks();
+    Output += RunAndReceive(50);
+    Pos = Output.find("ZZZP041;ZZZC");
+    Stamp = (Pos == std::string::npos) ? 0 : strtoul(Output.c_str() + Pos + 12, NULL, 10);
+    Check("button event timestamped in ticks", (Pos != std::string::npos) && (Output.size() == Pos + 22)
+                                               && (Stamp >= Before) && (Stamp <= Reported));
+    Check("button stamped at its press edge, not after debounce", Stamp + 8 <= Reported);
+    SimSetKey(0, false);
+    RunAndReceive(50);
+    HostSend("ZZZV00;");
+    RunAndReceive(20);
+    Before = TimebaseTicks();
+    SimTurnVFO(5);
+    Output = WaitForOutput(20);
+    Reported = TimebaseTicks();
+    Output += RunAndReceive(20);
+    Stamp = strtoul(Output.c_str() + 11, NULL, 10);
+    Check("VFO event timestamped in ticks", (Output.compare(0, 11, "ZZZU05;ZZZC") == 0) && (Output.size() == 21)
+                                            && (Stamp >= Before) && (Stamp <= Reported));
+    Check("VFO steps stamped when seen, not after batching", (Stamp <= Before + 2) && (Reported >= Before + 5));
+    HostSend("ZZZV10;");
+    RunAndReceive(20);
+    HostSend("ZZZT2;");
+    RunAndReceive(20);
+    Before = TimebaseMicros();
+    Output = TurnEncoder(3, 2);
+    Stamp = strtoul(Output.c_str() + 12, NULL, 10);
+    Check("encoder event timestamped in us", (Output.compare(0, 12, "ZZZE041;ZZZC") == 0) && (Output.size() == 22)
+                                             && (Stamp > Before) && (Stamp <= Before + 4 * VTICKMICROS));
+    HostSend("ZZZT0;");
+    RunAndReceive(20);
+    CheckOutput("timestamps off again", TurnEncoder(3, 2), "ZZZE041;");
+  }
+
+  HostSend("ZZZI011;");
+  RunAndReceive(10);
+  Check("MCP LED lit", (SimGetMCPRegister(VMCPMATRIXADDR, IODIRA) & 0x80) == 0);
+  HostSend("ZZZI051;");
+  RunAndReceive(10);
+  Check("GPIO LED lit", SimGetPinOutput(VPININDICATOR5) == HIGH);
+  HostSend("ZZZI111;");
+  RunAndReceive(10);
+  Check("GPIO LED on a second port lit", (SimGetPinOutput(VPININDICATOR11) == HIGH)
+                                      && (SimGetPinOutput(VPININDICATOR5) == HIGH));
+  HostSend("ZZZI110;");
+  RunAndReceive(10);
+  Check("GPIO LED on a second port off", SimGetPinOutput(VPININDICATOR11) == LOW);
+  HostSend("ZZZI010;ZZZI050;");
+  RunAndReceive(20);
+  Check("LEDs cleared", ((SimGetMCPRegister(VMCPMATRIXADDR, IODIRA) & 0x80) != 0)
+                       && (SimGetPinOutput(VPININDICATOR5) == LOW));
+
+  {
+    uint64_t HighTime;
+    int Cntr, MCPLitTicks = 0;
+
+    HostSend("ZZZI051;ZZZL053;ZZZI011;ZZZL013;");
+    RunAndReceive(40);
+    HighTime = SimGetPinHighMicros(VPININDICATOR5);
+    for (Cntr = 0; Cntr < 70; Cntr++)                   // 140ms = 40 cycles of the GPIO LED planes
+    {
+      RunAndReceive(1);
+      if ((SimGetMCPRegister(VMCPMATRIXADDR, IODIRA) & 0x80) == 0)
+        MCPLitTicks++;
+    }
+    HighTime = SimGetPinHighMicros(VPININDICATOR5) - HighTime;
+    if (GVerbose)
+      printf("  LED level 3: GPIO LED lit %.1f%%, MCP LED lit %d of 70 ticks\n", HighTime / 1400.0, MCPLitTicks);
+    Check("GPIO LED level 3 of 7 brightness", (HighTime > 59000) && (HighTime < 61000));
+#ifdef MCPINTERRUPTS
+    Check("MCP LED level 3 lit all the time while the matrix is idle", MCPLitTicks == 70);
+#else
+    Check("MCP LED level 3 lit for 2 ticks in 3", (MCPLitTicks >= 46) && (MCPLitTicks <= 47));
+#endif
+    HostSend("ZZZL004;");                               // whole panel at 4/7: LED 5 at level 2
+    RunAndReceive(20);
+    HighTime = SimGetPinHighMicros(VPININDICATOR5);
+    RunAndReceive(70);
+    HighTime = SimGetPinHighMicros(VPININDICATOR5) - HighTime;
+    Check("panel brightness scales LED levels", (HighTime > 39000) && (HighTime < 41000));
+    HostSend("ZZZL007;ZZZL057;ZZZL017;ZZZI050;ZZZI010;");
+    RunAndReceive(40);
+    Check("LEDs cleared at full brightness", ((SimGetMCPRegister(VMCPMATRIXADDR, IODIRA) & 0x80) != 0)
+                                          && (SimGetPinOutput(VPININDICATOR5) == LOW));
+  }
+
+  {
+    unsigned long Writes, Transactions;
+    int Cntr, MCPLitTicks = 0;
+
+    HostSend("ZZZI051;ZZZI111;");                       // lit at full brightness: steady planes
+    RunAndReceive(40);
+    Writes = SimGetPinPortWrites(VPININDICATOR5) + SimGetPinPortWrites(VPININDICATOR11);
+    RunAndReceive(500);
+    Writes = SimGetPinPortWrites(VPININDICATOR5) + SimGetPinPortWrites(VPININDICATOR11) - Writes;
+    Check("lit LEDs at full brightness: LED ports not rewritten", (Writes == 0)
+          && (SimGetPinOutput(VPININDICATOR5) == HIGH) && (SimGetPinOutput(VPININDICATOR11) == HIGH));
+    HostSend("ZZZL053;");                               // partial brightness: the planes differ
+    RunAndReceive(40);
+    Writes = SimGetPinPortWrites(VPININDICATOR5);
+    RunAndReceive(500);
+    Writes = SimGetPinPortWrites(VPININDICATOR5) - Writes;
+    Check("LED at partial brightness: a port write per plane", (Writes >= 857) && (Writes <= 858));   // 2000 interrupts, 3 planes in 7
+    HostSend("ZZZL057;ZZZI050;ZZZI110;");
+    RunAndReceive(40);
+
+    HostSend("ZZZI011;ZZZL013;");                       // a dimmed MCP LED
+    RunAndReceive(100);
+    Transactions = GSimStats.SPITransactions;
+    for (Cntr = 0; Cntr < 5000; Cntr++)
+    {
+      RunAndReceive(1);
+      if ((SimGetMCPRegister(VMCPMATRIXADDR, IODIRA) & 0x80) == 0)
+        MCPLitTicks++;
+    }
+    Transactions = GSimStats.SPITransactions - Transactions;
+    if (GVerbose)
+      printf("  idle panel, dimmed MCP LED: %.1f SPI transactions/s, lit %d of 5000 ticks\n", Transactions / 10.0, MCPLitTicks);
+#ifdef MCPINTERRUPTS
+    Check("idle panel, dimmed MCP LED: SPI only for keep-alive reads", Transactions <= 50);
+    Check("idle panel, dimmed MCP LED: lit at full brightness", MCPLitTicks == 5000);
+#else
+    Check("dimmed MCP LED: lit for 2 ticks in 3", (MCPLitTicks >= 3332) && (MCPLitTicks <= 3334));
+#endif
+    HostSend("ZZZL017;ZZZI010;");
+    RunAndReceive(40);
+  }
+
+  {
+    uint64_t HighTime;
+    int Cntr, Mismatches = 0, Edges = 0, Previous;
+    unsigned long TXBytes;
+
+    HostSend("ZZZN0515;ZZZI051;");                      // LED 5 blinks with a 1s period
+    RunAndReceive(137);
+    HostSend("ZZZN0615;ZZZI061;ZZZN0725;ZZZI071;");     // set later: LED 6 blinks in step; LED 7 double flashes
+    RunAndReceive(60);
+    TXBytes = GSimStats.TXBytes;
+    HighTime = SimGetPinHighMicros(VPININDICATOR7);
+    Previous = SimGetPinOutput(VPININDICATOR5);
+    for (Cntr = 0; Cntr < 1000; Cntr++)                 // 2 periods
+    {
+      RunAndReceive(1);
+      if (SimGetPinOutput(VPININDICATOR5) != SimGetPinOutput(VPININDICATOR6))
+        Mismatches++;
+      if (SimGetPinOutput(VPININDICATOR5) != Previous)
+        Edges++;
+      Previous = SimGetPinOutput(VPININDICATOR5);
+    }
+    HighTime = SimGetPinHighMicros(VPININDICATOR7) - HighTime;
+    if (GVerbose)
+      printf("  blink: %d edges in 2s; double flash lit %.1f%%\n", Edges, HighTime / 20000.0);
+    Check("LED blinks with no host messages", (Edges == 4) && (GSimStats.TXBytes == TXBytes));
+    Check("LEDs with the same period blink in step", Mismatches == 0);
+    Check("LED double flashes", (HighTime > 460000) && (HighTime < 540000));   // 10ms LED task steps, 3.5ms BAM cycle
+    HostSend("ZZZN0832;ZZZI081;");                      // LED 8: 400ms pulse
+    RunAndReceive(30);
+    Check("pulse LED lit", SimGetPinOutput(VPININDICATOR8) == HIGH);
+    RunAndReceive(200);
+    Check("pulse LED switches itself off", SimGetPinOutput(VPININDICATOR8) == LOW);
+    HostSend("ZZZI081;");
+    RunAndReceive(20);
+    Check("pulse LED lit again", SimGetPinOutput(VPININDICATOR8) == HIGH);
+    HostSend("ZZZN;");
+    CheckOutput("LED patterns", RunAndReceive(100), "ZZZN0100;ZZZN0200;ZZZN0300;ZZZN0400;ZZZN0515;ZZZN0615;"
+                                                    "ZZZN0725;ZZZN0832;ZZZN0900;ZZZN1000;ZZZN1100;");
+    HostSend("ZZZN0500;ZZZN0600;ZZZN0700;ZZZI050;ZZZI060;ZZZI070;");
+    RunAndReceive(250);
+    Check("LEDs steady and off again", (SimGetPinOutput(VPININDICATOR5) == LOW) && (SimGetPinOutput(VPININDICATOR6) == LOW)
+                                    && (SimGetPinOutput(VPININDICATOR7) == LOW) && (SimGetPinOutput(VPININDICATOR8) == LOW));
+  }
+
+  HostSend("ZZZX024;ZZZL092;");
+  RunAndReceive(10);
+  HostSend("ZZZX;");
+  CheckOutput("encoder increment set", RunAndReceive(10), "ZZZX024;");
+  SimPowerOn();
+  RunAndReceive(VLEDTESTTICKS);
+  HostSend("ZZZX;");
+  CheckOutput("encoder increment kept in EEPROM", RunAndReceive(10), "ZZZX024;");
+  HostSend("ZZZL;");
+  CheckOutput("LED brightness kept in EEPROM", RunAndReceive(100),
+              "ZZZL007;ZZZL017;ZZZL027;ZZZL037;ZZZL047;ZZZL057;ZZZL067;ZZZL077;ZZZL087;ZZZL092;ZZZL107;ZZZL117;");
+  {
+    unsigned long Writes = GSimStats.EEPROMWrites;
+
+    HostSend("ZZZL095;");
+    RunAndReceive(10);
+    Check("setting change writes one EEPROM byte", GSimStats.EEPROMWrites == Writes + 1);
+    HostSend("ZZZL095;ZZZX024;");
+    RunAndReceive(10);
+    Check("unchanged settings write no EEPROM bytes", GSimStats.EEPROMWrites == Writes + 1);
+  }
+}
+
+
+
+//
+// return a monotonic time in nanoseconds
+//
+uint64_t HostNanoseconds(void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+
+//
+// benchmark: run the tasks individually, as scheduled by the task table,
+// with the panel in use (encoders and VFO turning, buttons pressed and CAT
+// queries arriving) and report the host time taken by each
+//
+void RunBenchmark(unsigned long Ticks)
+{
+  uint64_t TaskTime[eNumTasks] = {0};
+  uint64_t TaskSimTime[eNumTasks] = {0};                   // simulated time taken (waiting for SPI or the UART)
+  uint64_t Start, Time, SimTime, Total;
+  unsigned long Tick;
+  byte Task;
+
+  SimEraseEEPROM();
+  SimPowerOn();
+  SimRunTicks(VLEDTESTTICKS);
+  SimHostReceive();
+
+  Start = HostNanoseconds();
+  for (Tick = 0; Tick < Ticks; Tick++)
+  {
+    if ((Tick % 8) == 0)
+      SimTurnEncoder((Tick / 8) % VMAXSIMENCODERS, ((Tick / 800) & 1) ? -1 : 1);
+    if ((Tick % 4) == 0)
+      SimTurnVFO(((Tick / 2000) & 1) ? -1 : 1);
+    if ((Tick % 400) == 0)
+      SimSetKey((Tick / 400) % 8, true);
+    if ((Tick % 400) == 100)
+      SimSetKey((Tick / 400) % 8, false);
+    if ((Tick % 1000) == 0)
+      SimHostSend("ZZZS;");
+
+    SimAdvanceTime((unsigned long)(2000 - (SimGetMicros() % 2000)));
+    for (Task = 0; Task < eNumTasks; Task++)
+      if ((Tick % GTasks[Task].Period) == GTasks[Task].Phase)
+      {
+        Time = HostNanoseconds();
+        SimTime = SimGetMicros();
+        GTasks[Task].Function();
+        TaskTime[Task] += HostNanoseconds() - Time;
+        TaskSimTime[Task] += SimGetMicros() - SimTime;
+      }
+    SPITickEnd();
+    if ((Tick % 64) == 0)
+      SimHostReceive();
+  }
+  Total = HostNanoseconds() - Start;
+
+  printf("%lu ticks in %.3f s: %.0f ticks/s\n", Ticks, Total / 1e9, Ticks / (Total / 1e9));
+  for (Task = 0; Task < eNumTasks; Task++)
+    printf("  %-14s every %3d ticks %8.1f ns/tick  %6.2f us/tick simulated\n", GTasks[Task].Name, GTasks[Task].Period,
+           (double)TaskTime[Task] / Ticks, (double)TaskSimTime[Task] / Ticks);
+  printf("SPI transactions/tick %.2f; SPI bus %.2f us/tick; CAT bytes sent %lu; TX blocked %lu us\n",
+         (double)GSimStats.SPITransactions / Ticks, (double)GSimStats.SPIBusMicros / Ticks,
+         GSimStats.TXBytes, GSimStats.TXBlockedMicros);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+  int Arg;
+  unsigned long BenchTicks = 0;
+
+  for (Arg = 1; Arg < argc; Arg++)
+  {
+    if ((strcmp(argv[Arg], "-b") == 0) && (Arg + 1 < argc))
+      BenchTicks = strtoul(argv[++Arg], NULL, 0);
+    else if (strcmp(argv[Arg], "-v") == 0)
+      GVerbose = true;
+    else
+    {
+      printf("usage: panelsim [-v] [-b ticks]\n");
+      return 2;
+    }
+  }
+
+  if (BenchTicks)
+  {
+    RunBenchmark(BenchTicks);
+    return 0;
+  }
+  RunScenario();
+  return CheckSummary();
+}
@@ -0,0 +1,256 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// ptytest.cpp
+// tests CAT baud rate negotiation (ZZZB) through a pseudo terminal pair
+// the simulated panel runs in real time on the pty master; a forked host
+// process opens the pty slave as a serial port and negotiates with termios,
+// as the host program would on a real serial port.
+// the pty carries bytes at any speed, so the bridge reads the slave's
+// baud rate from the master and sends bytes as nulls if it doesn't
+// match the panel's rate.
+//
+// ptytest
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <string>
+#include "simhardware.h"
+#include "simtest.h"
+
+
+#define VREPLYTIMEOUTMS 1000                // host wait for a reply
+#define VCONFIRMTIMEOUTMS 2000              // panel waits this long for the new rate to be confirmed
+#define VBAUDSETTLEMS 10                    // panel changes rate within this of its reply (see tiger.h)
+
+
+struct SBaudCode
+{
+  unsigned long Baud;
+  speed_t Speed;
+};
+
+const SBaudCode GBaudCodes[] =
+{
+  {9600, B9600},
+  {115200, B115200},
+  {230400, B230400},
+  {250000, 0},                              // no termios constant
+  {500000, B500000},
+  {1000000, B1000000}
+};
+
+
+uint64_t HostMilliseconds(void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (uint64_t)Now.tv_sec * 1000ULL + Now.tv_nsec / 1000000;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//
+// host end: what a host program needs to do to use a faster CAT link
+//
+
+//
+// set the serial port speed
+//
+bool SetPortSpeed(int Port, speed_t Speed)
+{
+  struct termios Settings;
+
+  if (tcgetattr(Port, &Settings) != 0)
+    return false;
+  cfmakeraw(&Settings);
+  cfsetispeed(&Settings, Speed);
+  cfsetospeed(&Settings, Speed);
+  return (tcsetattr(Port, TCSADRAIN, &Settings) == 0);
+}
+
+
+//
+// send a command and wait for a reply with the same 4 character command
+// returns the reply, or "" if none arrived in time. Nulls (framing errors) are skipped
+//
+std::string Transact(int Port, const char* Cmd, unsigned int TimeoutMs)
+{
+  std::string Input;
+  char Buffer[64];
+  uint64_t End = HostMilliseconds() + TimeoutMs;
+  size_t Start, Semicolon;
+  int Count, Cntr;
+
+  tcflush(Port, TCIFLUSH);
+  if (write(Port, Cmd, strlen(Cmd)) < 0)
+    return "";
+  while (HostMilliseconds() < End)
+  {
+    struct pollfd Poll = {Port, POLLIN, 0};
+    if (poll(&Poll, 1, 10) <= 0)
+      continue;
+    Count = read(Port, Buffer, sizeof(Buffer));
+    for (Cntr = 0; Cntr < Count; Cntr++)
+      if (Buffer[Cntr] != 0)
+        Input += Buffer[Cntr];
+    Start = Input.find(std::string(Cmd, 4));
+    if (Start != std::string::npos)
+    {
+      Semicolon = Input.find(';', Start);
+      if (Semicolon != std::string::npos)
+        return Input.substr(Start, Semicolon - Start + 1);
+    }
+  }
+  return "";
+}
+
+
+//
+// negotiate a new baud rate:
+// ask for it at the current rate, change rate when it is acknowledged,
+// wait for the panel to change too, then confirm with a query at the new rate
+//
+bool NegotiateBaud(int Port, int Code)
+{
+  char Cmd[16];
+
+  snprintf(Cmd, sizeof(Cmd), "ZZZB%d;", Code);
+  if (Transact(Port, Cmd, VREPLYTIMEOUTMS) != Cmd)
+    return false;
+  if (!SetPortSpeed(Port, GBaudCodes[Code].Speed))
+    return false;
+  usleep(VBAUDSETTLEMS * 1000);
+  return (Transact(Port, "ZZZB;", VREPLYTIMEOUTMS) == Cmd);
+}
+
+
+//
+// the host test sequence
+//
+int RunHost(const char* PortName)
+{
+  int Port;
+  uint64_t End;
+  std::string Reply;
+
+  Port = open(PortName, O_RDWR | O_NOCTTY);
+  if ((Port < 0) || !SetPortSpeed(Port, B9600))
+  {
+    printf("FAIL: can't open %s\n", PortName);
+    return 1;
+  }
+
+  End = HostMilliseconds() + 5000;                // wait for the panel self test
+  do
+    Reply = Transact(Port, "ZZZS;", 200);
+  while ((Reply == "") && (HostMilliseconds() < End));
+  Check("panel answers at 9600", Reply == "ZZZS0502009;");
+
+  Check("negotiate 115200", NegotiateBaud(Port, 1));
+  Check("version query at 115200", Transact(Port, "ZZZS;", VREPLYTIMEOUTMS) == "ZZZS0502009;");
+  Check("negotiate 1000000", NegotiateBaud(Port, 5));
+  Check("version query at 1000000", Transact(Port, "ZZZS;", VREPLYTIMEOUTMS) == "ZZZS0502009;");
+  SetPortSpeed(Port, B9600);
+  Check("no reply at the wrong rate", Transact(Port, "ZZZS;", 200) == "");
+
+  usleep((VCONFIRMTIMEOUTMS + 500) * 1000);       // 1Mbaud was confirmed, so no fall back
+  Check("panel stays at 1000000 once confirmed", Transact(Port, "ZZZS;", 200) == "");
+  SetPortSpeed(Port, B1000000);
+  Check("negotiate 9600", NegotiateBaud(Port, 0));
+
+  SetPortSpeed(Port, B9600);
+  Check("request 230400 acknowledged", Transact(Port, "ZZZB2;", VREPLYTIMEOUTMS) == "ZZZB2;");
+  usleep((VCONFIRMTIMEOUTMS + 500) * 1000);       // don't confirm
+  Check("fall back to 9600 without confirmation", Transact(Port, "ZZZB;", VREPLYTIMEOUTMS) == "ZZZB0;");
+
+  close(Port);
+  return CheckSummary();
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////
+//
+// panel end: run the simulation in real time, bridged to the pty master
+//
+
+//
+// get the baud rate the slave end is set to
+//
+unsigned long GetPortBaud(int Master)
+{
+  struct termios Settings;
+  speed_t Speed;
+  unsigned int Cntr;
+
+  if (tcgetattr(Master, &Settings) != 0)
+    return 0;
+  Speed = cfgetospeed(&Settings);
+  for (Cntr = 0; Cntr < sizeof(GBaudCodes) / sizeof(GBaudCodes[0]); Cntr++)
+    if ((GBaudCodes[Cntr].Speed == Speed) && (Speed != 0))
+      return GBaudCodes[Cntr].Baud;
+  return 1;                                         // unknown rate: never matches
+}
+
+
+int RunPanel(int Master, pid_t Host)
+{
+  uint64_t Start;
+  uint64_t RealMicros;
+  char Buffer[256];
+  std::string Output;
+  int Count, Status;
+
+  SimEraseEEPROM();
+  SimPowerOn();
+  Start = HostMilliseconds() * 1000 - SimGetMicros();
+  while (waitpid(Host, &Status, WNOHANG) == 0)
+  {
+    RealMicros = HostMilliseconds() * 1000 - Start;
+    SimSetHostBaudRate(GetPortBaud(Master));
+    while ((Count = read(Master, Buffer, sizeof(Buffer) - 1)) > 0)
+    {
+      Buffer[Count] = 0;
+      SimHostSend(Buffer);
+    }
+    while (SimGetMicros() + 2000 <= RealMicros)
+      SimRunTicks(1);
+    Output = SimHostReceive();
+    if (Output.size() && (write(Master, Output.data(), Output.size()) < 0))
+      return 1;
+    usleep(500);
+  }
+  return WIFEXITED(Status) ? WEXITSTATUS(Status) : 1;
+}
+
+
+
+int main(int argc, char* argv[])
+{
+  int Master;
+  pid_t Host;
+
+  Master = posix_openpt(O_RDWR | O_NOCTTY);
+  if ((Master < 0) || (grantpt(Master) != 0) || (unlockpt(Master) != 0))
+  {
+    printf("can't create a pseudo terminal\n");
+    return 1;
+  }
+  fcntl(Master, F_SETFL, O_NONBLOCK);
+  Host = fork();
+  if (Host == 0)
+    return RunHost(ptsname(Master));
+  return RunPanel(Master, Host);
+}
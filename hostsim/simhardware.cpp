@@ -0,0 +1,1131 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// simhardware.cpp
+// simulated Nano Every and front panel hardware
+// this implements the host versions of Arduino.h, SPI.h and EEPROM.h
+/////////////////////////////////////////////////////////////////////////
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "EEPROM.h"
+#include "simhardware.h"
+#include "iopins.h"
+#include "SPIdata.h"
+
+
+//
+// peripheral registers, library objects and statistics
+//
+TCB_t TCB0;
+TCA_t TCA0;
+PORT_t PORTA;
+VPORT_t VPORTA(0);
+VPORT_t VPORTB(1);
+VPORT_t VPORTC(2);
+VPORT_t VPORTD(3);
+VPORT_t VPORTE(4);
+VPORT_t VPORTF(5);
+SPI_t SPI0;
+HardwareSerial Serial;
+HardwareSerial Serial1;
+SPIClass SPI;
+EEPROMClass EEPROM;
+SSimStatistics GSimStats;
+
+
+//
+// simulated clock and interrupt state
+//
+uint64_t GSimMicros;                            // time since power on
+uint64_t GSimNextTick;                          // time of next TCB0 interrupt; 0 if timer not running
+bool GSimInterruptsEnabled;                     // global interrupt enable
+bool GSimInISR;                                 // true while an interrupt handler runs
+bool GSimTickPending;                           // TCB0 interrupt waiting for interrupts to be enabled
+bool GSimVFOPending;                            // PORTA interrupt waiting for interrupts to be enabled
+void (*GSimInterruptHook)(void);                // called when interrupts are re-enabled
+unsigned int GSimTimerLatency;                  // TCB0.CNT when its interrupt is delivered
+extern volatile unsigned long GTimebaseTicks;   // advanced by the sketch's timer interrupt when a tick is due
+extern unsigned long GTicksHandled;             // GTimebaseTicks when the sketch's main loop last ran a tick
+extern void SPI0_INT_vect(void) __attribute__((weak));   // only if the sketch uses the SPI interrupt
+
+
+//
+// SPI0 byte transfers: the byte is exchanged with the selected MCP23S17 when
+// DATA is written, and the transfer completes (setting IF) 8 SPI clocks later
+//
+uint64_t GSimSPIDone;                           // time the byte being sent completes; 0 if none
+byte GSimSPIReceived;                           // byte received by the last transfer
+bool GSimSPIFlag;                               // SPI0 IF
+unsigned long GSimLibrarySPIClock = 4000000;    // SPI library clock from its last beginTransaction
+
+
+//
+// I/O pins
+// external drive: -1 = not driven (pullup or float), else 0 or 1
+//
+byte GSimPinMode[VSIMNUMPINS];
+byte GSimPinOut[VSIMNUMPINS];
+unsigned long GSimPinWrites[VSIMNUMPINS];      // output writes made by the sketch, per pin
+unsigned long GSimPinPortWrites[VSIMNUMPINS];  // VPORT output writes that include each pin
+uint64_t GSimPinHighMicros[VSIMNUMPINS];       // time each output has been high, up to GSimPinHighSince
+uint64_t GSimPinHighSince[VSIMNUMPINS];        // time it last went high
+signed char GSimPinExternal[VSIMNUMPINS];
+
+
+//
+// panel controls
+//
+int GSimEncoderPosition[VMAXSIMENCODERS];       // quadrature edge count for each encoder
+int GSimVFOPosition;                            // quadrature edge count for VFO encoder
+unsigned long GSimKeys;                         // 1 bit per matrix scan code; 1 = pressed
+
+//
+// quadrature sequence for a mechanical encoder, as 2 bit state (bit 0 = A, bit 1 = B)
+// and for the VFO encoder as PORTA bits 3:2
+//
+const byte GSimQuadrature[4] = {0b00, 0b10, 0b11, 0b01};
+const byte GSimVFOQuadrature[4] = {0b0000, 0b1000, 0b1100, 0b0100};
+
+//
+// bit position of each encoder in the 16 bit MCP23S17 #0 input word
+// (encoders 8 and 9 are direct wired)
+//
+const byte GSimEncoderBitPosition[8] = {6, 4, 2, 0, 14, 12, 10, 8};
+
+
+//
+// EEPROM
+//
+byte GSimEEPROM[VSIMEEPROMSIZE];
+
+
+//
+// CAT UART
+// the "wire" holds bytes sent by the host but not yet arrived at the panel
+// baud rate timing is kept as a running count of bit-microseconds
+//
+#define VSIMRXBUFSIZE 64
+#define VSIMTXBUFSIZE SERIAL_TX_BUFFER_SIZE
+unsigned long GSimBaud;
+unsigned long GSimHostBaud;                     // host UART rate; 0 = always the same as the panel
+std::string GSimHostToPanel;                    // on the wire to the panel
+std::string GSimRXBuffer;                       // in panel UART RX buffer
+std::string GSimTXBuffer;                       // in panel UART TX buffer
+std::string GSimPanelToHost;                    // arrived at the host
+uint64_t GSimRXBitCredit;
+uint64_t GSimTXBitCredit;
+
+
+
+
+/////////////////////////////////////////////////////////////////////////
+//
+// MCP23S17 model
+// registers as for IOCON.BANK=0. Only the features the panel uses are modelled:
+// direction, polarity, pullups, output latch, sequential addressing and
+// interrupt on change. Pin levels are checked for interrupts whenever an
+// input or register changes: the first change latches INTF and INTCAP,
+// which hold until INTCAP or GPIO of that port is read. The INT outputs are
+// modelled as open drain, wired together to VPINMCPINT
+//
+class SimMCP23S17
+{
+public:
+  void Reset(void);
+  void Select(void);
+  byte Transfer(byte Data);
+  byte ReadRegister(byte Address);
+  void WriteRegister(byte Address, byte Value);
+  void UpdateInterrupts(void);
+  bool InterruptAsserted(void);
+  unsigned int ExternalInputs;                  // pin levels driven from outside; 1 = high
+  bool IsMatrix;                                // true if this chip drives the switch matrix
+  byte Reg[0x16];
+
+protected:
+  byte PortLevels(byte Port);
+  void ClearInterrupt(byte Port);
+  byte PreviousLevels[2];                       // pin levels at the last interrupt check
+  byte ByteCount;
+  byte Opcode;
+  byte Address;
+};
+
+SimMCP23S17 GSimMCP[2];
+signed char GSimSelectedMCP = -1;
+
+
+void SimMCP23S17::Reset(void)
+{
+  memset(Reg, 0, sizeof(Reg));
+  Reg[IODIRA] = 0xFF;
+  Reg[IODIRB] = 0xFF;
+  ExternalInputs = 0xFFFF;
+  ByteCount = 0;
+  PreviousLevels[0] = PortLevels(0);
+  PreviousLevels[1] = PortLevels(1);
+}
+
+
+//
+// chip select asserted: a new opcode follows
+//
+void SimMCP23S17::Select(void)
+{
+  ByteCount = 0;
+}
+
+
+//
+// pin levels on a port (0=A, 1=B)
+// outputs show the output latch; inputs the external drive, or pullup
+// for the matrix chip, the row inputs on port B are pulled low by any pressed key
+// in a column that is driven as a low output
+//
+byte SimMCP23S17::PortLevels(byte Port)
+{
+  byte Direction, Latch, External;
+  byte Column, Row;
+
+  Direction = Reg[IODIRA + Port];
+  Latch = Reg[OLATA + Port];
+  External = (byte)(ExternalInputs >> (Port * 8));
+  if (IsMatrix && (Port == 1))
+  {
+    for (Column = 0; Column < 4; Column++)
+      if (((Reg[IODIRA] & (1 << Column)) == 0) && ((Reg[OLATA] & (1 << Column)) == 0))
+        for (Row = 0; Row < 8; Row++)
+          if (GSimKeys & (1UL << ((Column << 3) + Row)))
+            External &= ~(1 << Row);
+  }
+  return (Direction & External) | (~Direction & Latch);
+}
+
+
+//
+// check each port for an interrupt condition: an enabled pin different from
+// DEFVAL (INTCON bit set) or from its previous level (INTCON bit clear).
+// a new interrupt is only latched if the port has none pending
+//
+void SimMCP23S17::UpdateInterrupts(void)
+{
+  byte Port, Levels, Reference, Condition;
+
+  for (Port = 0; Port < 2; Port++)
+  {
+    Levels = PortLevels(Port);
+    Reference = (Reg[INTCONA + Port] & Reg[DEFVALA + Port]) | (~Reg[INTCONA + Port] & PreviousLevels[Port]);
+    Condition = (Levels ^ Reference) & Reg[GPINTENA + Port];
+    if ((Condition != 0) && (Reg[INTFA + Port] == 0))
+    {
+      Reg[INTFA + Port] = Condition;
+      Reg[INTCAPA + Port] = Levels;
+    }
+    PreviousLevels[Port] = Levels;
+  }
+}
+
+
+//
+// INTCAP or GPIO read: clear the port's interrupt
+// (a DEFVAL condition still present interrupts again straight away)
+//
+void SimMCP23S17::ClearInterrupt(byte Port)
+{
+  Reg[INTFA + Port] = 0;
+  UpdateInterrupts();
+}
+
+
+//
+// true if the INTA output is asserted (port A's interrupt, or either with IOCON.MIRROR)
+//
+bool SimMCP23S17::InterruptAsserted(void)
+{
+  if (Reg[IOCON] & VIOCONMIRROR)
+    return (Reg[INTFA] | Reg[INTFB]) != 0;
+  return Reg[INTFA] != 0;
+}
+
+
+byte SimMCP23S17::ReadRegister(byte Address)
+{
+  byte Port = Address & 1;
+  byte Value;
+
+  if (Address == IOCON + 1)
+    Address = IOCON;
+  if ((Address == GPIOA) || (Address == GPIOB))
+  {
+    Value = PortLevels(Port) ^ (Reg[IPOLA + Port] & Reg[IODIRA + Port]);
+    ClearInterrupt(Port);
+    return Value;
+  }
+  Value = Reg[Address];
+  if ((Address == INTCAPA) || (Address == INTCAPB))
+    ClearInterrupt(Port);
+  return Value;
+}
+
+
+void SimMCP23S17::WriteRegister(byte Address, byte Value)
+{
+  if (Address == IOCON + 1)
+    Address = IOCON;
+  if ((Address == GPIOA) || (Address == GPIOB))
+    Address += (OLATA - GPIOA);
+  if ((Address == INTFA) || (Address == INTFB) || (Address == INTCAPA) || (Address == INTCAPB))
+    return;                                                   // read only
+  Reg[Address] = Value;
+  UpdateInterrupts();                                         // outputs, or interrupt settings, changed
+}
+
+
+//
+// one SPI byte: opcode, register address, then data with address increment
+//
+byte SimMCP23S17::Transfer(byte Data)
+{
+  byte Result = 0;
+
+  if (ByteCount == 0)
+    Opcode = Data;
+  else if (ByteCount == 1)
+    Address = Data % 0x16;
+  else
+  {
+    if (Opcode & 1)
+      Result = ReadRegister(Address);
+    else
+      WriteRegister(Address, Data);
+    if (Reg[IOCON] & 0x20)                                    // SEQOP set: toggle within register pair
+      Address ^= 1;
+    else if (++Address >= 0x16)
+      Address = 0;
+  }
+  if (ByteCount < 2)
+    ByteCount++;
+  return Result;
+}
+
+
+
+
+/////////////////////////////////////////////////////////////////////////
+//
+// interrupts and time
+//
+
+//
+// deliver any interrupts that are pending, if enabled
+//
+void SimDeliverInterrupts(void)
+{
+  if (!GSimInterruptsEnabled || GSimInISR)
+    return;
+  GSimInISR = true;
+  if (GSimVFOPending)
+  {
+    GSimVFOPending = false;
+    GSimStats.VFOInterrupts++;
+    PORTA_PORT_vect();
+  }
+  if (GSimTickPending)
+  {
+    GSimTickPending = false;
+    GSimStats.TicksFired++;
+    TCB0.CNT = GSimTimerLatency;
+    TCB0_INT_vect();
+    TCB0.INTFLAGS &= ~TCB_CAPT_bm;                            // the handler writes 1 to clear the flag
+  }
+  if (GSimSPIFlag && (SPI0.INTCTRL & SPI_IE_bm) && SPI0_INT_vect)
+    SPI0_INT_vect();
+  GSimInISR = false;
+}
+
+
+void noInterrupts(void)
+{
+  if (!GSimInISR)                                             // already disabled in a handler
+    GSimInterruptsEnabled = false;
+}
+
+
+void interrupts(void)
+{
+  GSimInterruptsEnabled = true;
+  if (GSimInterruptHook && !GSimInISR)
+    GSimInterruptHook();
+  SimDeliverInterrupts();
+}
+
+
+SSimSREG SREG;
+
+SSimSREG::operator byte() const
+{
+  return (GSimInterruptsEnabled && !GSimInISR) ? 0x80 : 0;
+}
+
+
+SSimSREG& SSimSREG::operator=(byte Value)
+{
+  if (Value & 0x80)
+    interrupts();
+  else
+    noInterrupts();
+  return *this;
+}
+
+
+void SimSetInterruptHook(void (*Hook)(void))
+{
+  GSimInterruptHook = Hook;
+}
+
+
+void SimSetTimerLatency(unsigned int Counts)
+{
+  GSimTimerLatency = Counts;
+}
+
+
+//
+// TCB0 period in microseconds
+// TCB0 is clocked from TCA0; TCA0 prescales the 16MHz CPU clock
+//
+unsigned long SimTickPeriod(void)
+{
+  unsigned long Prescale;
+
+  switch (TCA0.SINGLE.CTRLA & 0x0E)
+  {
+    case TCA_SINGLE_CLKSEL_DIV1_gc: Prescale = 1; break;
+    case TCA_SINGLE_CLKSEL_DIV8_gc: Prescale = 8; break;
+    default: Prescale = 64; break;
+  }
+  if ((TCB0.CTRLA & 0x06) != TCB_CLKSEL_CLKTCA_gc)
+    Prescale = 1;
+  return ((unsigned long)(TCB0.CCMP + 1) * Prescale) / 16;            // compare mode: CCMP + 1 counts
+}
+
+
+//
+// a byte sent at one baud rate and received at another arrives as a framing error,
+// modelled as a null (a control character, so the CAT parser abandons the line)
+//
+char SimLinkByte(char Ch)
+{
+  if ((GSimHostBaud != 0) && (GSimHostBaud != GSimBaud))
+    Ch = 0;
+  return Ch;
+}
+
+
+//
+// move bytes across the serial link for the time elapsed
+void SimSerialAdvance(unsigned long Microseconds)
+{
+  uint64_t ByteTime = 10ULL * 1000000ULL;             // 10 bits per byte, in bit-microseconds
+
+  if (GSimBaud == 0)
+    return;
+  GSimTXBitCredit += (uint64_t)Microseconds * GSimBaud;
+  while ((GSimTXBitCredit >= ByteTime) && (GSimTXBuffer.size() != 0))
+  {
+    GSimPanelToHost += SimLinkByte(GSimTXBuffer[0]);
+    GSimTXBuffer.erase(0, 1);
+    GSimTXBitCredit -= ByteTime;
+  }
+  if (GSimTXBuffer.size() == 0)
+    GSimTXBitCredit = 0;                              // an idle line doesn't save up
+
+  GSimRXBitCredit += (uint64_t)Microseconds * GSimBaud;
+  while ((GSimRXBitCredit >= ByteTime) && (GSimHostToPanel.size() != 0))
+  {
+    if (GSimRXBuffer.size() < VSIMRXBUFSIZE)
+      GSimRXBuffer += SimLinkByte(GSimHostToPanel[0]);
+    else
+      GSimStats.RXDropped++;
+    GSimHostToPanel.erase(0, 1);
+    GSimRXBitCredit -= ByteTime;
+  }
+  if (GSimHostToPanel.size() == 0)
+    GSimRXBitCredit = 0;
+}
+
+
+//
+// advance time, stopping at each TCB0 interrupt
+//
+void SimAdvanceTime(unsigned long Microseconds)
+{
+  uint64_t EndTime = GSimMicros + Microseconds;
+  uint64_t StepEnd;
+  bool TimerOn;
+
+  while (GSimMicros < EndTime)
+  {
+    TimerOn = (TCB0.CTRLA & TCB_ENABLE_bm) && (TCB0.INTCTRL & TCB_CAPT_bm) && (SimTickPeriod() != 0);
+    if (!TimerOn)
+      GSimNextTick = 0;
+    else if (GSimNextTick == 0)
+      GSimNextTick = GSimMicros + SimTickPeriod();
+
+    StepEnd = EndTime;
+    if (GSimNextTick && (GSimNextTick < StepEnd))
+      StepEnd = GSimNextTick;
+    if (GSimSPIDone && (GSimSPIDone < StepEnd))
+      StepEnd = GSimSPIDone;
+    SimSerialAdvance((unsigned long)(StepEnd - GSimMicros));
+    GSimMicros = StepEnd;
+    if (GSimNextTick)                                         // timer count since the last match
+      TCB0.CNT = (uint16_t)((SimTickPeriod() - (GSimNextTick - GSimMicros)) * (TCB0.CCMP + 1UL) / SimTickPeriod());
+    if (GSimSPIDone && (GSimMicros == GSimSPIDone))
+    {
+      GSimSPIDone = 0;
+      GSimSPIFlag = true;
+      SimDeliverInterrupts();
+    }
+    if (GSimNextTick && (GSimMicros == GSimNextTick))
+    {
+      GSimNextTick += SimTickPeriod();
+      TCB0.INTFLAGS |= TCB_CAPT_bm;
+      GSimTickPending = true;
+      SimDeliverInterrupts();
+    }
+  }
+}
+
+
+uint64_t SimGetMicros(void)
+{
+  return GSimMicros;
+}
+
+
+unsigned long millis(void)
+{
+  return (unsigned long)(GSimMicros / 1000);
+}
+
+
+unsigned long micros(void)
+{
+  return (unsigned long)GSimMicros;
+}
+
+
+void delay(unsigned long Milliseconds)
+{
+  SimAdvanceTime(Milliseconds * 1000);
+}
+
+
+void delayMicroseconds(unsigned int Microseconds)
+{
+  SimAdvanceTime(Microseconds);
+}
+
+
+//
+// run N ticks: wait for the timer interrupt that triggers the tick (the timer
+// runs several times per tick to sample inputs), then run the main loop
+// if the timer isn't running, just advance 2ms
+//
+void SimRunTicks(unsigned long Ticks)
+{
+  while (Ticks--)
+  {
+    if (GSimNextTick <= GSimMicros)
+      SimAdvanceTime(2000);
+    else
+      while ((GTimebaseTicks == GTicksHandled) && (GSimNextTick > GSimMicros))
+        SimAdvanceTime((unsigned long)(GSimNextTick - GSimMicros));
+    loop();
+  }
+}
+
+
+
+
+/////////////////////////////////////////////////////////////////////////
+//
+// I/O pins
+//
+
+//
+// update PORTA input register from the pin levels of A4 (PA2) and A5 (PA3)
+// and raise a pin change interrupt if enabled for a changed pin
+//
+void SimUpdatePORTA(void)
+{
+  byte NewIn;
+  byte Changed;
+
+  NewIn = PORTA.IN & ~0b00001100;
+  if (digitalRead(A4))
+    NewIn |= 0b00000100;
+  if (digitalRead(A5))
+    NewIn |= 0b00001000;
+  Changed = NewIn ^ PORTA.IN;
+  PORTA.IN = NewIn;
+  if (((Changed & 0b00000100) && ((PORTA.PIN2CTRL & PORT_ISC_gm) == PORT_ISC_BOTHEDGES_gc))
+   || ((Changed & 0b00001000) && ((PORTA.PIN3CTRL & PORT_ISC_gm) == PORT_ISC_BOTHEDGES_gc)))
+  {
+    PORTA.INTFLAGS |= Changed;
+    GSimVFOPending = true;
+    SimDeliverInterrupts();
+  }
+}
+
+
+void SimSetPinExternal(byte Pin, signed char Level)
+{
+  if (Pin < VSIMNUMPINS)
+    GSimPinExternal[Pin] = Level;
+  if ((Pin == A4) || (Pin == A5))
+    SimUpdatePORTA();
+}
+
+
+//
+// Nano Every pin for each VPORT bit (0xFF = not brought out to a pin)
+//
+const byte GSimPortPins[6][8] =
+{
+  {2, 7, A4, A5, 0xFF, 0xFF, 0xFF, 0xFF},                     // PA0-PA3
+  {9, 10, 5, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},                   // PB0-PB2
+  {0xFF, 0xFF, 0xFF, 0xFF, 1, 0, 4, 0xFF},                    // PC4-PC6
+  {A3, A2, A1, A0, A6, A7, 0xFF, 0xFF},                       // PD0-PD5
+  {11, 12, 13, 8, 0xFF, 0xFF, 0xFF, 0xFF},                    // PE0-PE3
+  {0xFF, 0xFF, 0xFF, 0xFF, 6, 3, 0xFF, 0xFF}                  // PF4-PF5
+};
+
+VPORT_t* const GSimVPorts[6] = {&VPORTA, &VPORTB, &VPORTC, &VPORTD, &VPORTE, &VPORTF};
+
+
+//
+// keep the VPORT output registers in step with a digitalWrite()
+//
+void SimSetVPortBit(byte Pin, byte Value)
+{
+  byte Port, Bit;
+
+  for (Port = 0; Port < 6; Port++)
+    for (Bit = 0; Bit < 8; Bit++)
+      if (GSimPortPins[Port][Bit] == Pin)
+      {
+        if (Value)
+          GSimVPorts[Port]->OUT.Value |= (1 << Bit);
+        else
+          GSimVPorts[Port]->OUT.Value &= ~(1 << Bit);
+      }
+}
+
+
+//
+// drive an output pin: the chip select pins select an MCP23S17
+//
+void SimDrivePin(byte Pin, byte Value)
+{
+  if ((Pin == VPINMCPCS0) || (Pin == VPINMCPCS1))
+  {
+    byte Chip = (Pin == VPINMCPCS0) ? 0 : 1;
+    if ((Value == LOW) && (GSimPinOut[Pin] != LOW))
+    {
+      GSimSelectedMCP = Chip;
+      GSimMCP[Chip].Select();
+      GSimStats.SPITransactions++;
+    }
+    else if ((Value != LOW) && (GSimSelectedMCP == Chip))
+      GSimSelectedMCP = -1;
+  }
+  if (Value && (GSimPinOut[Pin] == LOW))
+    GSimPinHighSince[Pin] = GSimMicros;
+  else if (!Value && (GSimPinOut[Pin] != LOW))
+    GSimPinHighMicros[Pin] += GSimMicros - GSimPinHighSince[Pin];
+  GSimPinOut[Pin] = Value ? HIGH : LOW;
+  GSimPinWrites[Pin]++;
+}
+
+
+//
+// VPORT output write: each pin whose bit changed is driven as by digitalWrite()
+// Written = the bits the instruction writes (all of them, except for a single bit set or clear)
+//
+SimVPortOut& SimVPortOut::Write(uint8_t NewValue, uint8_t Written)
+{
+  byte Changed = Value ^ NewValue;
+  byte Bit;
+
+  Value = NewValue;
+  for (Bit = 0; Bit < 8; Bit++)
+  {
+    if (GSimPortPins[Port][Bit] == 0xFF)
+      continue;
+    if (Written & (1 << Bit))
+      GSimPinPortWrites[GSimPortPins[Port][Bit]]++;
+    if (Changed & (1 << Bit))
+      SimDrivePin(GSimPortPins[Port][Bit], (NewValue >> Bit) & 1);
+  }
+  return *this;
+}
+
+
+void pinMode(uint8_t Pin, uint8_t Mode)
+{
+  if (Pin < VSIMNUMPINS)
+    GSimPinMode[Pin] = Mode;
+}
+
+
+void digitalWrite(uint8_t Pin, uint8_t Value)
+{
+  if (Pin >= VSIMNUMPINS)
+    return;
+  SimDrivePin(Pin, Value);
+  SimSetVPortBit(Pin, Value);
+}
+
+
+int digitalRead(uint8_t Pin)
+{
+  if (Pin >= VSIMNUMPINS)
+    return LOW;
+  if (GSimPinMode[Pin] == OUTPUT)
+    return GSimPinOut[Pin];
+  if ((Pin == VPINMCPINT) && (GSimMCP[0].InterruptAsserted() || GSimMCP[1].InterruptAsserted()))
+    return LOW;                                               // open drain MCP23S17 interrupt outputs
+  if (GSimPinExternal[Pin] >= 0)
+    return GSimPinExternal[Pin];
+  return (GSimPinMode[Pin] == INPUT_PULLUP) ? HIGH : LOW;
+}
+
+
+int SimGetPinOutput(byte Pin)
+{
+  return digitalRead(Pin);
+}
+
+
+unsigned long SimGetPinWrites(byte Pin)
+{
+  return (Pin < VSIMNUMPINS) ? GSimPinWrites[Pin] : 0;
+}
+
+
+unsigned long SimGetPinPortWrites(byte Pin)
+{
+  return (Pin < VSIMNUMPINS) ? GSimPinPortWrites[Pin] : 0;
+}
+
+
+uint64_t SimGetPinHighMicros(byte Pin)
+{
+  if (Pin >= VSIMNUMPINS)
+    return 0;
+  if (GSimPinOut[Pin] != LOW)
+    return GSimPinHighMicros[Pin] + GSimMicros - GSimPinHighSince[Pin];
+  return GSimPinHighMicros[Pin];
+}
+
+
+
+
+/////////////////////////////////////////////////////////////////////////
+//
+// SPI, EEPROM and serial library functions
+//
+void SPIClass::begin(void) {}
+void SPIClass::end(void) {}
+void SPIClass::beginTransaction(SPISettings Settings) { GSimLibrarySPIClock = Settings.ClockRate; }
+void SPIClass::endTransaction(void) {}
+
+
+//
+// library transfer: waits 8 SPI clocks
+//
+uint8_t SPIClass::transfer(uint8_t Data)
+{
+  unsigned long Micros = 8000000UL / GSimLibrarySPIClock;
+
+  GSimStats.SPIBytes++;
+  GSimStats.SPIBusMicros += Micros;
+  SimAdvanceTime(Micros);
+  if (GSimSelectedMCP < 0)
+    return 0xFF;
+  return GSimMCP[(int)GSimSelectedMCP].Transfer(Data);
+}
+
+
+//
+// SPI0 byte time in microseconds: 8 clocks of the prescaled 16MHz CPU clock
+//
+unsigned long SimSPIByteMicros(void)
+{
+  unsigned long Prescale;
+
+  switch (SPI0.CTRLA & SPI_PRESC_gm)
+  {
+    case SPI_PRESC_DIV4_gc: Prescale = 4; break;
+    case SPI_PRESC_DIV16_gc: Prescale = 16; break;
+    case SPI_PRESC_DIV64_gc: Prescale = 64; break;
+    default: Prescale = 128; break;
+  }
+  if (SPI0.CTRLA & SPI_CLK2X_bm)
+    Prescale /= 2;
+  return 8 * Prescale / 16;
+}
+
+
+//
+// SPI0 DATA write: start a transfer. Read: the byte received; clears IF
+//
+SimSPIData& SimSPIData::operator=(uint8_t Value)
+{
+  GSimSPIFlag = false;
+  if (!(SPI0.CTRLA & SPI_ENABLE_bm))
+    return *this;
+  GSimStats.SPIBytes++;
+  GSimStats.SPIBusMicros += SimSPIByteMicros();
+  GSimSPIReceived = (GSimSelectedMCP < 0) ? 0xFF : GSimMCP[(int)GSimSelectedMCP].Transfer(Value);
+  GSimSPIDone = GSimMicros + SimSPIByteMicros();
+  return *this;
+}
+
+
+SimSPIData::operator uint8_t()
+{
+  GSimSPIFlag = false;
+  return GSimSPIReceived;
+}
+
+
+//
+// SPI0 INTFLAGS read: if a byte is being sent, time passes until it completes
+//
+SimSPIFlags::operator uint8_t()
+{
+  if (GSimSPIDone > GSimMicros)
+    SimAdvanceTime((unsigned long)(GSimSPIDone - GSimMicros));
+  return GSimSPIFlag ? SPI_IF_bm : 0;
+}
+
+
+SimSPIFlags& SimSPIFlags::operator=(uint8_t Value)
+{
+  if (Value & SPI_IF_bm)
+    GSimSPIFlag = false;
+  return *this;
+}
+
+
+byte SimGetMCPRegister(byte Chip, byte RegAddress)
+{
+  return GSimMCP[Chip & 1].Reg[RegAddress % 0x16];
+}
+
+
+uint8_t EEPROMClass::read(int Address)
+{
+  return GSimEEPROM[Address % VSIMEEPROMSIZE];
+}
+
+
+void EEPROMClass::write(int Address, uint8_t Value)
+{
+  GSimEEPROM[Address % VSIMEEPROMSIZE] = Value;
+  GSimStats.EEPROMWrites++;
+}
+
+
+//
+// as the Arduino library: only written if the value is different
+//
+void EEPROMClass::update(int Address, uint8_t Value)
+{
+  if (GSimEEPROM[Address % VSIMEEPROMSIZE] != Value)
+    write(Address, Value);
+}
+
+
+void SimEraseEEPROM(void)
+{
+  memset(GSimEEPROM, 0xFF, sizeof(GSimEEPROM));
+}
+
+
+void HardwareSerial::begin(unsigned long Baud)
+{
+  if (this == &Serial1)
+    GSimBaud = Baud;
+}
+
+
+void HardwareSerial::end(void) {}
+
+
+int HardwareSerial::available(void)
+{
+  if (this != &Serial1)
+    return 0;
+  return (int)GSimRXBuffer.size();
+}
+
+
+int HardwareSerial::read(void)
+{
+  int Ch;
+
+  if ((this != &Serial1) || (GSimRXBuffer.size() == 0))
+    return -1;
+  Ch = (byte)GSimRXBuffer[0];
+  GSimRXBuffer.erase(0, 1);
+  GSimStats.RXBytes++;
+  return Ch;
+}
+
+
+int HardwareSerial::peek(void)
+{
+  if ((this != &Serial1) || (GSimRXBuffer.size() == 0))
+    return -1;
+  return (byte)GSimRXBuffer[0];
+}
+
+
+int HardwareSerial::availableForWrite(void)
+{
+  return VSIMTXBUFSIZE - (int)GSimTXBuffer.size();
+}
+
+
+//
+// wait until the TX buffer has emptied
+//
+void HardwareSerial::flush(void)
+{
+  while ((this == &Serial1) && (GSimTXBuffer.size() != 0) && (GSimBaud != 0))
+  {
+    GSimStats.TXBlockedMicros += 100;
+    SimAdvanceTime(100);
+  }
+}
+
+
+//
+// write one byte; if the buffer is full, block until a byte has drained
+//
+size_t HardwareSerial::write(uint8_t Ch)
+{
+  if (this != &Serial1)
+    return 1;
+  while ((GSimTXBuffer.size() >= VSIMTXBUFSIZE) && (GSimBaud != 0))
+  {
+    GSimStats.TXBlockedMicros += 10;
+    SimAdvanceTime(10);
+  }
+  GSimTXBuffer += (char)Ch;
+  GSimStats.TXBytes++;
+  return 1;
+}
+
+
+size_t HardwareSerial::write(const uint8_t* Buffer, size_t Size)
+{
+  size_t Cntr;
+
+  for (Cntr = 0; Cntr < Size; Cntr++)
+    write(Buffer[Cntr]);
+  return Size;
+}
+
+
+size_t HardwareSerial::print(const char* Str)
+{
+  return write((const uint8_t*)Str, strlen(Str));
+}
+
+
+size_t HardwareSerial::println(const char* Str)
+{
+  size_t Count = print(Str);
+  return Count + write((const uint8_t*)"\r\n", 2);
+}
+
+
+void SimHostSend(const char* Str)
+{
+  GSimHostToPanel += Str;
+}
+
+
+size_t SimHostSendPending(void)
+{
+  return GSimHostToPanel.size();
+}
+
+
+std::string SimHostReceive(void)
+{
+  std::string Result;
+
+  Result.swap(GSimPanelToHost);
+  return Result;
+}
+
+
+unsigned long SimGetBaudRate(void)
+{
+  return GSimBaud;
+}
+
+
+void SimSetHostBaudRate(unsigned long Baud)
+{
+  GSimHostBaud = Baud;
+}
+
+
+
+
+/////////////////////////////////////////////////////////////////////////
+//
+// panel controls
+//
+
+//
+// set the MCP23S17 #0 inputs and direct wired pins from encoder positions
+//
+void SimUpdateEncoderInputs(void)
+{
+  unsigned int Inputs = 0;
+  byte Cntr;
+  byte State;
+
+  for (Cntr = 0; Cntr < 8; Cntr++)
+    Inputs |= GSimQuadrature[GSimEncoderPosition[Cntr] & 3] << GSimEncoderBitPosition[Cntr];
+  GSimMCP[VMCPENCODERADDR].ExternalInputs = Inputs;
+  GSimMCP[VMCPENCODERADDR].UpdateInterrupts();
+
+  State = GSimQuadrature[GSimEncoderPosition[8] & 3];               // encoder 9: bit 0 = 9B; bit 1 = 9A
+  SimSetPinExternal(VPINENCODER9B, State & 1);
+  SimSetPinExternal(VPINENCODER9A, (State >> 1) & 1);
+  State = GSimQuadrature[GSimEncoderPosition[9] & 3];               // encoder 10: bit 0 = 10B; bit 1 = 10A
+  SimSetPinExternal(VPINENCODER10B, State & 1);
+  SimSetPinExternal(VPINENCODER10A, (State >> 1) & 1);
+}
+
+
+//
+// move an encoder by N edges. All edges are applied at once,
+// so normally call this with +1 or -1 between ticks
+//
+void SimTurnEncoder(byte Encoder, int Edges)
+{
+  if (Encoder >= VMAXSIMENCODERS)
+    return;
+  GSimEncoderPosition[Encoder] += Edges;
+  SimUpdateEncoderInputs();
+}
+
+
+//
+// move the VFO encoder by N edges; each edge raises a pin change interrupt
+//
+void SimTurnVFO(int Edges)
+{
+  byte State;
+
+  while (Edges != 0)
+  {
+    if (Edges > 0)
+    {
+      GSimVFOPosition++;
+      Edges--;
+    }
+    else
+    {
+      GSimVFOPosition--;
+      Edges++;
+    }
+    State = GSimVFOQuadrature[GSimVFOPosition & 3];
+    GSimPinExternal[A4] = (State >> 2) & 1;
+    GSimPinExternal[A5] = (State >> 3) & 1;
+    SimUpdatePORTA();
+  }
+}
+
+
+void SimSetKey(byte ScanCode, bool Pressed)
+{
+  if (ScanCode >= 32)
+    return;
+  if (Pressed)
+    GSimKeys |= (1UL << ScanCode);
+  else
+    GSimKeys &= ~(1UL << ScanCode);
+  GSimMCP[VMCPMATRIXADDR].UpdateInterrupts();
+}
+
+
+
+
+//
+// power on reset, then run the sketch setup
+//
+void SimPowerOn(void)
+{
+  byte Cntr;
+
+  GSimMicros = 0;
+  GSimNextTick = 0;
+  GSimInterruptsEnabled = true;
+  GSimInISR = false;
+  GSimTickPending = false;
+  GSimVFOPending = false;
+  memset(&TCB0, 0, sizeof(TCB0));
+  memset(&TCA0, 0, sizeof(TCA0));
+  memset(&PORTA, 0, sizeof(PORTA));
+  for (Cntr = 0; Cntr < 6; Cntr++)
+    GSimVPorts[Cntr]->OUT.Value = 0;
+  SPI0.CTRLA = 0;
+  SPI0.CTRLB = 0;
+  SPI0.INTCTRL = 0;
+  GSimSPIDone = 0;
+  GSimSPIFlag = false;
+  memset(&GSimStats, 0, sizeof(GSimStats));
+
+  memset(GSimPinMode, INPUT, sizeof(GSimPinMode));
+  memset(GSimPinOut, LOW, sizeof(GSimPinOut));
+  memset(GSimPinWrites, 0, sizeof(GSimPinWrites));
+  memset(GSimPinPortWrites, 0, sizeof(GSimPinPortWrites));
+  memset(GSimPinHighMicros, 0, sizeof(GSimPinHighMicros));
+  memset(GSimPinExternal, -1, sizeof(GSimPinExternal));
+  GSimPinExternal[A4] = 0;                                    // VFO encoder at rest with both outputs low
+  GSimPinExternal[A5] = 0;
+
+  GSimMCP[0].Reset();
+  GSimMCP[0].IsMatrix = false;
+  GSimMCP[1].Reset();
+  GSimMCP[1].IsMatrix = true;
+  GSimSelectedMCP = -1;
+  memset(GSimEncoderPosition, 0, sizeof(GSimEncoderPosition));
+  GSimVFOPosition = 0;
+  GSimKeys = 0;
+  SimUpdateEncoderInputs();
+
+  GSimBaud = 0;
+  GSimHostToPanel.clear();
+  GSimRXBuffer.clear();
+  GSimTXBuffer.clear();
+  GSimPanelToHost.clear();
+  GSimRXBitCredit = 0;
+  GSimTXBitCredit = 0;
+
+  setup();
+}
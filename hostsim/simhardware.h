@@ -0,0 +1,132 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// simhardware.h
+// simulated Nano Every and front panel hardware:
+// a deterministic clock with the TCB0 2ms tick, the two MCP23S17
+// expanders with the encoders and switch matrix behind them, the
+// direct wired encoders, the VFO encoder, EEPROM and the CAT UART.
+//
+// time only advances when the simulation asks it to, so a run is
+// exactly repeatable and runs as fast as the PC allows.
+/////////////////////////////////////////////////////////////////////////
+#ifndef __simhardware_h
+#define __simhardware_h
+
+#include <string>
+#include "Arduino.h"
+
+#define VMAXSIMENCODERS 10                  // mechanical encoders, not including VFO
+
+//
+// sketch entry points and interrupt handlers
+//
+void setup(void);
+void loop(void);
+void TCB0_INT_vect(void);
+void PORTA_PORT_vect(void);
+
+
+//
+// counters of simulated hardware activity
+//
+struct SSimStatistics
+{
+  unsigned long TicksFired;                   // TCB0 interrupts delivered
+  unsigned long SPITransactions;              // chip select assertions
+  unsigned long SPIBytes;                     // bytes exchanged over SPI
+  unsigned long SPIBusMicros;                 // time the SPI bus was clocking bytes
+  unsigned long TXBytes;                      // bytes sent to the host
+  unsigned long RXBytes;                      // bytes read by the sketch
+  unsigned long RXDropped;                    // bytes lost to a full RX buffer
+  unsigned long TXBlockedMicros;              // time the sketch spent waiting for TX buffer space
+  unsigned long VFOInterrupts;                // PORTA pin change interrupts delivered
+  unsigned long EEPROMWrites;                 // EEPROM bytes erased and written
+};
+
+extern SSimStatistics GSimStats;
+
+
+//
+// power on: reset all simulated hardware then run setup()
+// EEPROM contents are kept unless SimEraseEEPROM() is called first
+//
+void SimPowerOn(void);
+void SimEraseEEPROM(void);
+
+
+//
+// advance the simulated clock, delivering timer and serial events
+//
+void SimAdvanceTime(unsigned long Microseconds);
+
+
+//
+// optional function called whenever the sketch re-enables interrupts,
+// before pending interrupts are delivered. Lets a test make inputs change
+// at exactly the points where the sketch can be interrupted. NULL to remove.
+//
+void SimSetInterruptHook(void (*Hook)(void));
+
+
+//
+// timer counts (0.5us) from a TCB0 match to its interrupt handler starting,
+// as if the CPU had been busy: the handler sees it in TCB0.CNT. Default 0
+//
+void SimSetTimerLatency(unsigned int Counts);
+
+
+//
+// run the sketch for a number of 2ms ticks:
+// advance through TCB0 interrupts until one triggers the tick, then call loop()
+//
+void SimRunTicks(unsigned long Ticks);
+
+
+//
+// current simulated time in microseconds since power on
+//
+uint64_t SimGetMicros(void);
+
+
+//
+// controls:
+// encoders are numbered 0-9 as in encoders.cpp; each call moves the
+// encoder by a number of quadrature edges (+ = clockwise)
+// buttons are identified by matrix scan code (column*8 + row)
+//
+void SimTurnEncoder(byte Encoder, int Edges);
+void SimTurnVFO(int Edges);
+void SimSetKey(byte ScanCode, bool Pressed);
+
+
+//
+// CAT link, as seen from the host end
+// SimHostSend queues bytes that arrive at the panel at the current baud rate
+// SimHostReceive returns (and clears) everything the panel has sent
+//
+void SimHostSend(const char* Str);
+size_t SimHostSendPending(void);              // bytes sent by the host not yet arrived at the panel
+std::string SimHostReceive(void);
+unsigned long SimGetBaudRate(void);
+
+//
+// set the host end baud rate: bytes sent at a different rate to the panel's arrive as nulls
+// 0 (the default) means the host always follows the panel. Not changed by SimPowerOn()
+//
+void SimSetHostBaudRate(unsigned long Baud);
+
+
+//
+// outputs, for checking LED states
+//
+int SimGetPinOutput(byte Pin);
+unsigned long SimGetPinWrites(byte Pin);      // output writes to a pin since power on
+unsigned long SimGetPinPortWrites(byte Pin);  // VPORT OUT writes including a pin, changed or not
+uint64_t SimGetPinHighMicros(byte Pin);       // time an output has been high since power on
+byte SimGetMCPRegister(byte Chip, byte RegAddress);
+
+
+#endif      // file sentry
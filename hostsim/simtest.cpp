@@ -0,0 +1,76 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// simtest.cpp
+// check reporting and CAT traffic helpers shared by the host test programs
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include "simhardware.h"
+#include "simtest.h"
+
+
+int GFailCount;
+bool GVerbose;
+bool GQuietPasses;
+
+
+//
+// record the result of one check
+//
+void Check(const char* Name, bool Passed)
+{
+  if (!Passed || !GQuietPasses)
+    printf("%s: %s\n", Passed ? "PASS" : "FAIL", Name);
+  fflush(stdout);
+  if (!Passed)
+    GFailCount++;
+}
+
+
+void CheckOutput(const char* Name, const std::string& Output, const std::string& Expected)
+{
+  bool Passed = (Output == Expected);
+
+  Check(Name, Passed);
+  if (!Passed)
+    printf("      expected \"%s\" got \"%s\"\n", Expected.c_str(), Output.c_str());
+}
+
+
+//
+// print the number of failed checks, and return the program's exit code
+//
+int CheckSummary(void)
+{
+  printf("%d check(s) failed\n", GFailCount);
+  return (GFailCount == 0) ? 0 : 1;
+}
+
+
+//
+// run ticks and return all the CAT output produced
+//
+std::string RunAndReceive(unsigned long Ticks)
+{
+  std::string Output;
+
+  SimRunTicks(Ticks);
+  Output = SimHostReceive();
+  if (GVerbose && Output.size())
+    printf("  panel: %s\n", Output.c_str());
+  return Output;
+}
+
+
+//
+// send a CAT command from the host
+//
+void HostSend(const char* Cmd)
+{
+  if (GVerbose)
+    printf("  host:  %s\n", Cmd);
+  SimHostSend(Cmd);
+}
@@ -0,0 +1,50 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// simtest.h
+// check reporting and CAT traffic helpers shared by the host test programs
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __SIMTEST_H
+#define __SIMTEST_H
+#include <string>
+
+
+extern int GFailCount;                      // number of failed checks
+extern bool GVerbose;                       // true to print CAT traffic
+extern bool GQuietPasses;                   // true to print only failed checks
+
+
+//
+// record the result of one check
+//
+void Check(const char* Name, bool Passed);
+
+
+//
+// check CAT output is exactly as expected; if not, print both
+//
+void CheckOutput(const char* Name, const std::string& Output, const std::string& Expected);
+
+
+//
+// print the number of failed checks, and return the program's exit code
+//
+int CheckSummary(void);
+
+
+//
+// run ticks and return all the CAT output produced
+//
+std::string RunAndReceive(unsigned long Ticks);
+
+
+//
+// send a CAT command from the host
+//
+void HostSend(const char* Cmd);
+
+
+#endif //not defined
@@ -0,0 +1,16 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// sketch.cpp
+// compiles the .ino main file for the host
+// the Arduino IDE generates prototypes for functions in the .ino file;
+// any used before they are defined need declaring here
+/////////////////////////////////////////////////////////////////////////
+
+#include "simhardware.h"
+
+void ConfigIOPins(void);
+
+#include "g2v2panel.ino"
@@ -0,0 +1,72 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// timebasemock.cpp
+// a mock of the sketch's timebase (timebase.h), for unit testing timing logic:
+// time only moves when the test moves it, and the timer interrupt never runs
+/////////////////////////////////////////////////////////////////////////
+
+#include "Arduino.h"
+#include "timebasemock.h"
+
+
+volatile unsigned long GTimebaseTicks;          // ticks since InitTimebase() (simhardware.cpp reads this)
+unsigned long GMockMicros;                      // microseconds since InitTimebase()
+unsigned long GMockTickMicros;                  // microseconds into the current tick
+
+
+//
+// start from 0; the timer isn't started
+//
+void InitTimebase(void)
+{
+  GTimebaseTicks = 0;
+  GMockMicros = 0;
+  GMockTickMicros = 0;
+}
+
+
+void TimebaseInterrupt(bool TickDue)
+{
+}
+
+
+unsigned long TimebaseTicks(void)
+{
+  return GTimebaseTicks;
+}
+
+
+unsigned long TimebaseMicros(void)
+{
+  return GMockMicros;
+}
+
+
+unsigned long TimebaseTicksAt(unsigned long Micros)
+{
+  return GTimebaseTicks - (GMockMicros - Micros) / VTICKMICROS;
+}
+
+
+unsigned int TimerCounts(void)
+{
+  return (unsigned int)(GMockMicros * (1000 / VTIMERCOUNTNS));
+}
+
+
+void MockAdvanceMicros(unsigned long Micros)
+{
+  GMockMicros += Micros;
+  GMockTickMicros += Micros;
+  GTimebaseTicks += GMockTickMicros / VTICKMICROS;
+  GMockTickMicros %= VTICKMICROS;
+}
+
+
+void MockAdvanceTicks(unsigned long Ticks)
+{
+  MockAdvanceMicros(Ticks * VTICKMICROS);
+}
@@ -0,0 +1,24 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// timebasemock.h
+// a mock of the sketch's timebase (timebase.h), for unit testing timing logic:
+// time only moves when the test moves it, and the timer interrupt never runs.
+// link timebasemock.o instead of timebase.o
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __TIMEBASEMOCK_H
+#define __TIMEBASEMOCK_H
+#include "timebase.h"
+
+
+//
+// move the time on; the tick count follows (one tick per VTICKMICROS)
+//
+void MockAdvanceMicros(unsigned long Micros);
+void MockAdvanceTicks(unsigned long Ticks);
+
+
+#endif //not defined
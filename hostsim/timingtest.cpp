@@ -0,0 +1,152 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// timingtest.cpp
+// unit tests of the sketch's timing logic against the mock timebase
+// (timebasemock.cpp): LED test and pattern timing, and tick overrun accounting.
+// the modules are called directly, at irregular times the test chooses,
+// to check they keep time from the timebase rather than by counting calls
+//
+// timingtest
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include "simhardware.h"
+#include "simtest.h"
+#include "timebasemock.h"
+#include "globalinclude.h"
+#include "iopins.h"
+#include "configdata.h"
+#include "led.h"
+#include "scheduler.h"
+
+
+void ConfigIOPins(void);                    // in the sketch's .ino file
+
+//
+// run the LED task, then a full bit plane cycle of the LED interrupt
+// so the GPIO LED pins show the result
+//
+void RunLEDTick(void)
+{
+  int Cntr;
+
+  LEDTick();
+  for (Cntr = 0; Cntr < 7; Cntr++)
+    LEDBAMInterrupt();
+}
+
+
+//
+// LED self test: lasts the same time when LEDTick() is called late
+//
+void TestLEDSelfTest(void)
+{
+  unsigned long Start = TimebaseTicks();
+  unsigned long Step = 0;
+
+  while (!LEDTestComplete && (TimebaseTicks() - Start < 5000))
+  {
+    MockAdvanceTicks(5 + (Step++ % 4) * 6);               // 10ms to 46ms between calls
+    RunLEDTick();
+  }
+  Start = TimebaseTicks() - Start;
+  printf("  LED self test with late LED ticks: %lu ticks\n", Start);
+  Check("LED self test keeps time with late calls", (Start >= 1100) && (Start <= 1100 + 22 * 46));
+}
+
+
+//
+// blink: lit for the first half of each period of the tick count, whenever LEDTick() runs
+//
+void TestBlink(void)
+{
+  unsigned long Cntr;
+  int Mismatches = 0;
+
+  SetLEDPattern(4, eLEDBlink, 1);                         // LED 5: 200ms period
+  SetLED(4, true);
+  for (Cntr = 0; Cntr < 200; Cntr++)
+  {
+    MockAdvanceTicks(1 + (Cntr * 7) % 23);                // 2ms to 46ms between calls
+    RunLEDTick();
+    if (SimGetPinOutput(VPININDICATOR5) != (((TimebaseTicks() % 100) < 50) ? (int)HIGH : (int)LOW))
+      Mismatches++;
+  }
+  Check("blink follows the tick count with irregular LED ticks", Mismatches == 0);
+  SetLED(4, false);
+  SetLEDPattern(4, eLEDSteady, 0);
+  RunLEDTick();
+}
+
+
+//
+// pulse: lit for its period from being switched on, however often LEDTick() runs
+//
+void TestPulse(byte Step)
+{
+  unsigned long Start, Lit;
+
+  SetLEDPattern(5, eLEDPulse, 2);                         // LED 6: 400ms pulse
+  RunLEDTick();
+  SetLED(5, true);
+  Start = TimebaseTicks();
+  RunLEDTick();
+  while ((SimGetPinOutput(VPININDICATOR6) == HIGH) && (TimebaseTicks() - Start < 1000))
+  {
+    MockAdvanceTicks(Step);
+    RunLEDTick();
+  }
+  Lit = TimebaseTicks() - Start;
+  printf("  pulse with LED ticks every %d ticks: lit %lu ticks\n", Step, Lit);
+  Check("pulse lasts its period", (Lit >= 200) && (Lit <= 200UL + Step));
+  SetLEDPattern(5, eLEDSteady, 0);
+}
+
+
+//
+// tick accounting: TickDue() counts ticks that the main loop missed
+//
+void TestTickAccounting(void)
+{
+  int Due;
+
+  InitTasks();
+  GTicksHandled = TimebaseTicks();
+  Check("no tick due before the timebase moves", !TickDue());
+  MockAdvanceTicks(1);
+  Due = TickDue();
+  Check("one tick due", Due && !TickDue() && (GTickOverruns == 0) && (GLostTicks == 0));
+  MockAdvanceMicros(VTICKMICROS - 1);
+  Check("no tick due part way through a tick", !TickDue());
+  MockAdvanceMicros(1 + 4 * VTICKMICROS);
+  Due = TickDue();
+  Check("5 ticks due: 4 lost", Due && (GTickOverruns == 1) && (GLostTicks == 4) && (GWorstTickGap == 5));
+  MockAdvanceTicks(2);
+  Due = TickDue();
+  Check("worst gap kept", Due && (GTickOverruns == 2) && (GLostTicks == 5) && (GWorstTickGap == 5));
+}
+
+
+int main(int argc, char* argv[])
+{
+  byte Cntr;
+
+  ConfigIOPins();
+  InitTimebase();
+  InitLEDs();
+  GPanelBrightness = VMAXLEDLEVEL;
+  for (Cntr = 0; Cntr < VMAXINDICATORS; Cntr++)
+    GLEDBrightness[Cntr] = VMAXLEDLEVEL;
+  SetLEDBrightness();
+
+  TestLEDSelfTest();
+  TestBlink();
+  TestPulse(5);
+  TestPulse(17);
+  TestTickAccounting();
+
+  return CheckSummary();
+}
@@ -0,0 +1,139 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Saturn G2 front panel controller host simulation
+// copyright (c) Laurence Barker G8NJJ 2023
+//
+// vfostress.cpp
+// stress test of the VFO optical encoder accumulator (opticalencoder.cpp)
+// edge storms are driven through the PORTA pin change interrupt, and more
+// edges are injected each time ReadOpticalEncoder() re-enables interrupts,
+// which is where a real interrupt could land. Every edge must be accounted
+// for: reported steps * divisor + residue left = edges applied.
+//
+// vfostress [iterations]
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include "simhardware.h"
+#include "opticalencoder.h"
+
+
+extern volatile int16_t GDeltaCount;        // accumulator, in opticalencoder.cpp
+
+long GEdgesApplied;                         // total edges turned
+long GHookEdges;                            // edges to inject at the next interrupt enable
+
+
+//
+// called when the code under test re-enables interrupts
+//
+void InjectEdges(void)
+{
+  long Edges = GHookEdges;
+
+  if (Edges)
+  {
+    GHookEdges = 0;
+    SimTurnVFO((int)Edges);
+    GEdgesApplied += Edges;
+  }
+}
+
+
+//
+// random burst of edges in a random direction
+//
+int RandomBurst(int MaxSize)
+{
+  int Size = rand() % (MaxSize + 1);
+
+  return (rand() & 1) ? Size : -Size;
+}
+
+
+//
+// sketch variables aren't cleared by SimPowerOn(), so clear the accumulator here
+//
+void ClearAccumulator(void)
+{
+  noInterrupts();
+  GDeltaCount = 0;
+  GVFOOverflowCount = 0;
+  interrupts();
+}
+
+
+//
+// run storms with one divisor setting; returns true if the count is exact
+//
+bool StormTest(byte Divisor, unsigned long Iterations)
+{
+  long StepsReported = 0;
+  long Edges;
+  unsigned long Cntr;
+  int Steps;
+  bool Exact;
+
+  SimPowerOn();
+  SetOpticalEncoderDivisor(Divisor);
+  ClearAccumulator();
+  GEdgesApplied = 0;
+  SimSetInterruptHook(InjectEdges);
+
+  for (Cntr = 0; Cntr < Iterations; Cntr++)
+  {
+    Edges = RandomBurst(400);                          // up to 400 edges between reads
+    SimTurnVFO((int)Edges);
+    GEdgesApplied += Edges;
+    GHookEdges = RandomBurst(3);                       // edges during the read
+    StepsReported += ReadOpticalEncoder(99);
+  }
+  GHookEdges = 0;
+  SimSetInterruptHook(NULL);
+  while ((Steps = ReadOpticalEncoder(99)) != 0)        // drain what is left
+    StepsReported += Steps;
+
+  Exact = (StepsReported * Divisor + GDeltaCount == GEdgesApplied)
+       && (GDeltaCount > -Divisor) && (GDeltaCount < Divisor) && (GVFOOverflowCount == 0);
+  printf("%s: divisor %d: %ld edges, %ld steps reported, residue %d, overflows %u\n",
+         Exact ? "PASS" : "FAIL", Divisor, GEdgesApplied, StepsReported, GDeltaCount, GVFOOverflowCount);
+  return Exact;
+}
+
+
+//
+// spin far beyond the accumulator range without reading:
+// the count must saturate, and every lost edge must be counted
+//
+bool OverflowTest(void)
+{
+  long Edges = 40000;
+  bool Exact;
+
+  SimPowerOn();
+  SetOpticalEncoderDivisor(1);
+  ClearAccumulator();
+  SimTurnVFO((int)Edges);
+  Exact = ((long)GDeltaCount + (long)GVFOOverflowCount == Edges) && (GVFOOverflowCount != 0);
+  printf("%s: saturation: %ld edges, accumulator %d, overflows %u\n",
+         Exact ? "PASS" : "FAIL", Edges, GDeltaCount, GVFOOverflowCount);
+  return Exact;
+}
+
+
+
+int main(int argc, char* argv[])
+{
+  unsigned long Iterations = 200000;
+  int Failed = 0;
+
+  if (argc > 1)
+    Iterations = strtoul(argv[1], NULL, 0);
+  SimEraseEEPROM();
+  srand(1);
+  if (!StormTest(1, Iterations)) Failed++;
+  if (!StormTest(2, Iterations)) Failed++;
+  if (!StormTest(4, Iterations)) Failed++;
+  if (!OverflowTest()) Failed++;
+  return Failed;
+}